@@ -0,0 +1,127 @@
+/** \file
+ * Bump allocator with string interning.
+ */
+#include "brightstar.h"
+
+struct arena_block_s {
+    arena_block_s *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+/** Create an empty arena.  The first block is allocated on first use.
+ */
+arena_s *arena_new(void)
+{
+    arena_s *a=calloc(1, sizeof(*a));
+    a->next_size=ARENA_BLOCK;
+    a->interned=g_hash_table_new(g_str_hash, g_str_equal);
+    return a;
+}
+
+/** Free an arena and everything allocated from it.
+ */
+void arena_free(arena_s *a)
+{
+    arena_block_s *b;
+    if(a==NULL)
+        return;
+    while((b=a->head)){
+        a->head=b->next;
+        free(b);
+    }
+    g_hash_table_destroy(a->interned);
+    free(a);
+}
+
+/** Allocate size zeroed bytes, aligned for any type, from the arena.
+ */
+void *arena_alloc(arena_s *a, size_t size)
+{
+    arena_block_s *b=a->head;
+    void *p;
+    size=(size+15)&~(size_t)15;
+    if(b==NULL || b->size-b->used<size){
+        size_t bsize=a->next_size;
+        while(bsize<size)
+            bsize*=2;
+        if(a->next_size<ARENA_BLOCK_MAX)
+            a->next_size*=2;
+        if((b=malloc(sizeof(*b)+bsize))==NULL){
+            fprintf(stderr, "%s\n", "Out of memory");
+            exit(EXIT_FAILURE);
+        }
+        b->size=bsize;
+        b->used=0;
+        b->next=a->head;
+        a->head=b;
+        STATS_COUNT(STATS_BLOCKS, 1);
+    }
+    STATS_COUNT(STATS_ALLOCS, 1);
+    STATS_COUNT(STATS_ALLOC_BYTES, size);
+    p=b->data+b->used;
+    b->used+=size;
+    a->used+=size;
+    memset(p, 0, size);
+    return p;
+}
+
+/** Copy len bytes of s into the arena, NUL terminated.
+ */
+char *arena_strndup(arena_s *a, const char *s, size_t len)
+{
+    char *p=arena_alloc(a, len+1);
+    memcpy(p, s, len);
+    return p;
+}
+
+/** Copy s into the arena.
+ */
+char *arena_strdup(arena_s *a, const char *s)
+{
+    return arena_strndup(a, s, strlen(s));
+}
+
+/** Return the copy of s held by the arena, making it on the first request.
+ */
+const char *arena_intern(arena_s *a, const char *s)
+{
+    char *p=g_hash_table_lookup(a->interned, s);
+    if(p==NULL){
+        p=arena_strdup(a, s);
+        g_hash_table_add(a->interned, p);
+    }
+    return p;
+}
+
+/** Copy an array of count strings into the arena.
+ */
+span_s arena_span(arena_s *a, const char **items, int count)
+{
+    span_s span={arena_alloc(a, (count ? count : 1)*sizeof(char *)), count};
+    for(int i=0; i<count; i++)
+        span.items[i]=arena_strdup(a, items[i]);
+    return span;
+}
+
+/** Split s on the characters of delim into an array of strings, all in the arena.
+ * Empty fields are dropped.
+ */
+span_s arena_split(arena_s *a, const char *s, const char *delim)
+{
+    span_s span={NULL, 0};
+    const char *p;
+    int n=0;
+    for(p=s+strspn(s, delim); *p; p+=strspn(p, delim)){
+        p+=strcspn(p, delim);
+        n++;
+    }
+    span.items=arena_alloc(a, (n ? n : 1)*sizeof(char *));
+    for(p=s+strspn(s, delim); *p; p+=strspn(p, delim)){
+        size_t len=strcspn(p, delim);
+        span.items[span.count++]=arena_strndup(a, p, len);
+        p+=len;
+    }
+    return span;
+}
@@ -0,0 +1,42 @@
+/** \file
+ * Bump allocator for the records of a query or of a whole catalog.
+ *
+ * Everything allocated from an arena is released at once by arena_free(),
+ * so records built in an arena hold plain pointers and need no destructor.
+ * Short strings that repeat from one package to the next, like versions,
+ * maintainers or architectures, are interned and stored once per arena.
+ */
+#ifndef BRIGHT_ARENA_H
+#define BRIGHT_ARENA_H
+#include <stddef.h>
+
+#define ARENA_BLOCK 65536      //!< Size of the first block, later blocks double up to ARENA_BLOCK_MAX.
+#define ARENA_BLOCK_MAX 4194304
+
+typedef struct arena_block_s arena_block_s;
+
+/**An arena: a list of blocks, the current one first.
+ */
+typedef struct {
+    arena_block_s *head;
+    size_t next_size;        //!< Size of the next block.
+    size_t used;             //!< Bytes handed out so far.
+    void *interned;          //!< GHashTable of the interned strings.
+} arena_s;
+
+/**A variable-length array of strings living in an arena.
+ */
+typedef struct {
+    const char **items;
+    int count;
+} span_s;
+
+arena_s *arena_new(void);
+void arena_free(arena_s *a);
+void *arena_alloc(arena_s *a, size_t size);
+char *arena_strndup(arena_s *a, const char *s, size_t len);
+char *arena_strdup(arena_s *a, const char *s);
+const char *arena_intern(arena_s *a, const char *s);
+span_s arena_split(arena_s *a, const char *s, const char *delim);
+span_s arena_span(arena_s *a, const char **items, int count);
+#endif /* BRIGHT_ARENA_H */
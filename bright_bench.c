@@ -0,0 +1,777 @@
+/** \file
+ * Benchmark of the query paths over synthetic repositories.
+ *
+ * For each size given on the command line, a SBo repository of N packages
+ * (SLACKBUILDS.TXT and the .info, slack-desc and README of every package),
+ * a Slackware catalog (pkglist, PACKAGES.TXT and ChangeLog.txt) and a
+ * /var/log/packages of M entries are generated under a work directory.  A
+ * child process then points \c SB_REPODIR, \c SK_DB, \c SB_DB and
+ * \c BS_CACHEDIR at them and times the queries.
+ *
+ * Every measure is printed on stdout as one JSON object per line:
+ * \code
+ * {"packages":5000,"slackware":1250,"installed":1250,"op":"describe_package",
+ *  "iterations":1000,"p50_us":4.1,"p99_us":9.8,"ops_per_s":221000,"peak_rss_kb":5120}
+ * \endcode
+ * The peak RSS is that of the child up to the end of the operation.
+ *
+ * Usage: brightbench [-n iterations] [-d workdir] [-s seed] N[:M]...
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_deps.h"
+#include "bright_search.h"
+#include "bright_changelog.h"
+#include "bright_catalog.h"
+#include "bright_scan.h"
+#include <ftw.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() 0
+#endif
+
+#define BENCH_ITERATIONS 1000         //!< Default number of calls timed per operation.
+#define BENCH_SEED 20130203           //!< Default seed of the generator, fixtures are reproducible.
+#define BENCH_DESCR_LINES 11          //!< Lines of a slack-desc or PACKAGES.TXT description.
+#define BENCH_CHANGELOG_ITEMS 12      //!< Items per ChangeLog entry.
+#define BENCH_SCAN_PASSES 20          //!< Parses of the whole SLACKBUILDS.TXT per scanner.
+
+/**The size of one synthetic repository.
+ */
+typedef struct {
+    int packages;         //!< Slackbuilds in SLACKBUILDS.TXT.
+    int slackware;        //!< Packages of the Slackware catalog.
+    int installed;        //!< Entries of /var/log/packages.
+} bench_size_s;
+
+/**What the timed operations run on.
+ */
+typedef struct {
+    const bench_size_s *size;
+    FILE *out;                 //!< Where the results go, stdout being /dev/null.
+    FILE *null;                //!< Where the queries print.
+    int iterations;
+    uint64_t seed;
+} bench_s;
+
+static const char *syllables[]={"lib", "gtk", "py", "qt", "net", "font", "audio", "x", "ca", "ra",
+    "mo", "zen", "tor", "vi", "gl", "sdl", "perl", "ruby", "ocaml", "java", "tex", "db", "ssl", "xml",
+    "jpeg", "png", "cairo", "pango", "kit", "io", "mail", "wm", "term", "fs", "crypt", "util", "view",
+    "dev", "mix", "tool"};
+#define NSYLLABLES (int)(sizeof(syllables)/sizeof(syllables[0]))
+
+static const char *categories[]={"academic", "accessibility", "audio", "business", "desktop",
+    "development", "games", "gis", "graphics", "ham", "haskell", "libraries", "misc", "multimedia",
+    "network", "office", "perl", "python", "ruby", "system"};
+#define NCATEGORIES (int)(sizeof(categories)/sizeof(categories[0]))
+
+static const char *words[]={"a", "the", "library", "for", "and", "tool", "to", "with", "fast",
+    "simple", "manager", "of", "files", "network", "support", "written", "in", "C", "graphical",
+    "interface", "command", "line", "server", "client", "data", "format", "small", "portable"};
+#define NWORDS (int)(sizeof(words)/sizeof(words[0]))
+
+/** xorshift64*, enough for fixtures and query mixes.
+ */
+static uint64_t next_random(uint64_t *state)
+{
+    *state^=*state>>12;
+    *state^=*state<<25;
+    *state^=*state>>27;
+    return *state*2685821657736338717ULL;
+}
+
+static int random_below(uint64_t *state, int n)
+{
+    return n>0 ? (int)(next_random(state)%(uint64_t)n) : 0;
+}
+
+/** Return the name of package i, made of syllables, unique for every i.
+ * Slackbuilds are 0 to N-1, Slackware packages follow.
+ */
+static char *package_name(int i)
+{
+    int a=i%NSYLLABLES;
+    int b=(i/NSYLLABLES)%NSYLLABLES;
+    int c=i/(NSYLLABLES*NSYLLABLES);
+    if(c==0)
+        return g_strconcat(syllables[a], syllables[b], NULL);
+    if(c<=NSYLLABLES)
+        return g_strconcat(syllables[a], syllables[b], "-", syllables[c-1], NULL);
+    return g_strdup_printf("%s%s-%d", syllables[a], syllables[b], c);
+}
+
+static char *package_version(int i)
+{
+    return g_strdup_printf("%d.%d.%d", 1+i%7, i%13, i%29);
+}
+
+/** Append n random words to s.
+ */
+static void append_words(GString *s, uint64_t *seed, int n)
+{
+    for(int i=0; i<n; i++)
+        g_string_append_printf(s, "%s%s", i ? " " : "", words[random_below(seed, NWORDS)]);
+}
+
+static void append_md5(GString *s, uint64_t *seed)
+{
+    for(int i=0; i<4; i++)
+        g_string_append_printf(s, "%08x", (unsigned)next_random(seed));
+}
+
+static int write_string(const char *path, const GString *s)
+{
+    if(!g_file_set_contents(path, s->str, s->len, NULL)){
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/** Generate the SBo repository: SLACKBUILDS.TXT and a directory per package.
+ * Package i requires up to three packages of lower number, so the
+ * dependencies form a DAG.
+ */
+static int generate_sbo(const char *dir, const bench_size_s *size, uint64_t *seed)
+{
+    GString *txt=g_string_new(NULL);
+    GString *s=g_string_new(NULL);
+    int ret=0;
+    for(int i=0; i<size->packages && ret==0; i++){
+        char *name=package_name(i);
+        char *version=package_version(i);
+        const char *category=categories[i%NCATEGORIES];
+        char *pkgdir=g_strdup_printf("%s%s/%s", dir, category, name);
+        char *path;
+        GString *md5=g_string_new(NULL);
+        GString *requires=g_string_new(NULL);
+        append_md5(md5, seed);
+        for(int r=random_below(seed, 4); r>0 && i>0; r--){
+            char *dep=package_name(random_below(seed, i));
+            g_string_append_printf(requires, "%s%s", requires->len ? " " : "", dep);
+            g_free(dep);
+        }
+        g_mkdir_with_parents(pkgdir, 0755);
+
+        g_string_append_printf(txt, VAR_NAME ": %s\n", name);
+        g_string_append_printf(txt, VAR_LOCATION ": ./%s/%s\n", category, name);
+        g_string_append_printf(txt, "SLACKBUILD FILES: README %s.SlackBuild %s.info slack-desc\n", name, name);
+        g_string_append_printf(txt, VAR_VERSION ": %s\n", version);
+        g_string_append_printf(txt, VAR_DOWNLOAD ": http://example.org/%s/%s-%s.tar.gz\n", name, name, version);
+        g_string_append(txt, VAR_DOWNLOAD64 ": \n");
+        g_string_append_printf(txt, VAR_MD5SUM ": %s\n", md5->str);
+        g_string_append(txt, VAR_MD5SUM64 ": \n");
+        g_string_append_printf(txt, VAR_SHORTDESCR ":  %s (", name);
+        append_words(txt, seed, 3+random_below(seed, 4));
+        g_string_append(txt, ")\n\n");
+
+        g_string_truncate(s, 0);
+        g_string_append_printf(s, "PRGNAM=\"%s\"\nVERSION=\"%s\"\n", name, version);
+        g_string_append_printf(s, "HOMEPAGE=\"http://example.org/%s\"\n", name);
+        g_string_append_printf(s, "DOWNLOAD=\"http://example.org/%s/%s-%s.tar.gz\"\n", name, name, version);
+        g_string_append_printf(s, "MD5SUM=\"%s\"\nDOWNLOAD_x86_64=\"\"\nMD5SUM_x86_64=\"\"\n", md5->str);
+        g_string_append_printf(s, "REQUIRES=\"%s\"\n", requires->str);
+        g_string_append_printf(s, "MAINTAINER=\"Maintainer %d\"\nEMAIL=\"m%d@example.org\"\n", i%97, i%97);
+        path=g_strdup_printf("%s/%s.info", pkgdir, name);
+        ret|=write_string(path, s);
+        g_free(path);
+
+        g_string_truncate(s, 0);
+        g_string_append(s, "# HOW TO EDIT THIS FILE:\n# The \"handy ruler\" below makes it easier to edit a package description.\n"
+                "# Line up the first '|' above the ':' following the base package name, and\n"
+                "# the '|' on the right side marks the last column you can put a character in.\n"
+                "# You must make exactly 11 lines for the formatting to be correct.  It's also\n"
+                "# customary to leave one space after the ':' except on otherwise blank lines.\n\n");
+        g_string_append_printf(s, "%*s|-----handy-ruler------------------------------------------------------|\n",
+                (int)strlen(name), "");
+        g_string_append_printf(s, "%s: %s\n", name, name);
+        for(int l=1; l<BENCH_DESCR_LINES; l++){
+            g_string_append_printf(s, "%s: ", name);
+            append_words(s, seed, 6+random_below(seed, 6));
+            g_string_append_c(s, '\n');
+        }
+        path=g_strdup_printf("%s/slack-desc", pkgdir);
+        ret|=write_string(path, s);
+        g_free(path);
+
+        g_string_truncate(s, 0);
+        for(int l=0; l<12; l++){
+            append_words(s, seed, 10);
+            g_string_append_c(s, '\n');
+        }
+        path=g_strdup_printf("%s/README", pkgdir);
+        ret|=write_string(path, s);
+        g_free(path);
+
+        g_string_free(md5, TRUE);
+        g_string_free(requires, TRUE);
+        g_free(pkgdir);
+        g_free(version);
+        g_free(name);
+    }
+    if(ret==0){
+        char *path=g_strconcat(dir, SB_TXT, NULL);
+        ret=write_string(path, txt);
+        g_free(path);
+    }
+    g_string_free(s, TRUE);
+    g_string_free(txt, TRUE);
+    return ret;
+}
+
+/** Generate pkglist, PACKAGES.TXT and ChangeLog.txt.  One package in eight
+ * has a patches record, listed before all the slackware records as
+ * slackpkg does.
+ */
+static int generate_slackware(const char *dir, const bench_size_s *size, uint64_t *seed)
+{
+    GString *list=g_string_new(NULL);
+    GString *slackware=g_string_new(NULL);
+    GString *packages=g_string_new(NULL);
+    GString *changes=g_string_new(NULL);
+    char *path;
+    int ret=0;
+    g_string_append(packages, "PACKAGES.TXT;  Wed Jan 16 03:02:49 UTC 2013\n\n"
+            "This file provides details on the Slackware packages found\nin the ./slackware/ directory.\n\n");
+    for(int i=0; i<size->slackware; i++){
+        char *name=package_name(size->packages+i);
+        char *version=package_version(i);
+        const char *series=categories[i%NCATEGORIES];
+        g_string_append_printf(slackware, "slackware %s %s i486 1 %s-%s-i486-1 ./slackware/%s txz\n",
+                name, version, name, version, series);
+        if(i%8==0)
+            g_string_append_printf(list, "patches %s %s_p1 i486 1_slack14.0 %s-%s_p1-i486-1_slack14.0 ./patches/packages txz\n",
+                    name, version, name, version);
+        g_string_append_printf(packages, PKG_NAME ":  %s-%s-i486-1.txz\n", name, version);
+        g_string_append_printf(packages, PKG_LOCATION ":  ./slackware/%s\n", series);
+        g_string_append_printf(packages, PKG_SIZEC ":  %d K\n", 10+random_below(seed, 20000));
+        g_string_append_printf(packages, PKG_SIZEU ":  %d K\n", 40+random_below(seed, 80000));
+        g_string_append(packages, PKG_DESCRIPTION ":\n");
+        for(int l=0; l<BENCH_DESCR_LINES; l++){
+            g_string_append_printf(packages, "%s: ", name);
+            append_words(packages, seed, 6+random_below(seed, 6));
+            g_string_append_c(packages, '\n');
+        }
+        g_string_append_c(packages, '\n');
+        g_free(version);
+        g_free(name);
+    }
+    //Newest entry first, every package shows up about twice.
+    for(int e=0; e<(2*size->slackware)/BENCH_CHANGELOG_ITEMS+1; e++){
+        g_string_append_printf(changes, "Wed Jan %d 03:02:49 UTC %d\n", 1+e%28, 2013-e/365);
+        for(int k=0; k<BENCH_CHANGELOG_ITEMS && size->slackware>0; k++){
+            int i=random_below(seed, size->slackware);
+            char *name=package_name(size->packages+i);
+            char *version=package_version(i);
+            g_string_append_printf(changes, "%s/%s-%s-i486-%d.txz:  Upgraded.\n  ",
+                    categories[i%NCATEGORIES], name, version, 1+e);
+            append_words(changes, seed, 8);
+            g_string_append_c(changes, '\n');
+            g_free(version);
+            g_free(name);
+        }
+        g_string_append(changes, "+--------------------------+\n");
+    }
+    g_string_append_len(list, slackware->str, slackware->len);
+    g_mkdir_with_parents(dir, 0755);
+    path=g_strconcat(dir, SK_LIST, NULL);
+    ret|=write_string(path, list);
+    g_free(path);
+    path=g_strconcat(dir, SK_TXT, NULL);
+    ret|=write_string(path, packages);
+    g_free(path);
+    path=g_strconcat(dir, SK_CHNG, NULL);
+    ret|=write_string(path, changes);
+    g_free(path);
+    g_string_free(list, TRUE);
+    g_string_free(slackware, TRUE);
+    g_string_free(packages, TRUE);
+    g_string_free(changes, TRUE);
+    return ret;
+}
+
+/** Generate /var/log/packages: the Slackware packages first, then Slackbuilds
+ * tagged _SBo.  Each entry lists a few files, as installpkg would.
+ */
+static int generate_installed(const char *dir, const bench_size_s *size)
+{
+    GString *s=g_string_new(NULL);
+    int ret=0;
+    g_mkdir_with_parents(dir, 0755);
+    for(int j=0; j<size->installed && ret==0; j++){
+        int slack=j<size->slackware;
+        int i=slack ? j : j-size->slackware;
+        char *name=package_name(slack ? size->packages+i : i);
+        char *version=package_version(i);
+        char *fullname=g_strdup_printf("%s-%s-i486-1%s", name, version, slack ? "" : "_SBo");
+        char *path=g_strconcat(dir, fullname, NULL);
+        g_string_truncate(s, 0);
+        g_string_append_printf(s, "PACKAGE NAME:     %s\nPACKAGE LOCATION: /tmp/%s.txz\n", fullname, fullname);
+        g_string_append_printf(s, "PACKAGE DESCRIPTION:\n%s: %s\nFILE LIST:\n./\ninstall/\ninstall/slack-desc\n", name, name);
+        g_string_append_printf(s, "usr/bin/%s\nusr/lib/lib%s.so.1\nusr/doc/%s-%s/README\nusr/man/man1/%s.1.gz\n",
+                name, name, name, version, name);
+        ret=write_string(path, s);
+        g_free(path);
+        g_free(fullname);
+        g_free(version);
+        g_free(name);
+    }
+    g_string_free(s, TRUE);
+    return ret;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+static int ns_cmp(const void *a, const void *b)
+{
+    uint64_t x=*(const uint64_t *)a;
+    uint64_t y=*(const uint64_t *)b;
+    return x<y ? -1 : x>y;
+}
+
+/** Print the measure of op from the duration of each of its n calls.
+ */
+static void report(bench_s *b, const char *op, uint64_t *ns, int n)
+{
+    uint64_t total=0;
+    if(n<=0)
+        return;
+    for(int i=0; i<n; i++)
+        total+=ns[i];
+    qsort(ns, n, sizeof(*ns), ns_cmp);
+    fprintf(b->out, "{\"packages\":%d,\"slackware\":%d,\"installed\":%d,\"op\":\"%s\",\"iterations\":%d,"
+            "\"p50_us\":%.3f,\"p99_us\":%.3f,\"ops_per_s\":%.0f,\"peak_rss_kb\":%ld}\n",
+            b->size->packages, b->size->slackware, b->size->installed, op, n,
+            ns[(n-1)/2]/1e3, ns[(size_t)((n-1)*0.99)]/1e3, total ? n/(total/1e9) : 0.0, peak_rss_kb());
+    fflush(b->out);
+}
+
+/** Release every index, so that the next query loads them again.
+ */
+static void release_all(void)
+{
+    trigram_release();
+    deps_release();
+    sb_index_release();
+    installed_release();
+    changelog_release();
+    slack_index_release();
+}
+
+static void load_all(bench_s *b)
+{
+    sb_index_get();
+    trigram_get();
+    installed_table();
+    slack_index_get();
+    changelog_display(b->null, "");
+}
+
+/** Time the loading of the indexes, first built from the fixtures then
+ * mapped from \c BS_CACHEDIR.
+ */
+static void bench_load(bench_s *b)
+{
+    uint64_t ns;
+    uint64_t t=now_ns();
+    load_all(b);
+    ns=now_ns()-t;
+    report(b, "index_build", &ns, 1);
+    release_all();
+    t=now_ns();
+    load_all(b);
+    ns=now_ns()-t;
+    report(b, "index_load", &ns, 1);
+}
+
+/** The name of a random Slackbuild, or of a random Slackware package when slackware is set.
+ */
+static char *random_name(bench_s *b, int slackware)
+{
+    if(slackware)
+        return package_name(b->size->packages+random_below(&b->seed, b->size->slackware));
+    return package_name(random_below(&b->seed, b->size->packages));
+}
+
+static void bench_describe_package(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 0);
+        arena_s *a=arena_new();
+        uint64_t t=now_ns();
+        describe_package(a, name);
+        ns[i]=now_ns()-t;
+        arena_free(a);
+        g_free(name);
+    }
+    report(b, "describe_package", ns, b->iterations);
+}
+
+/** The whole of -D -d for one Slackbuild: record, .info, slack-desc,
+ * installed version, dependencies and printing.
+ */
+static void bench_describe(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 0);
+        arena_s *a=arena_new();
+        uint64_t t=now_ns();
+        describe_one(b->null, a, name, describe_slack(a, name));
+        ns[i]=now_ns()-t;
+        arena_free(a);
+        g_free(name);
+    }
+    report(b, "describe", ns, b->iterations);
+}
+
+static void bench_describe_slack(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 1);
+        arena_s *a=arena_new();
+        uint64_t t=now_ns();
+        describe_slack(a, name);
+        ns[i]=now_ns()-t;
+        arena_free(a);
+        g_free(name);
+    }
+    report(b, "describe_slack", ns, b->iterations);
+}
+
+/** Search for two to five letters taken from a random name, as -D -m would.
+ */
+static void bench_search_name(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 0);
+        size_t len=strlen(name);
+        size_t n=2+random_below(&b->seed, 4);
+        char *query=g_strndup(name+random_below(&b->seed, len>n ? len-n+1 : 1), n);
+        uint64_t t=now_ns();
+        search_name(query);
+        ns[i]=now_ns()-t;
+        g_free(query);
+        g_free(name);
+    }
+    report(b, "search_name", ns, b->iterations);
+}
+
+/** Half of the names looked up are installed.
+ */
+static void bench_is_package_installed(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, b->size->slackware>0 && i%2==0);
+        uint64_t t=now_ns();
+        is_package_installed(name);
+        ns[i]=now_ns()-t;
+        g_free(name);
+    }
+    report(b, "is_package_installed", ns, b->iterations);
+}
+
+/** Only the packages with dependencies are counted.
+ */
+static void bench_emphasize_requires(bench_s *b, uint64_t *ns)
+{
+    int n=0;
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 0);
+        arena_s *a=arena_new();
+        package_s *pkg=describe_package(a, name);
+        get_package_info(pkg);
+        if(pkg->requires[0]!='\0'){
+            uint64_t t=now_ns();
+            emphasize_requires(pkg);
+            ns[n++]=now_ns()-t;
+        }
+        arena_free(a);
+        g_free(name);
+    }
+    report(b, "emphasize_requires", ns, n);
+}
+
+static void bench_changelog(bench_s *b, uint64_t *ns)
+{
+    for(int i=0; i<b->iterations; i++){
+        char *name=random_name(b, 1);
+        uint64_t t=now_ns();
+        changelog_display(b->null, name);
+        ns[i]=now_ns()-t;
+        g_free(name);
+    }
+    report(b, "changelog", ns, b->iterations);
+}
+
+/**The SLACKBUILDS.TXT keys, for the parsers the scanner replaced.
+ */
+static const char *sb_keys[]={VAR_NAME, VAR_LOCATION, VAR_FILES, VAR_VERSION, VAR_DOWNLOAD,
+    VAR_DOWNLOAD64, VAR_MD5SUM, VAR_MD5SUM64, VAR_SHORTDESCR};
+#define NSB_KEYS (int)(sizeof(sb_keys)/sizeof(sb_keys[0]))
+
+/** Count the known keys of buf the way describe_package() did: strtok_r on
+ * lines then on the colon, g_strchug and a chain of strcmp.
+ */
+static long parse_strtok(char *buf)
+{
+    char *pline;
+    long found=0;
+    for(char *line=strtok_r(buf, "\n", &pline); line; line=strtok_r(NULL, "\n", &pline)){
+        char *pvalue;
+        char *t=strtok_r(line, ":", &pvalue);
+        g_strchug(pvalue);
+        for(int k=0; k<NSB_KEYS; k++)
+            if(!strcmp(t, sb_keys[k]))
+                found++;
+    }
+    return found;
+}
+
+/** Count the known keys of buf the way the index was built: memchr for the
+ * end of line, then strncmp against each key.
+ */
+static long parse_memchr(const char *buf, size_t len)
+{
+    const char *line=buf;
+    const char *eof=buf+len;
+    long found=0;
+    while(line<eof){
+        const char *end=memchr(line, '\n', eof-line);
+        if(end==NULL)
+            end=eof;
+        for(int k=0; k<NSB_KEYS; k++){
+            size_t klen=strlen(sb_keys[k]);
+            if((size_t)(end-line)>klen && !strncmp(line, sb_keys[k], klen) && line[klen]==':'){
+                found++;
+                break;
+            }
+        }
+        line=end<eof ? end+1 : eof;
+    }
+    return found;
+}
+
+static long parse_scan(const char *buf, size_t len)
+{
+    const char *line=buf;
+    const char *eof=buf+len;
+    long found=0;
+    while(line<eof){
+        scan_line_s l;
+        line=scan_line(line, eof, &l);
+        found+=l.key!=SCAN_NONE;
+    }
+    return found;
+}
+
+/** Print the throughput of a parser over n passes of len bytes.
+ */
+static void report_scan(bench_s *b, const char *op, size_t len, uint64_t ns, uint64_t cyc, long found)
+{
+    double bytes=(double)len*BENCH_SCAN_PASSES;
+    fprintf(b->out, "{\"packages\":%d,\"slackware\":%d,\"installed\":%d,\"op\":\"%s\",\"iterations\":%d,"
+            "\"bytes\":%zu,\"keys\":%ld,\"mb_per_s\":%.1f,\"bytes_per_cycle\":",
+            b->size->packages, b->size->slackware, b->size->installed, op, BENCH_SCAN_PASSES,
+            len, found, ns ? bytes/ns*1e3 : 0.0);
+    if(cyc)
+        fprintf(b->out, "%.3f}\n", bytes/cyc);
+    else
+        fprintf(b->out, "null}\n");
+    fflush(b->out);
+}
+
+/** Time the parsers of SLACKBUILDS.TXT lines over the whole file: the
+ * strtok_r and memchr paths replaced by the scanner, then the scanner with
+ * each variant the processor supports.
+ */
+static void bench_scan(bench_s *b)
+{
+    static const char *impls[]={"scalar", "sse2", "avx2"};
+    size_t len;
+    char *buf=map_file(SB_BUILDS_LIST, &len);
+    char *copy;
+    uint64_t ns=0, cyc=0, t, c;
+    long found=0;
+    if(buf==NULL)
+        return;
+    copy=malloc(len+1);
+    for(int i=0; i<BENCH_SCAN_PASSES; i++){
+        memcpy(copy, buf, len);
+        copy[len]='\0';
+        t=now_ns();
+        c=cycles();
+        found=parse_strtok(copy);
+        cyc+=cycles()-c;
+        ns+=now_ns()-t;
+    }
+    report_scan(b, "scan_strtok", len, ns, cyc, found);
+    ns=cyc=0;
+    t=now_ns();
+    c=cycles();
+    for(int i=0; i<BENCH_SCAN_PASSES; i++)
+        found=parse_memchr(buf, len);
+    report_scan(b, "scan_memchr", len, now_ns()-t, cycles()-c, found);
+    for(int k=0; k<(int)(sizeof(impls)/sizeof(impls[0])); k++){
+        char op[32];
+        if(scan_select(impls[k])<0)
+            continue;
+        t=now_ns();
+        c=cycles();
+        for(int i=0; i<BENCH_SCAN_PASSES; i++)
+            found=parse_scan(buf, len);
+        snprintf(op, sizeof(op), "scan_%s", impls[k]);
+        report_scan(b, op, len, now_ns()-t, cycles()-c, found);
+    }
+    scan_select(NULL);
+    free(copy);
+    munmap(buf, len);
+}
+
+/** Generate the fixtures of size under dir and time them in a child.
+ * \return 0 on success.
+ */
+static int bench_size(const char *dir, const bench_size_s *size, int iterations, uint64_t seed)
+{
+    char *sbo=g_strdup_printf("%s/%d/sbo/", dir, size->packages);
+    char *slack=g_strdup_printf("%s/%d/slackpkg/", dir, size->packages);
+    char *db=g_strdup_printf("%s/%d/packages/", dir, size->packages);
+    char *cache=g_strdup_printf("%s/%d/cache/", dir, size->packages);
+    uint64_t t=now_ns();
+    int status=1;
+    pid_t pid;
+    fprintf(stderr, "Generating %d packages, %d Slackware packages, %d installed\n",
+            size->packages, size->slackware, size->installed);
+    if(generate_sbo(sbo, size, &seed) || generate_slackware(slack, size, &seed)
+            || generate_installed(db, size))
+        goto done;
+    fprintf(stderr, "Generated in %.1f s\n", (now_ns()-t)/1e9);
+    fflush(stdout);
+    if((pid=fork())<0){
+        perror("fork");
+        goto done;
+    }
+    if(pid==0){
+        bench_s b={size, fdopen(dup(STDOUT_FILENO), "w"), fopen("/dev/null", "w"), iterations, seed};
+        uint64_t *ns=malloc(iterations*sizeof(*ns));
+        setenv("SB_REPODIR", sbo, 1);
+        setenv("SK_DB", slack, 1);
+        setenv("SB_DB", db, 1);
+        setenv("BS_CACHEDIR", cache, 1);
+        paths_release();
+        if(freopen("/dev/null", "w", stdout)==NULL)
+            _exit(1);
+        bench_load(&b);
+        bench_describe_package(&b, ns);
+        bench_describe_slack(&b, ns);
+        bench_describe(&b, ns);
+        bench_search_name(&b, ns);
+        bench_is_package_installed(&b, ns);
+        bench_emphasize_requires(&b, ns);
+        bench_changelog(&b, ns);
+        bench_scan(&b);
+        release_all();
+        free(ns);
+        fclose(b.out);
+        _exit(0);
+    }
+    while(waitpid(pid, &status, 0)<0 && errno==EINTR)
+        ;
+    status=!(WIFEXITED(status) && WEXITSTATUS(status)==0);
+done:
+    g_free(sbo);
+    g_free(slack);
+    g_free(db);
+    g_free(cache);
+    return status;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+/** Parse a size, N or N:M.  The Slackware catalog has N/4 packages and,
+ * unless given, M is N/4 as well.
+ * \return 0 on success, -1 if arg is not a size.
+ */
+static int parse_size(const char *arg, bench_size_s *size)
+{
+    char *end;
+    size->packages=strtol(arg, &end, 10);
+    if(end==arg || size->packages<=0)
+        return -1;
+    size->slackware=size->packages/4>0 ? size->packages/4 : 1;
+    size->installed=size->slackware;
+    if(*end==':'){
+        const char *m=end+1;
+        size->installed=strtol(m, &end, 10);
+        if(end==m || size->installed<0)
+            return -1;
+    }
+    return *end=='\0' ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-d workdir] [-s seed] N[:M]...\n", prog);
+    fprintf(stderr, "  N  Slackbuilds in the generated repository\n");
+    fprintf(stderr, "  M  installed packages, N/4 by default\n");
+    fprintf(stderr, "  -d keep the fixtures in workdir instead of a temporary directory\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations=BENCH_ITERATIONS;
+    uint64_t seed=BENCH_SEED;
+    char *dir=NULL;
+    char tmp[]="/tmp/brightbench.XXXXXX";
+    int keep=0;
+    int ret=0;
+    int opt;
+    while((opt=getopt(argc, argv, "n:d:s:h"))!=-1){
+        switch(opt){
+            case 'n': iterations=atoi(optarg); break;
+            case 'd': dir=optarg; keep=1; break;
+            case 's': seed=strtoull(optarg, NULL, 10); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind==argc || iterations<=0 || seed==0){
+        usage(argv[0]);
+        return 1;
+    }
+    if(dir==NULL && (dir=mkdtemp(tmp))==NULL){
+        perror("mkdtemp");
+        return 1;
+    }
+    for(int i=optind; i<argc && ret==0; i++){
+        bench_size_s size;
+        if(parse_size(argv[i], &size)<0){
+            fprintf(stderr, "Not a size: %s\n", argv[i]);
+            ret=1;
+            break;
+        }
+        ret=bench_size(dir, &size, iterations, seed);
+    }
+    if(!keep)
+        nftw(dir, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+    return ret;
+}
@@ -0,0 +1,438 @@
+/** \file
+ * Schedule and run the SlackBuilds.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_deps.h"
+#include "bright_pool.h"
+#include "bright_build.h"
+#include "bright_sources.h"
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+enum {BUILD_WAITING=0, BUILD_RUNNING, BUILD_DONE, BUILD_FAILED, BUILD_CANCELLED};
+
+/**A package to build.
+ */
+typedef struct {
+    uint32_t node;           //!< In the dependency graph.
+    const char *name;
+    int state;
+    uint32_t pending;        //!< Packages it requires not built yet.
+    double time;             //!< Expected build time, in seconds.
+    double chain;            //!< time plus the longest chain of builds waiting for it.
+    pid_t pid;
+    uint64_t start;          //!< stats_clock() when it started.
+    time_t started;          //!< time() when it started, to tell the packages it made.
+} build_job_s;
+
+/**The build of a set of packages.
+ */
+typedef struct {
+    sb_index_s *idx;
+    deps_graph_s *g;
+    build_job_s *jobs;
+    int count;
+    int32_t *slot;           //!< Job of each node of the graph, -1 if not built.
+    GHashTable *times;       //!< name -> seconds, from \c BUILD_TIMES.
+    const char *install;     //!< The command installing a package, empty for none.
+    const char *output;      //!< Where the packages are made.
+    int started;
+    int done;
+    int built;
+    int failed;
+    int cancelled;
+} build_s;
+
+/** Read the last build time of each package.
+ * \return a table of names to seconds, stored in the value pointers as doubles.
+ */
+static GHashTable *load_times(void)
+{
+    GHashTable *times=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    FILE *fp=fopen(CACHE_PATH(BUILD_TIMES), "r");
+    char line[MAXLEN];
+    if(fp==NULL)
+        return times;
+    STATS_COUNT(STATS_FOPEN, 1);
+    while(fgets(line, sizeof(line), fp)){
+        char name[MAXLEN];
+        double seconds;
+        if(sscanf(line, "%s %lf", name, &seconds)==2){
+            double *v=malloc(sizeof(double));
+            *v=seconds;
+            g_hash_table_insert(times, g_strdup(name), v);
+        }
+    }
+    fclose(fp);
+    return times;
+}
+
+static void save_times(GHashTable *times)
+{
+    GString *s=g_string_new(NULL);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, times);
+    while(g_hash_table_iter_next(&iter, &key, &value))
+        g_string_append_printf(s, "%s %.1f\n", (char *)key, *(double *)value);
+    write_file_atomic(CACHE_PATH(BUILD_TIMES), s->str, s->len); //Best effort
+    g_string_free(s, TRUE);
+}
+
+/** Return the job of the ready package heading the longest chain, -1 if
+ * no package is ready.
+ */
+static int next_ready(const build_s *b)
+{
+    int best=-1;
+    for(int i=0; i<b->count; i++)
+        if(b->jobs[i].state==BUILD_WAITING && b->jobs[i].pending==0
+                && (best<0 || b->jobs[i].chain>b->jobs[best].chain))
+            best=i;
+    return best;
+}
+
+/** Link the sources of package name found in the source cache into dir,
+ * where its SlackBuild looks for them.
+ */
+static void link_sources(const char *name, const char *dir)
+{
+    arena_s *a=arena_new();
+    package_s *pkg=describe_package(a, name);
+    if(pkg==NULL){
+        arena_free(a);
+        return;
+    }
+    const span_s *lists[2][3]={{&pkg->download, &pkg->md5sum, &pkg->sha256sum},
+        {&pkg->download_64, &pkg->md5sum_64, &pkg->sha256sum_64}};
+    for(int l=0; l<2; l++)
+        for(int i=0; i<lists[l][0]->count && i<lists[l][1]->count; i++){
+            const char *url=lists[l][0]->items[i];
+            const char *slash=rindex(url, '/');
+            char *dest=g_strconcat(dir, "/", slash ? slash+1 : url, NULL);
+            if(access(dest, F_OK)<0)
+                sources_fetch(lists[l][1]->items[i], i<lists[l][2]->count ? lists[l][2]->items[i] : NULL, dest);
+            g_free(dest);
+        }
+    arena_free(a);
+}
+
+/** Start the SlackBuild of job i, its output going to its log.
+ * \return 0 on success, -1 if it could not be started.
+ */
+static int start_build(build_s *b, int i)
+{
+    build_job_s *job=&b->jobs[i];
+    const sb_index_entry_s *e=&b->idx->entries[job->node];
+    const repo_s *r=repo_get(e->repo);
+    char *dir=g_strconcat(r->dir, sb_index_str(b->idx, e->location)+2, NULL);
+    char *log=g_strconcat(CACHE_PATH(BUILD_LOGS), job->name, ".log", NULL);
+    char *cmd=g_strdup_printf("sh ./%s.SlackBuild", job->name);
+    link_sources(job->name, dir);
+    fflush(stdout);
+    job->start=stats_clock();
+    job->started=time(NULL);
+    if((job->pid=fork())==0){
+        int fd=open(log, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        int null=open("/dev/null", O_RDONLY);
+        if(fd<0 || chdir(dir)<0){
+            perror(fd<0 ? log : dir);
+            _exit(127);
+        }
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if(null>=0)
+            dup2(null, 0);
+        execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+        _exit(127);
+    }
+    g_free(dir);
+    g_free(cmd);
+    if(job->pid<0){
+        fprintf(stderr, "Cannot start the build of %s: %s\n", job->name, strerror(errno));
+        g_free(log);
+        return -1;
+    }
+    job->state=BUILD_RUNNING;
+    printf("[%d/%d] Building %s, log in %s\n", ++b->started, b->count, job->name, log);
+    g_free(log);
+    return 0;
+}
+
+/** Cancel the packages waiting for job i, and the packages waiting for them.
+ */
+static void cancel_dependents(build_s *b, int i)
+{
+    const build_job_s *job=&b->jobs[i];
+    for(uint32_t k=b->g->roffsets[job->node]; k<b->g->roffsets[job->node+1]; k++){
+        int d=b->slot[b->g->redges[k]];
+        if(d<0 || b->jobs[d].state!=BUILD_WAITING)
+            continue;
+        b->jobs[d].state=BUILD_CANCELLED;
+        b->cancelled++;
+        b->done++;
+        printf("%s cancelled, it requires %s\n", b->jobs[d].name, job->name);
+        cancel_dependents(b, d);
+    }
+}
+
+/** Return the package made by job i: the one makepkg reports in its log,
+ * else the newest name-version-*-*.t?z made in the output directory since
+ * the job started.  Older packages left there are never taken.
+ * \return the path, to be freed by the caller, NULL if none is found.
+ */
+static char *find_package(const build_s *b, int i)
+{
+    const build_job_s *job=&b->jobs[i];
+    char *prefix=g_strdup_printf("%s-%s-", job->name, sb_index_str(b->idx, b->idx->entries[job->node].version));
+    char *log=g_strconcat(CACHE_PATH(BUILD_LOGS), job->name, ".log", NULL);
+    char *pattern=g_strdup_printf("%s/%s*-*.t?z", b->output, prefix);
+    char *path=NULL;
+    char line[MAXLEN];
+    time_t newest=job->started;
+    glob_t found;
+    FILE *fp=fopen(log, "r");
+    if(fp){
+        STATS_COUNT(STATS_FOPEN, 1);
+        while(fgets(line, sizeof(line), fp)){
+            const char *slash;
+            char *end=strstr(line, " created.");
+            if(strncmp(line, "Slackware package ", 18) || end==NULL)
+                continue;
+            *end='\0';
+            slash=rindex(line+18, '/');
+            if(strncmp(slash ? slash+1 : line+18, prefix, strlen(prefix)) || access(line+18, R_OK)<0)
+                continue;
+            g_free(path);
+            path=g_strdup(line+18);
+        }
+        fclose(fp);
+    }
+    if(path==NULL && glob(pattern, 0, NULL, &found)==0){
+        for(size_t k=0; k<found.gl_pathc; k++){
+            struct stat st;
+            if(stat(found.gl_pathv[k], &st)==0 && st.st_mtime>=newest){
+                newest=st.st_mtime;
+                g_free(path);
+                path=g_strdup(found.gl_pathv[k]);
+            }
+        }
+        globfree(&found);
+    }
+    g_free(prefix);
+    g_free(log);
+    g_free(pattern);
+    return path;
+}
+
+/** Install the package made by job i with the install command, its output
+ * appended to the log.  Only the coordinator installs, one package at a
+ * time, while the other SlackBuilds go on.
+ * \return 0 on success, -1 on failure.
+ */
+static int install_package(const build_s *b, int i)
+{
+    const build_job_s *job=&b->jobs[i];
+    char *path=find_package(b, i);
+    char *log=g_strconcat(CACHE_PATH(BUILD_LOGS), job->name, ".log", NULL);
+    char *cmd=g_strconcat(b->install, " \"$1\"", NULL);
+    int status=-1;
+    pid_t pid;
+    if(path==NULL){
+        printf("%s built but no package of it found in %s\n", job->name, b->output);
+        goto done;
+    }
+    printf("Installing %s\n", path);
+    fflush(stdout);
+    if((pid=fork())==0){
+        int fd=open(log, O_WRONLY|O_CREAT|O_APPEND, 0644);
+        int null=open("/dev/null", O_RDONLY);
+        if(fd<0){
+            perror(log);
+            _exit(127);
+        }
+        dup2(fd, 1);
+        dup2(fd, 2);
+        if(null>=0)
+            dup2(null, 0);
+        execl("/bin/sh", "sh", "-c", cmd, "sh", path, (char *)NULL);
+        _exit(127);
+    }
+    if(pid<0){
+        fprintf(stderr, "Cannot install %s: %s\n", path, strerror(errno));
+        goto done;
+    }
+    while(waitpid(pid, &status, 0)<0)
+        if(errno!=EINTR){
+            status=-1;
+            break;
+        }
+    if(status!=0)
+        printf("The install of %s failed, see %s\n", job->name, log);
+done:
+    g_free(path);
+    g_free(log);
+    g_free(cmd);
+    return status==0 ? 0 : -1;
+}
+
+/** Record the end of job i, with the status of its process, and install
+ * the package it made.
+ */
+static void finish_build(build_s *b, int i, int status)
+{
+    build_job_s *job=&b->jobs[i];
+    double seconds=(stats_clock()-job->start)/1e9;
+    b->done++;
+    if(WIFEXITED(status) && WEXITSTATUS(status)==0){
+        double *v=malloc(sizeof(double));
+        *v=seconds;
+        g_hash_table_insert(b->times, g_strdup(job->name), v);
+        printf("%s built in %.0fs\n", job->name, seconds);
+        if(b->install[0]=='\0' || install_package(b, i)==0){
+            job->state=BUILD_DONE;
+            b->built++;
+            for(uint32_t k=b->g->roffsets[job->node]; k<b->g->roffsets[job->node+1]; k++){
+                int d=b->slot[b->g->redges[k]];
+                if(d>=0)
+                    b->jobs[d].pending--;
+            }
+            return;
+        }
+    }
+    else if(WIFEXITED(status))
+        printf("%s failed with status %d, see %s%s.log\n", job->name, WEXITSTATUS(status),
+                CACHE_PATH(BUILD_LOGS), job->name);
+    else
+        printf("%s killed by signal %d\n", job->name, WIFSIGNALED(status) ? WTERMSIG(status) : 0);
+    job->state=BUILD_FAILED;
+    b->failed++;
+    cancel_dependents(b, i);
+}
+
+/** Build the packages of names and everything they require that is not
+ * installed, dependencies first.  As the SlackBuilds and the install, it
+ * must run as root.
+ * \param jobs the most SlackBuilds running at the same time, 0 for one per processor
+ * \return 0 if every package was built, 1 otherwise.
+ */
+int build_packages(char *names[], int count, int jobs)
+{
+    build_s b={};
+    uint32_t roots[count ? count : 1];
+    uint32_t *order;
+    double mean=0;
+    int running=0;
+    int cpus=pool_threads();
+    if(getuid())
+    {
+        fprintf(stderr,"%s\n", "Become root to build");
+        return 1;
+    }
+    b.idx=sb_index_get();
+    b.g=deps_get();
+    for(int i=0; i<count; i++){
+        const sb_index_entry_s *e=sb_index_lookup(b.idx, names[i]);
+        if(e==NULL){
+            printf("%s %s\n","Nothing found for", names[i]);
+            return 1;
+        }
+        roots[i]=e-b.idx->entries;
+    }
+    if((b.count=deps_order(b.g, roots, count, 1, &order))<0)
+        return 1;
+    if(b.count==0){
+        printf("%s\n", "Nothing to build, everything is installed");
+        free(order);
+        return 0;
+    }
+    if(jobs<=0)
+        jobs=cpus;
+    if(getenv("MAKEFLAGS")==NULL){
+        char flags[32];
+        snprintf(flags, sizeof(flags), "-j%d", cpus/jobs>1 ? cpus/jobs : 1);
+        setenv("MAKEFLAGS", flags, 1);
+    }
+    b.install=getenv("BS_INSTALLPKG") ? getenv("BS_INSTALLPKG") : BUILD_INSTALLPKG;
+    b.output=getenv("OUTPUT") && getenv("OUTPUT")[0] ? getenv("OUTPUT") : BUILD_OUTPUT;
+    mkdir(BS_CACHEDIR, 0755);
+    mkdir(CACHE_PATH(BUILD_LOGS), 0755);
+
+    //Expected times, the mean of the known ones for the packages never built
+    b.times=load_times();
+    if(g_hash_table_size(b.times)){
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, b.times);
+        while(g_hash_table_iter_next(&iter, NULL, &value))
+            mean+=*(double *)value;
+        mean/=g_hash_table_size(b.times);
+    }
+    else
+        mean=BUILD_DEFAULT_TIME;
+    b.jobs=calloc(b.count, sizeof(build_job_s));
+    b.slot=malloc(b.g->hdr->count*sizeof(int32_t));
+    memset(b.slot, 0xff, b.g->hdr->count*sizeof(int32_t));
+    for(int i=0; i<b.count; i++){
+        double *known;
+        b.slot[order[i]]=i;
+        b.jobs[i].node=order[i];
+        b.jobs[i].name=sb_index_str(b.idx, b.idx->entries[order[i]].name);
+        known=g_hash_table_lookup(b.times, b.jobs[i].name);
+        b.jobs[i].time=known ? *known : mean;
+    }
+    //order has dependencies first, so the chains are summed from the end
+    for(int i=b.count-1; i>=0; i--){
+        build_job_s *job=&b.jobs[i];
+        double longest=0;
+        for(uint32_t k=b.g->offsets[job->node]; k<b.g->offsets[job->node+1]; k++)
+            if(b.slot[b.g->edges[k]]>=0)
+                job->pending++;
+        for(uint32_t k=b.g->roffsets[job->node]; k<b.g->roffsets[job->node+1]; k++){
+            int d=b.slot[b.g->redges[k]];
+            if(d>=0 && b.jobs[d].chain>longest)
+                longest=b.jobs[d].chain;
+        }
+        job->chain=job->time+longest;
+    }
+    free(order);
+
+    printf("%d package%s to build, %d at a time\n", b.count, b.count>1 ? "s" : "", jobs);
+    while(b.done<b.count){
+        int i;
+        pid_t pid;
+        int status;
+        while(running<jobs && (i=next_ready(&b))>=0){
+            if(start_build(&b, i)==0)
+                running++;
+            else{
+                b.jobs[i].state=BUILD_FAILED;
+                b.failed++;
+                b.done++;
+                cancel_dependents(&b, i);
+            }
+        }
+        if(running==0)
+            break;
+        if((pid=waitpid(-1, &status, 0))<0){
+            if(errno==EINTR)
+                continue;
+            perror("waitpid");
+            break;
+        }
+        for(i=0; i<b.count; i++)
+            if(b.jobs[i].state==BUILD_RUNNING && b.jobs[i].pid==pid){
+                running--;
+                finish_build(&b, i, status);
+                break;
+            }
+    }
+    printf("%d built, %d failed, %d cancelled\n", b.built, b.failed, b.cancelled);
+    save_times(b.times);
+    g_hash_table_destroy(b.times);
+    free(b.jobs);
+    free(b.slot);
+    return b.built!=b.count;
+}
@@ -0,0 +1,32 @@
+/** \file
+ * Run the SlackBuilds of packages and of their dependencies.
+ *
+ * The packages asked for are expanded with the whole REQUIRES tree, the
+ * installed packages left out.  Each SlackBuild is run with sh in the
+ * directory of its package in the repository, where it expects its sources,
+ * and the package it makes is then installed with \c BUILD_INSTALLPKG, so
+ * that the packages requiring it can be built.  The package is the one
+ * makepkg reports in the log, else the newest of its name and version made
+ * in \c BUILD_OUTPUT since the build started.  The installs are run by
+ * brightstar itself, one at a time, and a failed install fails the build.
+ * Their output and the one of the SlackBuild go to a log of \c BUILD_LOGS in
+ * \c BS_CACHEDIR.  As the SlackBuilds, it all runs as root.
+ *
+ * Up to jobs SlackBuilds run at the same time, each told through MAKEFLAGS
+ * to use its share of the processors.  A package is ready once everything it
+ * requires is built, and of the ready ones the package heading the longest
+ * chain of builds still to come starts first, the time of a build being the
+ * time it took last, kept in \c BUILD_TIMES.  When a build fails, the
+ * packages requiring it are cancelled and the others go on.
+ */
+#ifndef BRIGHT_BUILD_H
+#define BRIGHT_BUILD_H
+
+#define BUILD_LOGS "build-logs/"        //!< The directory of the build logs in \c BS_CACHEDIR.
+#define BUILD_TIMES "build.times"       //!< The last build time of each package, in \c BS_CACHEDIR.
+#define BUILD_INSTALLPKG "upgradepkg --install-new --reinstall" //!< Installs a package built, unless BS_INSTALLPKG is set.
+#define BUILD_OUTPUT "/tmp"             //!< Where the SlackBuilds put their package, unless OUTPUT is set.
+#define BUILD_DEFAULT_TIME 60.0         //!< Seconds guessed for a package never built, if no package was.
+
+int build_packages(char *names[], int count, int jobs);
+#endif /* BRIGHT_BUILD_H */
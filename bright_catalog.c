@@ -0,0 +1,299 @@
+/** \file
+ * Build, cache and query the index of the Slackware catalog.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_catalog.h"
+#include "bright_scan.h"
+#include <sys/mman.h>
+
+static slack_index_s *slack_index=NULL;
+
+/**A package being indexed, before its strings go to the pool.
+ */
+typedef struct {
+    char *field[8];          //!< repo, name, version, arch, release, fullname, location, extension
+    char *patch;
+    uint64_t descr;
+    uint32_t descr_length;
+} pending_s;
+
+/** FNV-1a hash of a name, stable from one build to the next.
+ */
+static uint32_t name_hash(const char *s)
+{
+    uint32_t h=2166136261u;
+    for(; *s; s++){
+        h^=(unsigned char)*s;
+        h*=16777619u;
+    }
+    return h;
+}
+
+static uint32_t pool_add(GString *pool, const char *s)
+{
+    uint32_t offset;
+    if(s==NULL || *s=='\0')
+        return 0;
+    offset=pool->len;
+    g_string_append_len(pool, s, strlen(s)+1);
+    return offset;
+}
+
+/** Parse pkglist and PACKAGES.TXT into an index image.
+ * \param size receive the size of the image
+ * \return a malloc'ed image or NULL if pkglist cannot be read.
+ */
+static void *build_image(const struct stat *st_list, const struct stat *st_packages, size_t *size)
+{
+    GArray *pending=g_array_new(FALSE, TRUE, sizeof(pending_s));
+    GHashTable *names=g_hash_table_new(g_str_hash, g_str_equal);       //name -> position+1
+    GHashTable *fullnames=g_hash_table_new(g_str_hash, g_str_equal);   //fullname -> position+1
+    GHashTable *patches=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free); //name -> version
+    GString *pool=g_string_new(NULL);
+    slack_index_header_s hdr={};
+    GHashTableIter iter;
+    gpointer key, value;
+    char line[MAXLEN];
+    size_t len;
+    char *buf;
+    FILE *fp;
+    if((fp=fopen(SK_LIST_PATH, "r"))==NULL){
+        g_array_free(pending, TRUE);
+        g_hash_table_destroy(names);
+        g_hash_table_destroy(fullnames);
+        g_hash_table_destroy(patches);
+        g_string_free(pool, TRUE);
+        return NULL;
+    }
+    STATS_COUNT(STATS_FOPEN, 1);
+    while(fgets(line, sizeof(line), fp)){
+        char *pvalue;
+        char *field[8]={};
+        int i;
+        for(i=0; i<8; i++)
+            if((field[i]=strtok_r(i ? NULL : line, " \n", &pvalue))==NULL)
+                break;
+        if(i<3)
+            continue;
+        int pos=GPOINTER_TO_INT(g_hash_table_lookup(names, field[1]))-1;
+        if(!strcmp(field[0], "slackware") && pos<0){
+            pending_s p={};
+            for(int j=0; j<8; j++)
+                p.field[j]=field[j] ? strdup(field[j]) : NULL;
+            g_array_append_val(pending, p);
+            g_hash_table_insert(names, p.field[1], GINT_TO_POINTER(pending->len));
+            if(p.field[5])
+                g_hash_table_insert(fullnames, p.field[5], GINT_TO_POINTER(pending->len));
+        }
+        else if(!strcmp(field[0], "patches")) //slackpkg lists them before the slackware records
+            g_hash_table_replace(patches, g_strdup(field[1]), g_strdup(field[2]));
+    }
+    file_close(fp, SK_LIST_PATH);
+    g_hash_table_iter_init(&iter, patches);
+    while(g_hash_table_iter_next(&iter, &key, &value)){
+        int pos=GPOINTER_TO_INT(g_hash_table_lookup(names, key))-1;
+        if(pos>=0)
+            g_array_index(pending, pending_s, pos).patch=strdup(value);
+    }
+
+    //Byte range of the record of every package in PACKAGES.TXT
+    if((buf=map_file(SK_PACKAGES, &len))){
+        const char *p=buf;
+        const char *eof=buf+len;
+        pending_s *cur=NULL;
+        while(p<eof){
+            scan_line_s l;
+            const char *next=scan_line(p, eof, &l);
+            if(l.key==SCAN_PKG_NAME){
+                const char *v=l.value;
+                const char *end=l.end;
+                const char *ext;
+                char *fullname;
+                int pos;
+                while(v<end && isspace((unsigned char)*v))
+                    v++;
+                for(ext=end; ext>v && *ext!='.'; ext--)
+                    ;
+                fullname=strndup(v, (ext>v ? ext : end)-v);
+                pos=GPOINTER_TO_INT(g_hash_table_lookup(fullnames, fullname))-1;
+                free(fullname);
+                cur=pos>=0 ? &g_array_index(pending, pending_s, pos) : NULL;
+                if(cur)
+                    cur->descr=p-buf;
+            }
+            else if(cur && *p=='\n')//Blank line, the record is complete
+                cur=NULL;
+            if(cur)
+                cur->descr_length=next-buf-cur->descr;
+            p=next;
+        }
+        munmap(buf, len);
+    }
+
+    hdr.count=pending->len;
+    hdr.nbuckets=16;
+    while(hdr.nbuckets<2*hdr.count)
+        hdr.nbuckets*=2;
+    slack_index_entry_s *entries=calloc(hdr.count ? hdr.count : 1, sizeof(*entries));
+    uint32_t *buckets=calloc(hdr.nbuckets, sizeof(uint32_t));
+    g_string_append_c(pool, '\0'); //offset 0 is the empty string
+    for(uint32_t i=0; i<hdr.count; i++){
+        pending_s *p=&g_array_index(pending, pending_s, i);
+        slack_index_entry_s *e=&entries[i];
+        uint32_t b=name_hash(p->field[1])&(hdr.nbuckets-1);
+        e->repo=pool_add(pool, p->field[0]);
+        e->name=pool_add(pool, p->field[1]);
+        e->version=pool_add(pool, p->field[2]);
+        e->arch=pool_add(pool, p->field[3]);
+        e->release=pool_add(pool, p->field[4]);
+        e->fullname=pool_add(pool, p->field[5]);
+        e->location=pool_add(pool, p->field[6]);
+        e->extension=pool_add(pool, p->field[7]);
+        e->patch=pool_add(pool, p->patch);
+        e->descr=p->descr;
+        e->descr_length=p->descr_length;
+        while(buckets[b])
+            b=(b+1)&(hdr.nbuckets-1);
+        buckets[b]=i+1;
+        for(int j=0; j<8; j++)
+            free(p->field[j]);
+        free(p->patch);
+    }
+    memcpy(hdr.magic, SLACK_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.list_size=st_list->st_size;
+    hdr.list_mtime=stamp_mtime(st_list);
+    hdr.packages_size=st_packages->st_size;
+    hdr.packages_mtime=stamp_mtime(st_packages);
+    hdr.strings_size=pool->len;
+    *size=sizeof(hdr)+hdr.count*sizeof(*entries)+hdr.nbuckets*sizeof(uint32_t)+pool->len;
+    char *image=malloc(*size);
+    char *p=image;
+    memcpy(p, &hdr, sizeof(hdr));
+    p+=sizeof(hdr);
+    memcpy(p, entries, hdr.count*sizeof(*entries));
+    p+=hdr.count*sizeof(*entries);
+    memcpy(p, buckets, hdr.nbuckets*sizeof(uint32_t));
+    p+=hdr.nbuckets*sizeof(uint32_t);
+    memcpy(p, pool->str, pool->len);
+    free(entries);
+    free(buckets);
+    g_array_free(pending, TRUE);
+    g_hash_table_destroy(names);
+    g_hash_table_destroy(fullnames);
+    g_hash_table_destroy(patches);
+    g_string_free(pool, TRUE);
+    return image;
+}
+
+/** Point the index members to their place in the image and check the image
+ * is consistent and was built from the current pkglist and PACKAGES.TXT.
+ * \return 0 if the image can be used, -1 otherwise.
+ */
+static int attach_image(slack_index_s *idx, const struct stat *st_list, const struct stat *st_packages)
+{
+    const slack_index_header_s *hdr=idx->data;
+    if(idx->size<sizeof(*hdr) || memcmp(hdr->magic, SLACK_INDEX_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    if(!stamp_matches(st_list, hdr->list_size, hdr->list_mtime)
+            || !stamp_matches(st_packages, hdr->packages_size, hdr->packages_mtime))
+        return -1;
+    if(hdr->nbuckets==0 || (hdr->nbuckets&(hdr->nbuckets-1)) || hdr->count>=hdr->nbuckets || hdr->strings_size==0)
+        return -1;
+    if(idx->size!=sizeof(*hdr)+(size_t)hdr->count*sizeof(slack_index_entry_s)
+            +(size_t)hdr->nbuckets*sizeof(uint32_t)+hdr->strings_size)
+        return -1;
+    idx->hdr=hdr;
+    idx->entries=(const slack_index_entry_s *)(hdr+1);
+    idx->buckets=(const uint32_t *)(idx->entries+hdr->count);
+    idx->strings=(const char *)(idx->buckets+hdr->nbuckets);
+    if(idx->strings[hdr->strings_size-1]!='\0') //Every string is terminated inside the pool
+        return -1;
+    return 0;
+}
+
+/** Return the index of the Slackware catalog, opening or rebuilding it on first use.
+ * A missing PACKAGES.TXT only leaves the sizes and descriptions out.
+ * \return the index, NULL if pkglist cannot be read.
+ */
+slack_index_s *slack_index_try_get(void)
+{
+    struct stat st_list, st_packages={};
+    uint64_t t;
+    if(slack_index)
+        return slack_index;
+    t=STATS_BEGIN();
+    if(stat(SK_LIST_PATH, &st_list)<0)
+        return NULL;
+    stat(SK_PACKAGES, &st_packages);
+    slack_index=calloc(1, sizeof(*slack_index));
+    if((slack_index->data=map_file(CACHE_PATH(SLACK_INDEX), &slack_index->size))){
+        slack_index->mapped=1;
+        if(attach_image(slack_index, &st_list, &st_packages)==0){
+            STATS_END(STATS_INDEX, t);
+            return slack_index;
+        }
+        munmap(slack_index->data, slack_index->size);
+        slack_index->mapped=0;
+    }
+    if((slack_index->data=build_image(&st_list, &st_packages, &slack_index->size))==NULL){
+        free(slack_index);
+        slack_index=NULL;
+        return NULL;
+    }
+    write_file_atomic(CACHE_PATH(SLACK_INDEX), slack_index->data, slack_index->size); //Best effort, may not be root
+    attach_image(slack_index, &st_list, &st_packages);
+    STATS_END(STATS_INDEX, t);
+    return slack_index;
+}
+
+/** Return the index of the Slackware catalog, as \c slack_index_try_get() does.
+ * Exit if pkglist cannot be read, as \c file_open() would.
+ */
+slack_index_s *slack_index_get(void)
+{
+    slack_index_s *idx=slack_index_try_get();
+    if(idx==NULL){
+        printf("Cannot open file %s for mode %s\n", SK_LIST_PATH, "r");
+        printf("%s\n","Cannot proceed further");
+        exit(1);
+    }
+    return idx;
+}
+
+/** Unmap or free the index.
+ */
+void slack_index_release(void)
+{
+    if(slack_index==NULL)
+        return;
+    if(slack_index->mapped)
+        munmap(slack_index->data, slack_index->size);
+    else
+        free(slack_index->data);
+    free(slack_index);
+    slack_index=NULL;
+}
+
+/** Return the string stored at offset in the pool, or the empty string if
+ * offset is outside the pool.
+ */
+const char *slack_index_str(slack_index_s *idx, uint32_t offset)
+{
+    return offset<idx->hdr->strings_size ? idx->strings+offset : "";
+}
+
+/** Find a Slackware package by name.
+ * \return the entry or NULL if there is no such package.
+ */
+const slack_index_entry_s *slack_index_lookup(slack_index_s *idx, const char *name)
+{
+    uint32_t mask=idx->hdr->nbuckets-1;
+    uint32_t b=name_hash(name)&mask;
+    for(uint32_t n=0; n<idx->hdr->nbuckets && idx->buckets[b]; n++, b=(b+1)&mask){
+        uint32_t i=idx->buckets[b]-1;
+        if(i<idx->hdr->count && !strcmp(slack_index_str(idx, idx->entries[i].name), name))
+            return &idx->entries[i];
+    }
+    return NULL;
+}
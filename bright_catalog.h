@@ -0,0 +1,68 @@
+/** \file
+ * On-disk index of the Slackware catalog, pkglist and PACKAGES.TXT.
+ *
+ * Each Slackware package gets an entry holding the fields of its pkglist
+ * record, the version of its latest patches record and the byte range of
+ * its record in PACKAGES.TXT.  Entries are found through an open addressing
+ * hash table on the package name, so describing a package reads no more
+ * than its own PACKAGES.TXT record.
+ */
+#ifndef BRIGHT_CATALOG_H
+#define BRIGHT_CATALOG_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define SLACK_INDEX "slackware.idx"      //!< The index file of the Slackware catalog.
+#define SLACK_INDEX_MAGIC "BSSLK02"      //!< Change it whenever the layout below or its content changes.
+
+/**Header of the index, followed by entries[count], buckets[nbuckets] and
+ * the string pool.  The sizes and mtimes are those of pkglist and
+ * PACKAGES.TXT when the index was built.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t list_size;
+    int64_t list_mtime;       //!< In nanoseconds.
+    uint64_t packages_size;
+    int64_t packages_mtime;   //!< In nanoseconds.
+    uint32_t count;           //!< Number of entries.
+    uint32_t nbuckets;        //!< Size of the hash table, a power of two.
+    uint32_t strings_size;    //!< Size of the string pool.
+    uint32_t pad;
+} slack_index_header_s;
+
+/**One Slackware package.  String fields are offsets in the pool, 0 being
+ * the empty string.
+ */
+typedef struct {
+    uint32_t name;
+    uint32_t repo;
+    uint32_t version;
+    uint32_t arch;
+    uint32_t release;
+    uint32_t fullname;
+    uint32_t location;
+    uint32_t extension;
+    uint32_t patch;           //!< Version of the latest patches record.
+    uint32_t descr_length;    //!< Length of the PACKAGES.TXT record, 0 if there is none.
+    uint64_t descr;           //!< Offset of the PACKAGES.TXT record.
+} slack_index_entry_s;
+
+/**An opened index, either mapped from the cache or built in memory.
+ */
+typedef struct {
+    void *data;
+    size_t size;
+    int mapped;
+    const slack_index_header_s *hdr;
+    const slack_index_entry_s *entries;
+    const uint32_t *buckets;          //!< Entry number plus one, 0 for an empty bucket.
+    const char *strings;
+} slack_index_s;
+
+slack_index_s *slack_index_try_get(void);
+slack_index_s *slack_index_get(void);
+void slack_index_release(void);
+const slack_index_entry_s *slack_index_lookup(slack_index_s *idx, const char *name);
+const char *slack_index_str(slack_index_s *idx, uint32_t offset);
+#endif /* BRIGHT_CATALOG_H */
@@ -0,0 +1,351 @@
+/** \file
+ * Build, update and query the index of the Slackware ChangeLog.txt.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_changelog.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/**An opened ChangeLog index, either mapped from the cache or built in memory.
+ */
+typedef struct {
+    void *data;
+    size_t size;
+    int mapped;
+    const changelog_header_s *hdr;
+    const changelog_item_s *items;
+    const char *strings;
+} changelog_s;
+
+/**An item being indexed, before its name goes to the string pool.
+ */
+typedef struct {
+    const char *name;
+    changelog_item_s item;
+} pending_s;
+
+static changelog_s *changelog=NULL;
+
+/** Return the package name of an item line, like
+ * "patches/packages/bind-9.9.2_P1-i486-1_slack14.0.txz:  Upgraded."
+ * \return a malloc'ed name, or NULL if the line does not name a package file.
+ */
+static char *item_name(const char *line, const char *end)
+{
+    static const char *ext[]={".txz", ".tgz", ".tbz", ".tlz", NULL};
+    const char *colon=line;
+    const char *base;
+    char *fullname;
+    char *name=NULL;
+    installed_s *inst;
+    while(colon<end && *colon!=':' && !isspace((unsigned char)*colon))
+        colon++;
+    if(colon==end || *colon!=':' || colon-line<4)
+        return NULL;
+    for(int i=0; ext[i]; i++){
+        if(strncmp(colon-4, ext[i], 4))
+            continue;
+        for(base=colon-4; base>line && base[-1]!='/'; base--)
+            ;
+        fullname=strndup(base, colon-4-base);
+        if((inst=installed_parse(fullname))){
+            name=strdup(inst->name);
+            installed_free(inst);
+        }
+        free(fullname);
+        break;
+    }
+    return name;
+}
+
+/** Parse the entries of buf between start and end, which must begin at the
+ * date line of an entry, and append their items to pending.
+ * \param last_entry receive the offset of the last date line seen
+ */
+static void parse_region(const char *buf, size_t start, size_t end, GArray *pending, uint64_t *last_entry)
+{
+    const char *line=buf+start;
+    const char *eof=buf+end;
+    int expect_date=1;
+    int cur=-1;
+    uint64_t date=0;
+    uint32_t date_len=0;
+    while(line<eof){
+        const char *nl=memchr(line, '\n', eof-line);
+        const char *next=nl ? nl+1 : eof;
+        if(*line=='+'){//Entry separator
+            expect_date=1;
+            cur=-1;
+        }
+        else if(expect_date){
+            if(!isspace((unsigned char)*line)){
+                date=line-buf;
+                date_len=next-line;
+                *last_entry=date;
+                expect_date=0;
+            }
+        }
+        else if(*line==' ' || *line=='\t'){//Comment of the current item
+            if(cur>=0){
+                pending_s *p=&g_array_index(pending, pending_s, cur);
+                p->item.item_len=next-buf-p->item.item;
+            }
+        }
+        else{
+            pending_s p={};
+            cur=-1;
+            if((p.name=item_name(line, next))){
+                p.item.date=date;
+                p.item.date_len=date_len;
+                p.item.item=line-buf;
+                p.item.item_len=next-line;
+                g_array_append_val(pending, p);
+                cur=pending->len-1;
+            }
+        }
+        line=next;
+    }
+}
+
+static int pending_cmp(const void *a, const void *b)
+{
+    const pending_s *pa=a;
+    const pending_s *pb=b;
+    int c=strcmp(pa->name, pb->name);
+    if(c)
+        return c;
+    return pa->item.item<pb->item.item ? -1 : pa->item.item>pb->item.item;
+}
+
+/** Compute the MD5 of the first or last CHANGELOG_SIG bytes of buf.
+ */
+static void signature(const char *buf, size_t size, int tail, unsigned char *md)
+{
+    size_t n=size<CHANGELOG_SIG ? size : CHANGELOG_SIG;
+    MD5((const unsigned char *)buf+(tail ? size-n : 0), n, md);
+}
+
+/** Point the index members to their place in the image.
+ * \return 0 if the image is consistent, -1 otherwise.
+ */
+static int attach_image(changelog_s *cl)
+{
+    const changelog_header_s *hdr=cl->data;
+    if(cl->size<sizeof(*hdr) || memcmp(hdr->magic, CHANGELOG_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    if(cl->size!=sizeof(*hdr)+(size_t)hdr->count*sizeof(changelog_item_s)+hdr->strings_size)
+        return -1;
+    cl->hdr=hdr;
+    cl->items=(const changelog_item_s *)(hdr+1);
+    cl->strings=(const char *)(cl->items+hdr->count);
+    return 0;
+}
+
+/** Index ChangeLog.txt, reusing the items of old when its content is found
+ * unchanged in buf, with new entries before or after it.
+ * \param buf the content of ChangeLog.txt
+ * \param st its stat
+ * \param old the current index, or NULL
+ * \param size receive the size of the image
+ * \return a malloc'ed image.
+ */
+static void *build_image(const char *buf, const struct stat *st, const changelog_s *old, size_t *size)
+{
+    GArray *pending=g_array_new(FALSE, FALSE, sizeof(pending_s));
+    GString *pool=g_string_new(NULL);
+    changelog_header_s hdr={};
+    size_t len=st->st_size;
+    size_t start=0;       //Where parsing begins
+    size_t stop=len;      //Where parsing ends
+    int64_t shift=0;      //Move of the old items
+    uint64_t keep=0;      //Old items before this offset are kept
+    if(old && old->hdr->src_size>0 && len>old->hdr->src_size){
+        size_t oldlen=old->hdr->src_size;
+        size_t delta=len-oldlen;
+        unsigned char head[16], tail[16];
+        signature(buf+delta, oldlen, 0, head);
+        signature(buf+delta, oldlen, 1, tail);
+        if(!memcmp(head, old->hdr->head, 16) && !memcmp(tail, old->hdr->tail, 16)){
+            //New entries at the top, the Slackware way
+            stop=delta;
+            shift=delta;
+            keep=UINT64_MAX;
+        }
+        else{
+            signature(buf, oldlen, 0, head);
+            signature(buf, oldlen, 1, tail);
+            if(!memcmp(head, old->hdr->head, 16) && !memcmp(tail, old->hdr->tail, 16)){
+                //New bytes at the end, the last entry may have grown
+                start=old->hdr->last_entry;
+                keep=old->hdr->last_entry;
+            }
+        }
+    }
+    if(keep){
+        hdr.last_entry=old->hdr->last_entry+shift;
+        for(uint32_t i=0; i<old->hdr->count; i++){
+            pending_s p={strdup(old->strings+old->items[i].name), old->items[i]};
+            if(p.item.item>=keep){
+                free((char *)p.name);
+                continue;
+            }
+            p.item.date+=shift;
+            p.item.item+=shift;
+            g_array_append_val(pending, p);
+        }
+    }
+    uint64_t last_entry=hdr.last_entry;
+    parse_region(buf, start, stop, pending, &last_entry);
+    if(shift==0)
+        hdr.last_entry=last_entry;
+    qsort(pending->data, pending->len, sizeof(pending_s), pending_cmp);
+
+    g_string_append_c(pool, '\0');
+    for(guint i=0; i<pending->len; i++){
+        pending_s *p=&g_array_index(pending, pending_s, i);
+        if(i>0 && !strcmp(p->name, g_array_index(pending, pending_s, i-1).name))
+            p->item.name=g_array_index(pending, pending_s, i-1).item.name;
+        else{
+            p->item.name=pool->len;
+            g_string_append_len(pool, p->name, strlen(p->name)+1);
+        }
+    }
+    memcpy(hdr.magic, CHANGELOG_MAGIC, sizeof(hdr.magic));
+    hdr.src_size=len;
+    hdr.src_mtime=stamp_mtime(st);
+    signature(buf, len, 0, hdr.head);
+    signature(buf, len, 1, hdr.tail);
+    hdr.count=pending->len;
+    hdr.strings_size=pool->len;
+    *size=sizeof(hdr)+hdr.count*sizeof(changelog_item_s)+pool->len;
+    char *image=malloc(*size);
+    char *p=image+sizeof(hdr);
+    memcpy(image, &hdr, sizeof(hdr));
+    for(guint i=0; i<pending->len; i++){
+        pending_s *pi=&g_array_index(pending, pending_s, i);
+        memcpy(p, &pi->item, sizeof(pi->item));
+        p+=sizeof(pi->item);
+        free((char *)pi->name);
+    }
+    memcpy(p, pool->str, pool->len);
+    g_array_free(pending, TRUE);
+    g_string_free(pool, TRUE);
+    return image;
+}
+
+/** Return the index of \c SK_CHANGELOG, opening, updating or rebuilding it on first use.
+ * \return the index, or NULL if ChangeLog.txt cannot be read.
+ */
+static changelog_s *changelog_get(void)
+{
+    struct stat st;
+    changelog_s old={};
+    size_t len;
+    char *buf;
+    uint64_t t;
+    if(changelog)
+        return changelog;
+    if(stat(SK_CHANGELOG, &st)<0)
+        return NULL;
+    t=STATS_BEGIN();
+    changelog=calloc(1, sizeof(*changelog));
+    if((changelog->data=map_file(CACHE_PATH(CHANGELOG_CACHE), &changelog->size))){
+        changelog->mapped=1;
+        if(attach_image(changelog)==0){
+            if(stamp_matches(&st, changelog->hdr->src_size, changelog->hdr->src_mtime)){
+                STATS_END(STATS_INDEX, t);
+                return changelog;
+            }
+            old=*changelog;
+        }
+        else
+            munmap(changelog->data, changelog->size);
+    }
+    if((buf=map_file(SK_CHANGELOG, &len))==NULL || len!=(size_t)st.st_size){
+        if(buf)
+            munmap(buf, len);
+        if(old.data)
+            munmap(old.data, old.size);
+        free(changelog);
+        changelog=NULL;
+        STATS_END(STATS_INDEX, t);
+        return NULL;
+    }
+    changelog->data=build_image(buf, &st, old.data ? &old : NULL, &changelog->size);
+    changelog->mapped=0;
+    munmap(buf, len);
+    if(old.data)
+        munmap(old.data, old.size);
+    write_file_atomic(CACHE_PATH(CHANGELOG_CACHE), changelog->data, changelog->size); //Best effort, may not be root
+    attach_image(changelog);
+    STATS_END(STATS_INDEX, t);
+    return changelog;
+}
+
+/** Unmap or free the ChangeLog index.
+ */
+void changelog_release(void)
+{
+    if(changelog==NULL)
+        return;
+    if(changelog->mapped)
+        munmap(changelog->data, changelog->size);
+    else
+        free(changelog->data);
+    free(changelog);
+    changelog=NULL;
+}
+
+/** Copy len bytes of fd at offset to out.
+ */
+static void copy_range(FILE *out, int fd, uint64_t offset, uint32_t len)
+{
+    char *buf=malloc(len);
+    ssize_t n=pread(fd, buf, len, offset);
+    if(n>0){
+        STATS_FILE(SK_CHANGELOG, n);
+        fwrite(buf, 1, n, out);
+        if(buf[n-1]!='\n')
+            fputc('\n', out);
+    }
+    free(buf);
+}
+
+/** Print the ChangeLog items of a Slackware package, each after the date of its entry.
+ * \param out where to print
+ * \param name the package name
+ * \return the number of items printed.
+ */
+int changelog_display(FILE *out, const char *name)
+{
+    changelog_s *cl=changelog_get();
+    size_t lo=0, hi;
+    int fd;
+    int found=0;
+    if(cl==NULL){
+        printf("Cannot open file %s for mode %s\n", SK_CHANGELOG, "r");
+        return 0;
+    }
+    hi=cl->hdr->count;
+    while(lo<hi){//First item of name
+        size_t mid=lo+(hi-lo)/2;
+        if(strcmp(cl->strings+cl->items[mid].name, name)<0)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    if(lo==cl->hdr->count || strcmp(cl->strings+cl->items[lo].name, name))
+        return 0;
+    if((fd=open(SK_CHANGELOG, O_RDONLY))<0)
+        return 0;
+    STATS_COUNT(STATS_FOPEN, 1);
+    for(; lo<cl->hdr->count && !strcmp(cl->strings+cl->items[lo].name, name); lo++){
+        copy_range(out, fd, cl->items[lo].date, cl->items[lo].date_len);
+        copy_range(out, fd, cl->items[lo].item, cl->items[lo].item_len);
+        found++;
+    }
+    close(fd);
+    return found;
+}
@@ -0,0 +1,48 @@
+/** \file
+ * Index of the Slackware ChangeLog.txt by package name.
+ *
+ * Each item of the ChangeLog, a line naming a package file followed by its
+ * indented comment lines, is recorded with the byte range of the item and of
+ * the date line of its entry.  Items are sorted on the package name, so the
+ * changelog of a package is a binary search followed by a few preads.
+ *
+ * Slackware adds new entries at the top of ChangeLog.txt.  When the file
+ * grows and its previous content is found unchanged at its end, or at its
+ * beginning, only the new bytes are parsed and the index is updated in place.
+ */
+#ifndef BRIGHT_CHANGELOG_H
+#define BRIGHT_CHANGELOG_H
+#include <stdint.h>
+#include <stdio.h>
+
+#define CHANGELOG_CACHE "changelog.idx"   //!< The index file of ChangeLog.txt.
+#define CHANGELOG_MAGIC "BSCHG01"         //!< Change it whenever the layout below changes.
+#define CHANGELOG_SIG 4096                //!< Bytes at each end of the file checked before an update.
+
+/**Header of the index, followed by items[count] and the string pool.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t src_size;             //!< Size of ChangeLog.txt when indexed.
+    int64_t src_mtime;             //!< Mtime of ChangeLog.txt when indexed, in nanoseconds.
+    uint64_t last_entry;           //!< Offset of the date line of the last entry.
+    unsigned char head[16];        //!< MD5 of the first CHANGELOG_SIG bytes.
+    unsigned char tail[16];        //!< MD5 of the last CHANGELOG_SIG bytes.
+    uint32_t count;                //!< Number of items.
+    uint32_t strings_size;         //!< Size of the string pool.
+} changelog_header_s;
+
+/**One item of the ChangeLog.  name is an offset in the pool.
+ */
+typedef struct {
+    uint64_t date;         //!< Offset of the date line of the entry.
+    uint64_t item;         //!< Offset of the item line.
+    uint32_t date_len;     //!< Length of the date line, newline included.
+    uint32_t item_len;     //!< Length of the item and its comments.
+    uint32_t name;         //!< Package name.
+    uint32_t pad;
+} changelog_item_s;
+
+int changelog_display(FILE *out, const char *name);
+void changelog_release(void);
+#endif /* BRIGHT_CHANGELOG_H */
@@ -0,0 +1,437 @@
+/** \file
+ * Build, cache and walk the dependency graph.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_pool.h"
+#include "bright_deps.h"
+#include "bright_repo.h"
+#include <sys/mman.h>
+
+static deps_graph_s *deps=NULL;
+
+/** Return the REQUIRES value of an .info file, backslash continuations included.
+ * \param path the .info file
+ * \return the value to be freed by the caller, or NULL if the file cannot be read.
+ */
+char *read_info_requires(const char *path)
+{
+    FILE *fp=fopen(path, "r");
+    char line[MAXLEN];
+    GString *value=NULL;
+    int quotes=0;
+    if(fp==NULL)
+        return NULL;
+    STATS_COUNT(STATS_FOPEN, 1);
+    while(fgets(line, sizeof(line), fp)){
+        char *p=line;
+        if(value==NULL){
+            if(strncmp(line, "REQUIRES=", 9))
+                continue;
+            value=g_string_new(NULL);
+            p+=9;
+        }
+        for(; *p && *p!='\n'; p++){
+            if(*p=='"')
+                quotes++;
+            else if(*p!='\\')
+                g_string_append_c(value, *p);
+        }
+        g_string_append_c(value, ' ');
+        if(quotes!=1 && !strstr(line, "\\\n")) //Value is complete
+            break;
+    }
+    file_close(fp, path);
+    return value ? g_string_free(value, FALSE) : strdup("");
+}
+
+typedef struct {
+    sb_index_s *idx;
+    char **requires;
+    GHashTable *previous;    //!< REQUIRES known before a sync, by package directory.
+    GHashTable *changed;     //!< Package directories touched by the sync.
+} deps_load_s;
+
+/** Return the directory of a package prefixed with the name of its
+ * repository, like "SBo/academic/foo", to be freed by the caller.
+ */
+static char *package_dir(sb_index_s *idx, const sb_index_entry_s *e)
+{
+    return g_strconcat(repo_get(e->repo)->name, "/", sb_index_str(idx, e->location)+2, NULL);
+}
+
+static void load_requires(size_t i, void *arg)
+{
+    deps_load_s *load=arg;
+    const sb_index_entry_s *e=&load->idx->entries[i];
+    const char *location=sb_index_str(load->idx, e->location);
+    char *path;
+    if(strlen(location)<2)
+        return;
+    if(load->previous){
+        char *dir=package_dir(load->idx, e);
+        const char *requires=NULL;
+        if(!g_hash_table_contains(load->changed, dir))
+            requires=g_hash_table_lookup(load->previous, dir);
+        g_free(dir);
+        if(requires){
+            load->requires[i]=strdup(requires);
+            return;
+        }
+    }
+    path=g_strconcat(repo_get(e->repo)->dir, location+2, "/", sb_index_str(load->idx, e->name), ".info", NULL);
+    load->requires[i]=read_info_requires(path);
+    g_free(path);
+}
+
+/** Read the REQUIRES of every package, in parallel, and lay out the graph image.
+ * \param previous if not NULL, the REQUIRES of packages by name, reused for
+ *        the packages whose directory is not in changed
+ */
+static void *build_image(sb_index_s *idx, size_t *size, GHashTable *previous, GHashTable *changed)
+{
+    uint32_t count=idx->hdr->count;
+    deps_load_s load={idx, calloc(count, sizeof(char *)), previous, changed};
+    uint32_t *offsets=malloc((count+1)*sizeof(uint32_t));
+    uint8_t *flags=calloc(count, 1);
+    uint32_t *edges=NULL;
+    size_t nedges=0, alloc=0;
+    parallel_for(count, load_requires, &load);
+    for(uint32_t i=0; i<count; i++){
+        char *t;
+        char *pt;
+        offsets[i]=nedges;
+        if(load.requires[i]==NULL)
+            continue;
+        for(t=strtok_r(load.requires[i], " \t", &pt); t; t=strtok_r(NULL, " \t", &pt)){
+            const sb_index_entry_s *dep;
+            if(!strcmp(t, "%README%")){
+                flags[i]|=DEPS_README;
+                continue;
+            }
+            if((dep=sb_index_lookup(idx, t))==NULL)
+                continue;
+            if(nedges==alloc){
+                alloc=alloc ? alloc*2 : 4096;
+                edges=realloc(edges, alloc*sizeof(uint32_t));
+            }
+            edges[nedges++]=dep-idx->entries;
+        }
+        free(load.requires[i]);
+    }
+    offsets[count]=nedges;
+    free(load.requires);
+
+    //Invert the edges, the packages requiring a node coming in index order
+    uint32_t *roffsets=calloc(count+1, sizeof(uint32_t));
+    uint32_t *redges=malloc((nedges ? nedges : 1)*sizeof(uint32_t));
+    for(size_t k=0; k<nedges; k++)
+        roffsets[edges[k]+1]++;
+    for(uint32_t i=0; i<count; i++)
+        roffsets[i+1]+=roffsets[i];
+    uint32_t *fill=malloc((count ? count : 1)*sizeof(uint32_t));
+    memcpy(fill, roffsets, count*sizeof(uint32_t));
+    for(uint32_t i=0; i<count; i++)
+        for(uint32_t k=offsets[i]; k<offsets[i+1]; k++)
+            redges[fill[edges[k]]++]=i;
+    free(fill);
+
+    deps_header_s hdr={};
+    memcpy(hdr.magic, DEPS_MAGIC, sizeof(hdr.magic));
+    hdr.stamp=idx->hdr->stamp;
+    hdr.count=count;
+    hdr.nedges=nedges;
+    *size=sizeof(hdr)+2*(count+1+nedges)*sizeof(uint32_t)+count;
+    char *image=malloc(*size);
+    char *p=image;
+    memcpy(p, &hdr, sizeof(hdr));
+    p+=sizeof(hdr);
+    memcpy(p, offsets, (count+1)*sizeof(uint32_t));
+    p+=(count+1)*sizeof(uint32_t);
+    if(nedges)
+        memcpy(p, edges, nedges*sizeof(uint32_t));
+    p+=nedges*sizeof(uint32_t);
+    memcpy(p, roffsets, (count+1)*sizeof(uint32_t));
+    p+=(count+1)*sizeof(uint32_t);
+    if(nedges)
+        memcpy(p, redges, nedges*sizeof(uint32_t));
+    p+=nedges*sizeof(uint32_t);
+    memcpy(p, flags, count);
+    free(offsets);
+    free(edges);
+    free(roffsets);
+    free(redges);
+    free(flags);
+    return image;
+}
+
+/** Point the graph members to their place in the image and check the image
+ * was built from the current index.
+ * \return 0 if the image can be used, -1 otherwise.
+ */
+static int attach_image(deps_graph_s *g, sb_index_s *idx)
+{
+    const deps_header_s *hdr=g->data;
+    if(g->size<sizeof(*hdr) || memcmp(hdr->magic, DEPS_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    if(hdr->stamp!=idx->hdr->stamp || hdr->count!=idx->hdr->count)
+        return -1;
+    if(g->size!=sizeof(*hdr)+2*((size_t)hdr->count+1+hdr->nedges)*sizeof(uint32_t)+hdr->count)
+        return -1;
+    g->hdr=hdr;
+    g->offsets=(const uint32_t *)(hdr+1);
+    g->edges=g->offsets+hdr->count+1;
+    g->roffsets=g->edges+hdr->nedges;
+    g->redges=g->roffsets+hdr->count+1;
+    g->flags=(const uint8_t *)(g->redges+hdr->nedges);
+    return 0;
+}
+
+/** Return the dependency graph, loading or rebuilding it on first use.
+ */
+deps_graph_s *deps_get(void)
+{
+    sb_index_s *idx=sb_index_get();
+    uint64_t t;
+    if(deps)
+        return deps;
+    t=STATS_BEGIN();
+    deps=calloc(1, sizeof(*deps));
+    if((deps->data=map_file(CACHE_PATH(DEPS_CACHE), &deps->size))){
+        deps->mapped=1;
+        if(attach_image(deps, idx)==0){
+            STATS_END(STATS_INDEX, t);
+            return deps;
+        }
+        munmap(deps->data, deps->size);
+        deps->mapped=0;
+    }
+    deps->data=build_image(idx, &deps->size, NULL, NULL);
+    write_file_atomic(CACHE_PATH(DEPS_CACHE), deps->data, deps->size); //Best effort, may not be root
+    attach_image(deps, idx);
+    STATS_END(STATS_INDEX, t);
+    return deps;
+}
+
+/** Unmap or free the dependency graph.
+ */
+void deps_release(void)
+{
+    if(deps==NULL)
+        return;
+    if(deps->mapped)
+        munmap(deps->data, deps->size);
+    else
+        free(deps->data);
+    free(deps);
+    deps=NULL;
+}
+
+/** Return the REQUIRES of every package as recorded in the current graph,
+ * to be given to deps_update() after the repositories are synchronized.
+ * \return a table of package directories, prefixed with their repository like
+ * "SBo/academic/foo", to REQUIRES values, or NULL if there is
+ * no up to date graph in the cache, in which case nothing can be reused.
+ */
+GHashTable *deps_snapshot(void)
+{
+    sb_index_s *idx=sb_index_get();
+    deps_graph_s g={};
+    GHashTable *requires;
+    if((g.data=map_file(CACHE_PATH(DEPS_CACHE), &g.size))==NULL)
+        return NULL;
+    g.mapped=1;
+    if(attach_image(&g, idx)<0){
+        munmap(g.data, g.size);
+        return NULL;
+    }
+    requires=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    for(uint32_t i=0; i<g.hdr->count; i++){
+        GString *value=g_string_new(g.flags[i]&DEPS_README ? "%README% " : "");
+        for(uint32_t k=g.offsets[i]; k<g.offsets[i+1]; k++){
+            g_string_append(value, sb_index_str(idx, idx->entries[g.edges[k]].name));
+            g_string_append_c(value, ' ');
+        }
+        if(strlen(sb_index_str(idx, idx->entries[i].location))<2)
+            g_string_free(value, TRUE);
+        else
+            g_hash_table_insert(requires, package_dir(idx, &idx->entries[i]), g_string_free(value, FALSE));
+    }
+    munmap(g.data, g.size);
+    return requires;
+}
+
+/** Rebuild the graph after a sync, reading again only the .info files of
+ * the package directories in changed and of the packages unknown to previous.
+ * The index is reopened first, as SLACKBUILDS.TXT has likely changed.
+ * previous only holds the REQUIRES found in the repository, which is all
+ * there is as long as packages only require packages of the repository.
+ * \param previous the result of deps_snapshot() taken before the sync, or NULL
+ * \param changed the set of package directories, like "SBo/academic/foo"
+ * \return 0 if the graph is saved in the cache, -1 otherwise.
+ */
+int deps_update(GHashTable *previous, GHashTable *changed)
+{
+    sb_index_s *idx;
+    int ret;
+    deps_release();
+    sb_index_release();
+    idx=sb_index_get();
+    deps=calloc(1, sizeof(*deps));
+    deps->data=build_image(idx, &deps->size, previous, changed);
+    ret=write_file_atomic(CACHE_PATH(DEPS_CACHE), deps->data, deps->size);
+    attach_image(deps, idx);
+    return ret;
+}
+
+/** Print the cycle that goes through node, found on the DFS stack.
+ */
+static void print_cycle(const uint32_t *stack, int depth, uint32_t node)
+{
+    sb_index_s *idx=sb_index_get();
+    int i=depth-1;
+    while(i>0 && stack[i]!=node)
+        i--;
+    fprintf(stderr, "Dependency cycle:");
+    for(; i<depth; i++)
+        fprintf(stderr, " %s ->", sb_index_str(idx, idx->entries[stack[i]].name));
+    fprintf(stderr, " %s\n", sb_index_str(idx, idx->entries[node].name));
+}
+
+/** Compute the transitive dependencies of roots in build order, each package
+ * coming after everything it requires.
+ * \param g the graph
+ * \param roots the nodes to build
+ * \param nroots the number of roots
+ * \param skip_installed if set, installed packages are left out of the order
+ * \param order receive the malloc'ed list of nodes
+ * \return the number of nodes in order, or -1 if there is a dependency cycle.
+ */
+int deps_order(deps_graph_s *g, const uint32_t *roots, int nroots, int skip_installed, uint32_t **order)
+{
+    enum {WHITE=0, GREY, BLACK};
+    sb_index_s *idx=sb_index_get();
+    uint32_t count=g->hdr->count;
+    uint8_t *color=calloc(count, 1);
+    uint32_t *stack=malloc(count*sizeof(uint32_t));
+    uint32_t *next=malloc(count*sizeof(uint32_t)); //Next edge to follow for the node on the stack
+    int norder=0;
+    *order=malloc(count*sizeof(uint32_t));
+    for(int r=0; r<nroots; r++){
+        int depth=0;
+        if(color[roots[r]]!=WHITE)
+            continue;
+        stack[depth]=roots[r];
+        next[depth++]=g->offsets[roots[r]];
+        color[roots[r]]=GREY;
+        while(depth>0){
+            uint32_t node=stack[depth-1];
+            if(next[depth-1]<g->offsets[node+1]){
+                uint32_t dep=g->edges[next[depth-1]++];
+                if(color[dep]==GREY){
+                    print_cycle(stack, depth, dep);
+                    norder=-1;
+                    goto done;
+                }
+                if(color[dep]==WHITE){
+                    color[dep]=GREY;
+                    stack[depth]=dep;
+                    next[depth++]=g->offsets[dep];
+                }
+                continue;
+            }
+            color[node]=BLACK;
+            depth--;
+            if(!skip_installed || !installed_lookup(sb_index_str(idx, idx->entries[node].name)))
+                (*order)[norder++]=node;
+        }
+    }
+done:
+    free(color);
+    free(stack);
+    free(next);
+    if(norder<0){
+        free(*order);
+        *order=NULL;
+    }
+    return norder;
+}
+
+/** Find the packages requiring roots, directly or through other packages,
+ * and give them in build order, each package coming after the packages of
+ * the result it requires.  The packages of a dependency cycle come last.
+ * \param g the graph
+ * \param roots the nodes whose dependents are wanted, left out of the result
+ * \param nroots the number of roots
+ * \param flags DEPS_DIRECT to stop at the packages requiring a root
+ *        themselves, DEPS_INSTALLED to leave out the packages not installed
+ * \param out receive the malloc'ed list of nodes
+ * \return the number of nodes in out.
+ */
+int deps_dependents(deps_graph_s *g, const uint32_t *roots, int nroots, int flags, uint32_t **out)
+{
+    enum {NONE=0, ROOT, DEPENDENT, DONE};
+    sb_index_s *idx=sb_index_get();
+    uint32_t count=g->hdr->count;
+    uint8_t *mark=calloc(count ? count : 1, 1);
+    uint32_t *queue=malloc((count ? count : 1)*sizeof(uint32_t));
+    uint32_t *pending=calloc(count ? count : 1, sizeof(uint32_t));
+    uint32_t head=0, tail=0;
+    int n=0;
+    *out=malloc((count ? count : 1)*sizeof(uint32_t));
+    for(int r=0; r<nroots; r++)
+        if(mark[roots[r]]==NONE){
+            mark[roots[r]]=ROOT;
+            queue[tail++]=roots[r];
+        }
+    while(head<tail){
+        uint32_t node=queue[head++];
+        for(uint32_t k=g->roffsets[node]; k<g->roffsets[node+1]; k++){
+            uint32_t dep=g->redges[k];
+            if(mark[dep]!=NONE)
+                continue;
+            mark[dep]=DEPENDENT;
+            if(!(flags&DEPS_DIRECT))
+                queue[tail++]=dep;
+        }
+    }
+
+    //Kahn's algorithm over the dependents, a node being ready once the
+    //dependents it requires are all placed
+    head=tail=0;
+    for(uint32_t i=0; i<count; i++){
+        if(mark[i]!=DEPENDENT)
+            continue;
+        for(uint32_t k=g->offsets[i]; k<g->offsets[i+1]; k++)
+            if(mark[g->edges[k]]==DEPENDENT)
+                pending[i]++;
+        if(pending[i]==0)
+            queue[tail++]=i;
+    }
+    for(;;){
+        while(head<tail){
+            uint32_t node=queue[head++];
+            mark[node]=DONE;
+            if(!(flags&DEPS_INSTALLED) || installed_lookup(sb_index_str(idx, idx->entries[node].name)))
+                (*out)[n++]=node;
+            for(uint32_t k=g->roffsets[node]; k<g->roffsets[node+1]; k++){
+                uint32_t dep=g->redges[k];
+                if(mark[dep]==DEPENDENT && --pending[dep]==0)
+                    queue[tail++]=dep;
+            }
+        }
+        //Left with cycles only, break one at its first node
+        uint32_t i=0;
+        while(i<count && (mark[i]!=DEPENDENT || pending[i]==0))
+            i++;
+        if(i==count)
+            break;
+        pending[i]=0;
+        queue[tail++]=i;
+    }
+    free(mark);
+    free(queue);
+    free(pending);
+    return n;
+}
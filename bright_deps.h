@@ -0,0 +1,56 @@
+/** \file
+ * Dependency graph of the Slackbuilds repository.
+ *
+ * Nodes are the entries of the SLACKBUILDS.TXT index, in index order, and
+ * edges go from a package to the packages listed in the REQUIRES of its
+ * .info file.  The same edges are also kept inverted, from a package to the
+ * packages requiring it, so the dependents of a library are found without
+ * going through every package.  The graph is stored in \c BS_CACHEDIR with
+ * the same layout in memory and on disk, and is rebuilt when SLACKBUILDS.TXT
+ * changes.
+ */
+#ifndef BRIGHT_DEPS_H
+#define BRIGHT_DEPS_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define DEPS_CACHE "deps.cache"     //!< The cache file of the dependency graph.
+#define DEPS_MAGIC "BSDEP03"        //!< Change it whenever the layout below changes.
+#define DEPS_README 0x01            //!< Flag of a package whose REQUIRES has %README%.
+#define DEPS_DIRECT 0x01            //!< deps_dependents(): only the packages requiring a root themselves.
+#define DEPS_INSTALLED 0x02         //!< deps_dependents(): only the installed packages.
+
+/**Header of the graph image, followed by offsets[count+1], edges[nedges],
+ * roffsets[count+1], redges[nedges] and flags[count].
+ */
+typedef struct {
+    char magic[8];
+    uint64_t stamp;          //!< Stamp of the SLACKBUILDS.TXT index it was built from.
+    uint32_t count;          //!< Number of nodes, the number of index entries.
+    uint32_t nedges;         //!< Number of edges.
+} deps_header_s;
+
+/**The dependency graph.  The dependencies of node i are
+ * edges[offsets[i]] to edges[offsets[i+1]-1], the packages requiring it
+ * redges[roffsets[i]] to redges[roffsets[i+1]-1].
+ */
+typedef struct {
+    void *data;
+    size_t size;
+    int mapped;
+    const deps_header_s *hdr;
+    const uint32_t *offsets;
+    const uint32_t *edges;
+    const uint32_t *roffsets;
+    const uint32_t *redges;
+    const uint8_t *flags;
+} deps_graph_s;
+
+deps_graph_s *deps_get(void);
+void deps_release(void);
+GHashTable *deps_snapshot(void);
+int deps_update(GHashTable *previous, GHashTable *changed);
+char *read_info_requires(const char *path);
+int deps_order(deps_graph_s *g, const uint32_t *roots, int nroots, int skip_installed, uint32_t **order);
+int deps_dependents(deps_graph_s *g, const uint32_t *roots, int nroots, int flags, uint32_t **out);
+#endif /* BRIGHT_DEPS_H */
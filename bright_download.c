@@ -0,0 +1,363 @@
+/** \file
+ * Run the downloads of a package concurrently.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_download.h"
+#include <time.h>
+
+static CURLSH *share=NULL;
+static CURLM *multi=NULL;
+static long max_jobs=DL_JOBS;
+static long max_host=DL_HOST_CONNECTIONS;
+
+/** Initialize libcurl, the share handle and the multi handle once for the
+ * whole process.  The connections are kept by the multi handle, and reused
+ * from one download_all() to the next: a connection cache in the share
+ * handle would escape the limits of --host-connections and --jobs.
+ * \param jobs the number of parallel transfers, 0 for the default
+ * \param host_connections the number of connections per host, 0 for the default
+ * \return 0 on success, -1 if libcurl cannot be initialized.
+ */
+int download_init(long jobs, long host_connections)
+{
+    if(jobs>0)
+        max_jobs=jobs;
+    if(host_connections>0)
+        max_host=host_connections;
+    if(share)
+        return 0;
+    if(curl_global_init(CURL_GLOBAL_DEFAULT)!=CURLE_OK)
+        return -1;
+    if((multi=curl_multi_init())==NULL){
+        curl_global_cleanup();
+        return -1;
+    }
+    share=curl_share_init();
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return 0;
+}
+
+/** Release the multi handle, the share handle and libcurl.
+ */
+void download_cleanup(void)
+{
+    if(share==NULL)
+        return;
+    curl_multi_cleanup(multi);
+    multi=NULL;
+    curl_share_cleanup(share);
+    share=NULL;
+    curl_global_cleanup();//To make valgrind happier
+}
+
+static int progress_cb(void *clientp, curl_off_t dltotal, curl_off_t dlnow,
+        curl_off_t ultotal, curl_off_t ulnow)
+{
+    download_s *dl=clientp;
+    dl->now=dl->offset+dlnow;
+    dl->total=dltotal>0 ? dl->offset+dltotal : 0;
+    return 0;
+}
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000LL+ts.tv_nsec/1000000;
+}
+
+/** Write a chunk of received data to the part file and feed it to the digests.
+ * \return the number of bytes handled, anything else aborts the transfer.
+ */
+static size_t write_cb(char *data, size_t size, size_t nmemb, void *userp)
+{
+    download_s *dl=userp;
+    size_t n=size*nmemb;
+    uint64_t t;
+    if(fwrite(data, 1, n, dl->fp)!=n)
+        return 0;
+    STATS_COUNT(STATS_DOWNLOADED, n);
+    t=STATS_BEGIN();
+    MD5_Update(&dl->md5_ctx, data, n);
+    SHA256_Update(&dl->sha256_ctx, data, n);
+    STATS_END(STATS_HASH, t);
+    return n;
+}
+
+/** Return the content the state file of dl must have, to be freed by the caller.
+ */
+static char *state_content(download_s *dl)
+{
+    return g_strdup_printf("%s\n%s\n%s\n", dl->url, dl->md5 ? dl->md5 : "", dl->sha256 ? dl->sha256 : "");
+}
+
+/** Decide where the transfer of dl starts.  When the part file can be resumed
+ * its content is fed to the digests, otherwise it is emptied and a new state
+ * file is written.
+ * \return the number of bytes already downloaded.
+ */
+static curl_off_t resume_offset(download_s *dl)
+{
+    char *expected=state_content(dl);
+    char *found=NULL;
+    size_t len;
+    curl_off_t offset=0;
+    FILE *fp;
+    if(g_file_get_contents(dl->state, &found, &len, NULL) && !strcmp(found, expected)
+            && (fp=fopen(dl->part, "r"))){
+        unsigned char data[65536];
+        size_t n;
+        uint64_t t=STATS_BEGIN();
+        STATS_COUNT(STATS_FOPEN, 1);
+        while((n=fread(data, 1, sizeof(data), fp))>0){
+            MD5_Update(&dl->md5_ctx, data, n);
+            SHA256_Update(&dl->sha256_ctx, data, n);
+            offset+=n;
+        }
+        file_close(fp, dl->part);
+        STATS_END(STATS_HASH, t);
+    }
+    else{
+        unlink(dl->part);
+        write_file_atomic(dl->state, expected, strlen(expected));
+    }
+    g_free(found);
+    g_free(expected);
+    return offset;
+}
+
+/** Tell if a failed transfer is worth trying again.
+ */
+static int is_retryable(CURLcode result, long http_code)
+{
+    switch(result){
+        case CURLE_COULDNT_RESOLVE_HOST:
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_OPERATION_TIMEDOUT:
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_SSL_CONNECT_ERROR:
+            return 1;
+        case CURLE_HTTP_RETURNED_ERROR:
+            return http_code>=500 || http_code==408 || http_code==429;
+        default:
+            return 0;
+    }
+}
+
+/** Put dl back in the queue after an exponential backoff delay.
+ * \return 0 if it will be retried, -1 if it has no retry left.
+ */
+static int schedule_retry(download_s *dl, long long delay)
+{
+    if(dl->retries>=DL_RETRIES)
+        return -1;
+    if(delay<0){
+        delay=DL_BACKOFF_MS;
+        for(int i=0; i<dl->retries && delay<DL_BACKOFF_MAX_MS; i++)
+            delay*=2;
+        if(delay>DL_BACKOFF_MAX_MS)
+            delay=DL_BACKOFF_MAX_MS;
+    }
+    dl->retries++;
+    dl->retry_at=now_ms()+delay;
+    dl->status=DL_PENDING;
+    printf("Retrying %s in %lld ms (%d/%d)\n", dl->url, delay, dl->retries, DL_RETRIES);
+    return 0;
+}
+
+/** Close the part file of a finished transfer and check its digests.
+ * The part file becomes saveto if everything is fine.  It is kept, with its
+ * state file, when the transfer failed for a reason worth retrying, so a
+ * later attempt resumes it, and removed with its state file when its content
+ * is wrong or the failure is final, e.g. a HTTP 404.  Nothing truncated or
+ * corrupted is ever left under the final name, nor resumed later.
+ * \param dl the transfer
+ * \param result the outcome of the transfer
+ * \param http_code the last HTTP response code, 0 for other protocols
+ */
+static void finish_transfer(download_s *dl, CURLcode result, long http_code)
+{
+    unsigned char md5[MD5_DIGEST_LENGTH];
+    unsigned char sha256[SHA256_DIGEST_LENGTH];
+    MD5_Final(md5, &dl->md5_ctx);
+    SHA256_Final(sha256, &dl->sha256_ctx);
+    to_hex(dl->md5_got, md5, MD5_DIGEST_LENGTH);
+    to_hex(dl->sha256_got, sha256, SHA256_DIGEST_LENGTH);
+    dl->status=result;
+    if(fclose(dl->fp)!=0 && result==CURLE_OK)
+        dl->status=CURLE_WRITE_ERROR;
+    dl->fp=NULL;
+    if(dl->status==CURLE_OK){
+        if((dl->md5 && md5_compare(dl->md5_got, dl->md5)!=0)
+                || (dl->sha256 && strcasecmp(dl->sha256_got, dl->sha256))){
+            unlink(dl->part);
+            //A resumed file may be wrong because of its old part only, start over once.
+            if(dl->offset==0 || schedule_retry(dl, 0)<0){
+                dl->status=DL_CHECKSUM_FAILED;
+                unlink(dl->state);
+            }
+        }
+        else if(rename(dl->part, dl->saveto)<0)
+            dl->status=CURLE_WRITE_ERROR;
+        else
+            unlink(dl->state);
+    }
+    else if(dl->offset>0 && (result==CURLE_RANGE_ERROR || http_code==416)){
+        //The server does not resume or the part file is not a prefix of the file.
+        unlink(dl->part);
+        if(schedule_retry(dl, 0)<0){
+            dl->status=result;
+            unlink(dl->state);
+        }
+    }
+    else if(is_retryable(result, http_code))
+        schedule_retry(dl, -1); //Out of retries, the part file is left for the next run
+    else{
+        unlink(dl->part);
+        unlink(dl->state);
+    }
+    g_free(dl->part);
+    g_free(dl->state);
+    dl->part=NULL;
+    dl->state=NULL;
+}
+
+/** Open the target of dl and add its transfer to multi.
+ * \return 0 if the transfer is started, -1 otherwise.
+ */
+static int start_transfer(CURLM *multi, download_s *dl)
+{
+    dl->part=g_strconcat(dl->saveto, DL_PART, NULL);
+    dl->state=g_strconcat(dl->part, DL_STATE, NULL);
+    MD5_Init(&dl->md5_ctx);
+    SHA256_Init(&dl->sha256_ctx);
+    dl->offset=resume_offset(dl);
+    if((dl->fp=fopen(dl->part, dl->offset>0 ? "a" : "w"))==NULL){
+        printf("Cannot open file %s for mode %s\n", dl->part, dl->offset>0 ? "a" : "w");
+        dl->status=CURLE_WRITE_ERROR;
+        g_free(dl->part);
+        g_free(dl->state);
+        dl->part=NULL;
+        dl->state=NULL;
+        return -1;
+    }
+    dl->now=dl->offset;
+    dl->easy=curl_easy_init();
+    curl_easy_setopt(dl->easy, CURLOPT_URL, dl->url);
+    curl_easy_setopt(dl->easy, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(dl->easy, CURLOPT_WRITEDATA, dl);
+    curl_easy_setopt(dl->easy, CURLOPT_FOLLOWLOCATION, 1L);//For sites like downloads.sourceforge
+    curl_easy_setopt(dl->easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(dl->easy, CURLOPT_RESUME_FROM_LARGE, dl->offset);
+    curl_easy_setopt(dl->easy, CURLOPT_LOW_SPEED_LIMIT, 1L);//Give up on a stalled connection
+    curl_easy_setopt(dl->easy, CURLOPT_LOW_SPEED_TIME, 60L);
+    curl_easy_setopt(dl->easy, CURLOPT_SHARE, share);
+    curl_easy_setopt(dl->easy, CURLOPT_PRIVATE, dl);
+    curl_easy_setopt(dl->easy, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(dl->easy, CURLOPT_XFERINFOFUNCTION, progress_cb);
+    curl_easy_setopt(dl->easy, CURLOPT_XFERINFODATA, dl);
+    if(dl->offset>0)
+        printf("Resuming...%s at byte %lld\n", dl->url, (long long)dl->offset);
+    else
+        printf("Downloading...%s\n", dl->url);
+    curl_multi_add_handle(multi, dl->easy);
+    return 0;
+}
+
+/** Print one line summing up the progress of all transfers, on a terminal only.
+ */
+static void show_progress(download_s *dl, int count, int done)
+{
+    curl_off_t now=0;
+    curl_off_t total=0;
+    if(!isatty(STDOUT_FILENO))
+        return;
+    for(int i=0; i<count; i++){
+        now+=dl[i].now;
+        total+=dl[i].total;
+    }
+    printf("\r%d/%d files  %.1f/%.1f MiB ", done, count, now/1048576.0, total/1048576.0);
+    fflush(stdout);
+}
+
+/** Download every entry of dl, at most \c jobs at a time.  Failed transfers
+ * are retried up to \c DL_RETRIES times with an exponential backoff.
+ * The status of each entry is set to 0 on success, to \c DL_CHECKSUM_FAILED if
+ * the data does not match the expected digests or to the CURLcode of the failure.
+ * \param dl the files to download
+ * \param count the number of entries in dl
+ * \return the number of failed downloads.
+ */
+int download_all(download_s *dl, int count)
+{
+    CURLMsg *msg;
+    int active=0;
+    int done=0;
+    int failed=0;
+    int still;
+    int left;
+    uint64_t t=STATS_BEGIN();
+    if(download_init(0, 0)<0)
+        return count;
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host);
+    curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, max_jobs);
+    for(int i=0; i<count; i++){
+        dl[i].status=DL_PENDING;
+        dl[i].retries=0;
+        dl[i].retry_at=0;
+    }
+    while(done<count){
+        long long now=now_ms();
+        long long wait=500;
+        for(int i=0; i<count && active<max_jobs; i++){
+            if(dl[i].status!=DL_PENDING || dl[i].easy)
+                continue;
+            if(dl[i].retry_at>now){
+                if(dl[i].retry_at-now<wait)
+                    wait=dl[i].retry_at-now;
+                continue;
+            }
+            if(start_transfer(multi, &dl[i])==0)
+                active++;
+            else{
+                done++;
+                failed++;
+            }
+        }
+        curl_multi_perform(multi, &still);
+        while((msg=curl_multi_info_read(multi, &left))){
+            download_s *d;
+            long http_code=0;
+            CURLcode result;
+            if(msg->msg!=CURLMSG_DONE)
+                continue;
+            result=msg->data.result; //msg does not survive the removal of its handle
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&d);
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_multi_remove_handle(multi, d->easy);
+            curl_easy_cleanup(d->easy);
+            d->easy=NULL;
+            finish_transfer(d, result, http_code);
+            active--;
+            if(d->status==DL_PENDING)
+                continue;
+            if(d->status!=CURLE_OK)
+                failed++;
+            done++;
+        }
+        show_progress(dl, count, done);
+        if(done<count && active>0)
+            curl_multi_wait(multi, NULL, 0, wait, NULL);
+        else if(done<count)
+            usleep(wait*1000);
+    }
+    if(isatty(STDOUT_FILENO))
+        putchar('\n');
+    STATS_END(STATS_DOWNLOAD, t);
+    return failed;
+}
@@ -0,0 +1,55 @@
+/** \file
+ * Parallel downloads on top of the libcurl multi interface.
+ *
+ * All transfers of the process share one share handle, so DNS answers,
+ * TLS sessions and open connections are reused from one file to the next.
+ */
+#ifndef BRIGHT_DOWNLOAD_H
+#define BRIGHT_DOWNLOAD_H
+#include <curl/curl.h>
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+
+#define DL_JOBS 4             //!< Default number of transfers running at the same time.
+#define DL_HOST_CONNECTIONS 2 //!< Default number of connections to a same host.
+#define DL_PART ".part"       //!< Suffix of a file being downloaded.
+#define DL_STATE ".state"     //!< Suffix of the sidecar file describing a part file.
+#define DL_PENDING -1         //!< Status of a download not done yet.
+#define DL_CHECKSUM_FAILED -2 //!< Status of a download whose checksum does not match.
+#define DL_RETRIES 5          //!< Number of times a failed transfer is tried again.
+#define DL_BACKOFF_MS 1000    //!< Delay before the first retry, doubled on each retry.
+#define DL_BACKOFF_MAX_MS 60000 //!< Longest delay between two retries.
+
+/**One file to download.  The checksums are computed while the data is
+ * received.  The data is written to saveto with the \c DL_PART suffix and
+ * only renamed to saveto once the checksums are verified.
+ *
+ * A part file left by an interrupted transfer is resumed with a HTTP Range
+ * or FTP REST request when its sidecar state file shows it was downloaded
+ * from the same url for the same checksums.
+ */
+typedef struct {
+    const char *url;     //!< The url to download.
+    char *saveto;        //!< The full path to locally save the url downloaded.
+    const char *md5;     //!< The expected md5sum, NULL to skip the check.
+    const char *sha256;  //!< The expected sha256sum, NULL to skip the check.
+    int status;          //!< 0 once downloaded, DL_PENDING before, a CURLcode or DL_CHECKSUM_FAILED on failure.
+    char md5_got[33];    //!< The md5sum of the data received.
+    char sha256_got[65]; //!< The sha256sum of the data received.
+    MD5_CTX md5_ctx;
+    SHA256_CTX sha256_ctx;
+    char *part;          //!< saveto with the DL_PART suffix.
+    char *state;         //!< part with the DL_STATE suffix.
+    curl_off_t offset;   //!< Bytes already in the part file when the transfer started.
+    int retries;         //!< Retries done so far.
+    long long retry_at;  //!< Monotonic time in ms before which the transfer is not retried.
+    FILE *fp;
+    CURL *easy;
+    curl_off_t now;      //!< Bytes received so far.
+    curl_off_t total;    //!< Expected size, 0 if unknown.
+} download_s;
+
+int download_init(long jobs, long host_connections);
+void download_cleanup(void);
+int download_all(download_s *dl, int count);
+#endif /* BRIGHT_DOWNLOAD_H */
@@ -0,0 +1,253 @@
+/** \file
+ * Stream the catalog and the installed packages as NDJSON.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_catalog.h"
+#include "bright_export.h"
+
+/** Output buffered in large blocks, written with a single fwrite each time
+ * it fills up.
+ */
+typedef struct {
+    FILE *out;
+    char *buf;
+    size_t len;
+} writer_s;
+
+static void w_flush(writer_s *w)
+{
+    if(w->len)
+        fwrite(w->buf, 1, w->len, w->out);
+    w->len=0;
+}
+
+static void w_write(writer_s *w, const char *s, size_t len)
+{
+    if(w->len+len>EXPORT_BUFSIZE){
+        w_flush(w);
+        if(len>EXPORT_BUFSIZE){
+            fwrite(s, 1, len, w->out);
+            return;
+        }
+    }
+    memcpy(w->buf+w->len, s, len);
+    w->len+=len;
+}
+
+#define w_lit(w, s) w_write(w, s, sizeof(s)-1) //!< Write a string literal.
+
+/** Write s as a JSON string.  Runs of characters needing no escape are
+ * copied at once.  A byte that does not start a valid UTF-8 sequence, from a
+ * Latin-1 slack-desc or README most likely, is written as the code point of
+ * the same value, so that the output stays valid UTF-8.
+ */
+static void w_string(writer_s *w, const char *s)
+{
+    const char *run=s;
+    w_lit(w, "\"");
+    for(; *s; s++){
+        unsigned char c=*s;
+        char esc[8];
+        if(c>=0x80){
+            int len=c>=0xf0 ? 4 : c>=0xe0 ? 3 : 2;
+            if(g_utf8_validate(s, len, NULL)){
+                s+=len-1;
+                continue;
+            }
+        }
+        else if(c!='"' && c!='\\' && c>=0x20)
+            continue;
+        w_write(w, run, s-run);
+        if(c=='"' || c=='\\'){
+            esc[0]='\\';
+            esc[1]=c;
+            w_write(w, esc, 2);
+        }
+        else
+            w_write(w, esc, snprintf(esc, sizeof(esc), "\\u%04x", c));
+        run=s+1;
+    }
+    w_write(w, run, s-run);
+    w_lit(w, "\"");
+}
+
+/** Write ,"key":"value".
+ */
+static void w_field(writer_s *w, const char *key, const char *value)
+{
+    w_lit(w, ",");
+    w_string(w, key);
+    w_lit(w, ":");
+    w_string(w, value);
+}
+
+/** Write ,"key":["item",...].
+ */
+static void w_span(writer_s *w, const char *key, span_s span)
+{
+    w_lit(w, ",");
+    w_string(w, key);
+    w_lit(w, ":[");
+    for(int i=0; i<span.count; i++){
+        if(i)
+            w_lit(w, ",");
+        w_string(w, span.items[i]);
+    }
+    w_lit(w, "]");
+}
+
+/** Write the "slackbuild" member for pkg, whose .info file has been read
+ * if it exists.
+ */
+static void w_slackbuild(writer_s *w, const package_s *pkg)
+{
+    w_lit(w, ",\"slackbuild\":{\"repository\":");
+    w_string(w, pkg->repo->name);
+    w_field(w, "version", pkg->version);
+    w_field(w, "location", pkg->location);
+    w_span(w, "files", arena_split(pkg->arena, pkg->files, " "));
+    w_field(w, "shortdescr", pkg->shortdescr);
+    w_span(w, "download", pkg->download);
+    w_span(w, "md5sum", pkg->md5sum);
+    w_span(w, "download_x86_64", pkg->download_64);
+    w_span(w, "md5sum_x86_64", pkg->md5sum_64);
+    w_field(w, "homepage", pkg->homepage);
+    w_span(w, "requires", arena_split(pkg->arena, pkg->requires, " "));
+    w_field(w, "maintainer", pkg->maintainer);
+    w_field(w, "email", pkg->email);
+    w_span(w, "sha256sum", pkg->sha256sum);
+    w_span(w, "sha256sum_x86_64", pkg->sha256sum_64);
+    w_lit(w, "}");
+}
+
+static void w_installed(writer_s *w, const installed_s *inst)
+{
+    w_lit(w, ",\"installed\":{\"fullname\":");
+    w_string(w, inst->fullname);
+    w_field(w, "version", inst->version);
+    w_field(w, "arch", inst->arch);
+    w_field(w, "build", inst->build);
+    w_field(w, "tag", inst->tag);
+    w_lit(w, "}");
+}
+
+static void w_slackware(writer_s *w, const slackware_s *spkg)
+{
+    w_lit(w, ",\"slackware\":{\"repo\":");
+    w_string(w, spkg->repo);
+    w_field(w, "version", spkg->version);
+    w_field(w, "patch", spkg->patch);
+    w_field(w, "arch", spkg->arch);
+    w_field(w, "release", spkg->release);
+    w_field(w, "fullname", spkg->fullname);
+    w_field(w, "location", spkg->location);
+    w_field(w, "extension", spkg->extension);
+    w_field(w, "size_compressed", spkg->sizec);
+    w_field(w, "size_uncompressed", spkg->sizeu);
+    w_span(w, "description", spkg->descr);
+    w_lit(w, "}");
+}
+
+/** Describe the count packages of names in arena a and write them, one line each.
+ */
+static void export_chunk(writer_s *w, arena_s *a, char *names[], int count)
+{
+    slackware_s *spkg[EXPORT_CHUNK];
+    uint64_t t;
+    int slackbuilds=sb_index_try_get()!=NULL;
+    if(slack_index_try_get())
+        describe_slack_batch(a, names, count, spkg);
+    else
+        memset(spkg, 0, sizeof(spkg));
+    for(int i=0; i<count; i++){
+        package_s *pkg=slackbuilds ? describe_package(a, names[i]) : NULL;
+        const installed_s *inst=installed_lookup(names[i]);
+        if(pkg){
+            char *info=g_strconcat(pkg->repo->dir, pkg->location+2, "/", pkg->name, ".info", NULL);
+            if(access(info, R_OK)==0) //A missing .info only leaves its fields out, without a warning
+                get_package_info(pkg);
+            g_free(info);
+        }
+        t=STATS_BEGIN();
+        w_lit(w, "{\"name\":");
+        w_string(w, pkg ? pkg->name : names[i]);
+        if(pkg)
+            w_slackbuild(w, pkg);
+        else
+            w_lit(w, ",\"slackbuild\":null");
+        if(inst)
+            w_installed(w, inst);
+        else
+            w_lit(w, ",\"installed\":null");
+        if(spkg[i])
+            w_slackware(w, spkg[i]);
+        else
+            w_lit(w, ",\"slackware\":null");
+        w_lit(w, "}\n");
+        STATS_END(STATS_OUTPUT, t);
+    }
+}
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+/** Collect the names of every package: the Slackbuilds in index order, then
+ * the Slackware packages without a Slackbuild, then the installed packages
+ * known to neither, sorted.  The names point into the indexes and the
+ * installed table.  A catalog that is missing, no SBo tree or no pkglist,
+ * adds no name.
+ */
+static GPtrArray *all_names(void)
+{
+    sb_index_s *idx=sb_index_try_get();
+    slack_index_s *sidx=slack_index_try_get();
+    GHashTable *table=installed_table();
+    uint32_t sbcount=idx ? idx->hdr->count : 0, slackcount=sidx ? sidx->hdr->count : 0;
+    GPtrArray *names=g_ptr_array_sized_new(sbcount+slackcount);
+    GHashTableIter iter;
+    gpointer key;
+    guint first;
+    for(uint32_t i=0; i<sbcount; i++)
+        g_ptr_array_add(names, (char *)sb_index_str(idx, idx->entries[i].name));
+    for(uint32_t i=0; i<slackcount; i++){
+        const char *name=slack_index_str(sidx, sidx->entries[i].name);
+        if(slack_index_lookup(sidx, name)==&sidx->entries[i] && (idx==NULL || sb_index_lookup(idx, name)==NULL))
+            g_ptr_array_add(names, (char *)name);
+    }
+    first=names->len;
+    g_hash_table_iter_init(&iter, table);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        if((idx==NULL || sb_index_lookup(idx, key)==NULL) && (sidx==NULL || slack_index_lookup(sidx, key)==NULL))
+            g_ptr_array_add(names, key);
+    qsort(names->pdata+first, names->len-first, sizeof(gpointer), compare_names);
+    return names;
+}
+
+/**Write one JSON object per package to out, for the packages of names or,
+ * when count is 0, for every package of the catalog and of \c SB_DB.
+ * \return 0 on success, 1 if out could not be written.
+ */
+int export_ndjson(FILE *out, char *names[], int count)
+{
+    writer_s w={out, malloc(EXPORT_BUFSIZE), 0};
+    GPtrArray *all=NULL;
+    if(count==0){
+        all=all_names();
+        names=(char **)all->pdata;
+        count=all->len;
+    }
+    for(int i=0; i<count; i+=EXPORT_CHUNK){
+        arena_s *a=arena_new();
+        export_chunk(&w, a, names+i, count-i<EXPORT_CHUNK ? count-i : EXPORT_CHUNK);
+        arena_free(a);
+    }
+    w_flush(&w);
+    free(w.buf);
+    if(all)
+        g_ptr_array_free(all, TRUE);
+    return fflush(out)!=0 || ferror(out);
+}
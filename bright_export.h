@@ -0,0 +1,21 @@
+/** \file
+ * Export of the catalog and of the installed packages as NDJSON.
+ *
+ * Each package is written as one JSON object on its own line:
+ * \code
+ * {"name":"foo","slackbuild":{...},"installed":{...},"slackware":{...}}
+ * \endcode
+ * "slackbuild" holds the SLACKBUILDS.TXT and .info fields, "installed" the
+ * entry of \c SB_DB and "slackware" the catalog record, each being null when
+ * the package has none.  The packages are described by chunks of
+ * \c EXPORT_CHUNK sharing one arena, so memory does not grow with the catalog.
+ */
+#ifndef BRIGHT_EXPORT_H
+#define BRIGHT_EXPORT_H
+#include <stdio.h>
+
+#define EXPORT_CHUNK 256          //!< Packages described per arena.
+#define EXPORT_BUFSIZE 1048576    //!< Size of the output buffer.
+
+int export_ndjson(FILE *out, char *names[], int count);
+#endif /* BRIGHT_EXPORT_H */
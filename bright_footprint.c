@@ -0,0 +1,315 @@
+/** \file
+ * Sum the sizes of the installed packages per package, series or repository.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_catalog.h"
+#include "bright_scan.h"
+#include "bright_pool.h"
+#include "bright_footprint.h"
+#include <inttypes.h>
+#include <limits.h>
+
+/**An installed package and what its record and files add up to.
+ */
+typedef struct {
+    const installed_s *inst;
+    char *location;          //!< PACKAGE LOCATION of the record, NULL if it has none.
+    uint64_t sizec;          //!< Compressed size of the package, in bytes.
+    uint64_t sizeu;          //!< Uncompressed size of the package, in bytes.
+    uint64_t apparent;       //!< Sum of the sizes of its files under \c ROOT.
+    uint64_t disk;           //!< Space its files take under \c ROOT.
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t missing;        //!< Files of the list not found under \c ROOT.
+} fp_pkg_s;
+
+/**The totals of a line of the report.
+ */
+typedef struct {
+    char *key;
+    uint32_t packages;
+    uint64_t sizec;
+    uint64_t sizeu;
+    uint64_t apparent;
+    uint64_t disk;
+    uint32_t files;
+    uint32_t dirs;
+    uint32_t missing;
+} fp_total_s;
+
+/**What the workers share.
+ */
+typedef struct {
+    fp_pkg_s *pkgs;
+    const char *root;
+    size_t rootlen;          //!< Without its trailing slashes.
+    int disk;
+} fp_job_s;
+
+/** Convert a size of a record, like "340K", "1.3M" or "340 K", to bytes.
+ */
+static uint64_t parse_size(const char *s, const char *end)
+{
+    char buf[32];
+    char *unit;
+    double v;
+    size_t len=end-s<(ptrdiff_t)sizeof(buf)-1 ? (size_t)(end-s) : sizeof(buf)-1;
+    memcpy(buf, s, len);
+    buf[len]='\0';
+    v=strtod(buf, &unit);
+    while(*unit==' ')
+        unit++;
+    switch(*unit){
+        case 'G': v*=1024;
+        /* fall through */
+        case 'M': v*=1024;
+        /* fall through */
+        case 'K': v*=1024;
+        /* fall through */
+        default: break;
+    }
+    return v>0 ? (uint64_t)v : 0;
+}
+
+/** Read the record of a package: its sizes, its location and its files,
+ * lstat'ed under \c ROOT if disk usage is asked for.
+ */
+static void read_pkg(size_t i, void *arg)
+{
+    fp_job_s *job=arg;
+    fp_pkg_s *pkg=&job->pkgs[i];
+    size_t size;
+    char *record=installed_read_record(pkg->inst->fullname, &size);
+    const char *p;
+    const char *eof;
+    char path[PATH_MAX];
+    scan_line_s l;
+    if(record==NULL)
+        return;
+    eof=record+size;
+    for(p=record; p<eof; ){
+        p=scan_line(p, eof, &l);
+        if(l.key==SCAN_INST_SIZEC)
+            pkg->sizec=parse_size(l.value, l.end);
+        else if(l.key==SCAN_INST_SIZEU)
+            pkg->sizeu=parse_size(l.value, l.end);
+        else if(l.key==SCAN_PKG_LOCATION && pkg->location==NULL)
+            pkg->location=g_strndup(l.value, l.end-l.value);
+        else if(l.end-l.line>=(ptrdiff_t)strlen(INSTALLED_FILE_LIST)
+                && !memcmp(l.line, INSTALLED_FILE_LIST, strlen(INSTALLED_FILE_LIST)))
+            break;
+    }
+    memcpy(path, job->root, job->rootlen);
+    path[job->rootlen]='/';
+    while(p<eof){
+        const char *nl=memchr(p, '\n', eof-p);
+        size_t len;
+        struct stat st;
+        if(nl==NULL)
+            nl=eof;
+        len=nl-p;
+        if(len && p[len-1]=='\r')
+            len--;
+        if(len==0 || (len==2 && !memcmp(p, "./", 2)) || !strncmp(p, "install/", 8)){
+            p=nl+1;
+            continue;
+        }
+        if(p[len-1]=='/'){
+            pkg->dirs++;
+            p=nl+1;
+            continue;
+        }
+        pkg->files++;
+        if(job->disk && job->rootlen+1+len<sizeof(path)){
+            memcpy(path+job->rootlen+1, p, len);
+            path[job->rootlen+1+len]='\0';
+            if(lstat(path, &st)==0){
+                pkg->apparent+=st.st_size;
+                pkg->disk+=(uint64_t)st.st_blocks*512;
+            }
+            else
+                pkg->missing++;
+        }
+        p=nl+1;
+    }
+    free(record);
+}
+
+/** Return the series of a location like ./slackware64/ap, or of the package
+ * file of a record like ./slackware64/ap/bc-1.06.95-x86_64-2.txz, NULL if
+ * there is none.
+ */
+static const char *last_component(const char *location, size_t *len)
+{
+    const char *end=location+strlen(location);
+    const char *s;
+    while(end>location && end[-1]=='/')
+        end--;
+    for(s=end; s>location && s[-1]!='/'; s--)
+        ;
+    if(end-s>4 && end[-4]=='.' && end[-3]=='t' && end[-1]=='z' && s>location){
+        for(end=s-1; end>location && end[-1]=='/'; end--)
+            ;
+        for(s=end; s>location && s[-1]!='/'; s--)
+            ;
+    }
+    if(s==end || (end-s==1 && *s=='.'))
+        return NULL;
+    *len=end-s;
+    return s;
+}
+
+/** Return the repository and series of pkg as "repo/series", or only "repo"
+ * if its series is unknown.  A package built from a Slackbuild belongs to
+ * the repository of the Slackbuild, a native one to its Slackware tree.
+ * idx or sidx is NULL when that catalog is missing, the PACKAGE LOCATION of
+ * the record then telling the series.
+ */
+static char *group_of(const fp_pkg_s *pkg, sb_index_s *idx, slack_index_s *sidx, int by)
+{
+    const installed_s *inst=pkg->inst;
+    const sb_index_entry_s *e=idx ? sb_index_lookup(idx, inst->name) : NULL;
+    const slack_index_entry_s *se=sidx ? slack_index_lookup(sidx, inst->name) : NULL;
+    const char *repo=FOOTPRINT_OTHER;
+    const char *location=pkg->location;
+    const char *series;
+    size_t len;
+    if(installed_from_slackbuild(inst, e!=NULL, se!=NULL)){
+        repo=repo_get(e->repo)->name;
+        location=sb_index_str(idx, e->location);
+        //the category is the component before the name of the package
+        if(by==FOOTPRINT_REPO || strncmp(location, "./", 2) || (series=strchr(location+2, '/'))==NULL)
+            return g_strdup(repo);
+        return g_strdup_printf("%s/%.*s", repo, (int)(series-location-2), location+2);
+    }
+    else if(se){
+        repo=slack_index_str(sidx, se->repo);
+        location=slack_index_str(sidx, se->location);
+    }
+    else if(location && !strncmp(location, "./", 2) && (series=strchr(location+2, '/'))
+            && strchr(series+1, '/')){
+        //installed from a Slackware tree missing from the catalog, ./slackware64/ap/...
+        char *top=g_strndup(location+2, series-location-2);
+        char *group;
+        if(by==FOOTPRINT_REPO || (series=last_component(location, &len))==NULL)
+            return top;
+        group=g_strdup_printf("%s/%.*s", top, (int)len, series);
+        g_free(top);
+        return group;
+    }
+    if(by==FOOTPRINT_REPO || location==NULL || (series=last_component(location, &len))==NULL)
+        return g_strdup(repo);
+    return g_strdup_printf("%s/%.*s", repo, (int)len, series);
+}
+
+static int compare_sizeu(const void *a, const void *b)
+{
+    const fp_total_s *x=*(fp_total_s **)a;
+    const fp_total_s *y=*(fp_total_s **)b;
+    if(x->sizeu!=y->sizeu)
+        return x->sizeu<y->sizeu ? 1 : -1;
+    return strcmp(x->key, y->key);
+}
+
+static int compare_disk(const void *a, const void *b)
+{
+    const fp_total_s *x=*(fp_total_s **)a;
+    const fp_total_s *y=*(fp_total_s **)b;
+    if(x->disk!=y->disk)
+        return x->disk<y->disk ? 1 : -1;
+    return compare_sizeu(a, b);
+}
+
+static void add_total(fp_total_s *t, const fp_pkg_s *pkg)
+{
+    t->packages++;
+    t->sizec+=pkg->sizec;
+    t->sizeu+=pkg->sizeu;
+    t->apparent+=pkg->apparent;
+    t->disk+=pkg->disk;
+    t->files+=pkg->files;
+    t->dirs+=pkg->dirs;
+    t->missing+=pkg->missing;
+}
+
+static void print_total(FILE *out, const fp_total_s *t, int by, int disk)
+{
+    fprintf(out, "%12"PRIu64" %12"PRIu64" %8u %6u", t->sizeu/1024, t->sizec/1024, t->files, t->dirs);
+    if(disk)
+        fprintf(out, " %12"PRIu64" %12"PRIu64" %7u", t->apparent/1024, t->disk/1024, t->missing);
+    if(by!=FOOTPRINT_PACKAGE)
+        fprintf(out, " %8u", t->packages);
+    fprintf(out, " %s\n", t->key);
+}
+
+/** Print the installed size of every package, or of every series or
+ * repository, largest first, followed by the total.  Sizes are in KiB.
+ * The catalogs are only read to group the packages, and either may be
+ * missing.
+ * \param by FOOTPRINT_PACKAGE, FOOTPRINT_SERIES or FOOTPRINT_REPO
+ * \param disk also lstat the files under \c ROOT for their size and disk usage
+ * \return 0 on success, 1 if out could not be written.
+ */
+int footprint_report(FILE *out, int by, int disk)
+{
+    GHashTable *table=installed_table();
+    sb_index_s *idx=by==FOOTPRINT_PACKAGE ? NULL : sb_index_try_get();
+    slack_index_s *sidx=by==FOOTPRINT_PACKAGE ? NULL : slack_index_try_get();
+    GHashTable *totals=g_hash_table_new(g_str_hash, g_str_equal);
+    GPtrArray *lines=g_ptr_array_new();
+    fp_total_s all={.key="total"};
+    fp_job_s job={.disk=disk};
+    GHashTableIter iter;
+    gpointer value;
+    size_t n=0;
+    uint64_t t;
+    job.pkgs=calloc(g_hash_table_size(table)+1, sizeof(fp_pkg_s));
+    g_hash_table_iter_init(&iter, table);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+        job.pkgs[n++].inst=value;
+    job.root=bs_path(PATH_ROOT);//read before the workers start
+    job.rootlen=strlen(job.root);
+    while(job.rootlen && job.root[job.rootlen-1]=='/')
+        job.rootlen--;
+    t=STATS_BEGIN();
+    parallel_for(n, read_pkg, &job);
+    STATS_END(STATS_INSTALLED, t);
+    for(size_t i=0; i<n; i++){
+        fp_pkg_s *pkg=&job.pkgs[i];
+        char *key=by==FOOTPRINT_PACKAGE ? g_strdup(pkg->inst->fullname) : group_of(pkg, idx, sidx, by);
+        fp_total_s *line=g_hash_table_lookup(totals, key);
+        if(line==NULL){
+            line=calloc(1, sizeof(*line));
+            line->key=key;
+            g_hash_table_insert(totals, key, line);
+            g_ptr_array_add(lines, line);
+        }
+        else
+            g_free(key);
+        add_total(line, pkg);
+        add_total(&all, pkg);
+        g_free(pkg->location);
+    }
+    t=STATS_BEGIN();
+    qsort(lines->pdata, lines->len, sizeof(gpointer), disk ? compare_disk : compare_sizeu);
+    fprintf(out, "%12s %12s %8s %6s", "Installed K", "Package K", "Files", "Dirs");
+    if(disk)
+        fprintf(out, " %12s %12s %7s", "Apparent K", "On disk K", "Missing");
+    if(by!=FOOTPRINT_PACKAGE)
+        fprintf(out, " %8s", "Packages");
+    fprintf(out, " %s\n", by==FOOTPRINT_PACKAGE ? "Package" : by==FOOTPRINT_SERIES ? "Series" : "Repository");
+    for(guint i=0; i<lines->len; i++){
+        fp_total_s *line=lines->pdata[i];
+        print_total(out, line, by, disk);
+        g_free(line->key);
+        free(line);
+    }
+    print_total(out, &all, by, disk);
+    STATS_END(STATS_OUTPUT, t);
+    g_ptr_array_free(lines, TRUE);
+    g_hash_table_destroy(totals);
+    free(job.pkgs);
+    return fflush(out)!=0 || ferror(out);
+}
@@ -0,0 +1,20 @@
+/** \file
+ * Installed footprint of the packages of \c SB_DB.
+ *
+ * Every record gives the compressed and uncompressed size of its package and
+ * the list of its files.  The records are read on the thread pool and their
+ * sizes summed per package, per series or per repository.  A Slackware
+ * package takes its series and repository from the catalog, a Slackbuild its
+ * category and repository from the index, anything else is \c FOOTPRINT_OTHER.
+ * With disk usage asked for, the files of the lists are also lstat'ed under
+ * \c ROOT for their actual size and the space they take on disk.
+ */
+#ifndef BRIGHT_FOOTPRINT_H
+#define BRIGHT_FOOTPRINT_H
+#include <stdio.h>
+
+enum {FOOTPRINT_PACKAGE=0, FOOTPRINT_SERIES, FOOTPRINT_REPO}; //!< What the totals are grouped by.
+#define FOOTPRINT_OTHER "other"       //!< Series and repository of the packages known to neither index.
+
+int footprint_report(FILE *out, int by, int disk);
+#endif /* BRIGHT_FOOTPRINT_H */
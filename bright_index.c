@@ -0,0 +1,394 @@
+/** \file
+ * Build, cache and query the SLACKBUILDS.TXT index.
+ *
+ * The index is rebuilt whenever the list of repositories changes or one of
+ * their SLACKBUILDS.TXT changes size or mtime.  It is
+ * saved in \c BS_CACHEDIR when that directory is writable, otherwise it only
+ * lives for the duration of the process.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_repo.h"
+#include "bright_scan.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+static sb_index_s *sb_index=NULL;
+
+/** Return the mtime of st in nanoseconds, so that two changes within the
+ * same second are told apart.
+ */
+int64_t stamp_mtime(const struct stat *st)
+{
+    return st->st_mtim.tv_sec*1000000000LL+st->st_mtim.tv_nsec;
+}
+
+/** Tell if a stat result still matches a recorded size and mtime.
+ * \return 1 if they match, 0 otherwise.
+ */
+int stamp_matches(const struct stat *st, uint64_t size, int64_t mtime)
+{
+    return (uint64_t)st->st_size==size && stamp_mtime(st)==mtime;
+}
+
+/** Map a whole file read only.
+ * \param path the file to map
+ * \param size receive the size of the mapping
+ * \return the mapping or NULL if the file cannot be opened or is empty.
+ */
+void *map_file(const char *path, size_t *size)
+{
+    struct stat st;
+    void *p;
+    int fd=open(path, O_RDONLY);
+    if(fd<0)
+        return NULL;
+    if(fstat(fd, &st)<0 || st.st_size==0){
+        close(fd);
+        return NULL;
+    }
+    p=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(p==MAP_FAILED)
+        return NULL;
+    STATS_COUNT(STATS_MMAP, 1);
+    STATS_FILE(path, st.st_size);
+    *size=st.st_size;
+    return p;
+}
+
+/** Write buf to path through a temporary file renamed over path, so readers
+ * never see a half written file.  The parent directory is created if needed.
+ * \return 0 on success, -1 on failure.
+ */
+int write_file_atomic(const char *path, const void *buf, size_t size)
+{
+    char *tmp=NULL;
+    char *dir=strdup(path);
+    char *slash=rindex(dir, '/');
+    int fd;
+    if(slash){
+        *slash='\0';
+        mkdir(dir, 0755);
+    }
+    free(dir);
+    asprintf(&tmp, "%s.XXXXXX", path);
+    if((fd=mkstemp(tmp))<0){
+        free(tmp);
+        return -1;
+    }
+    fchmod(fd, 0644);
+    const char *p=buf;
+    while(size>0){
+        ssize_t n=write(fd, p, size);
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0){
+            close(fd);
+            unlink(tmp);
+            free(tmp);
+            return -1;
+        }
+        p+=n;
+        size-=n;
+    }
+    if(close(fd)<0 || rename(tmp, path)<0){
+        unlink(tmp);
+        free(tmp);
+        return -1;
+    }
+    free(tmp);
+    return 0;
+}
+
+/** Add s to the string pool and return its offset.
+ */
+static uint32_t pool_add(GString *pool, const char *s, size_t len)
+{
+    uint32_t offset=pool->len;
+    g_string_append_len(pool, s, len);
+    g_string_append_c(pool, '\0');
+    return offset;
+}
+
+static const char *sort_strings;
+/** Order on the case-folded name, then on the priority of the repository.
+ */
+static int entry_cmp(const void *a, const void *b)
+{
+    const sb_index_entry_s *ea=a;
+    const sb_index_entry_s *eb=b;
+    int c=strcmp(sort_strings+ea->key, sort_strings+eb->key);
+    if(c)
+        return c;
+    return ea->repo<eb->repo ? -1 : ea->repo>eb->repo;
+}
+
+/** Add the packages of the SLACKBUILDS.TXT of repository repo to entries.
+ * \param entries the entries, grown as needed
+ * \param count the number of entries, updated
+ * \param alloc the allocated number of entries, updated
+ */
+static void parse_txt(uint32_t repo, GString *pool, sb_index_entry_s **entries, size_t *count, size_t *alloc)
+{
+    size_t len=0;
+    const char *buf;
+    if((buf=map_file(repo_get(repo)->txt, &len))==NULL)
+        return;
+    sb_index_entry_s *cur=NULL;
+    const char *line=buf;
+    const char *eof=buf+len;
+    while(line<eof){
+        scan_line_s l;
+        const char *next=scan_line(line, eof, &l);
+        size_t vlen=l.end-l.value;
+        if(l.key==SCAN_SB_NAME){
+            if(*count==*alloc){
+                *alloc=*alloc ? *alloc*2 : 1024;
+                *entries=realloc(*entries, *alloc*sizeof(**entries));
+            }
+            cur=&(*entries)[(*count)++];
+            memset(cur, 0, sizeof(*cur));
+            cur->offset=line-buf;
+            cur->repo=repo;
+            cur->name=pool_add(pool, l.value, vlen);
+            char *key=g_ascii_strdown(l.value, vlen);
+            cur->key=pool_add(pool, key, strlen(key));
+            g_free(key);
+        }
+        else if(cur && line==l.end){//Blank line, the record is complete
+            cur->length=line-buf-cur->offset;
+            cur=NULL;
+        }
+        else if(cur){
+            if(l.key==SCAN_SB_LOCATION)
+                cur->location=pool_add(pool, l.value, vlen);
+            else if(l.key==SCAN_SB_VERSION)
+                cur->version=pool_add(pool, l.value, vlen);
+            else if(l.key==SCAN_SB_SHORTDESCR)
+                cur->shortdescr=pool_add(pool, l.value, vlen);
+        }
+        line=next;
+    }
+    if(cur)
+        cur->length=len-cur->offset;
+    munmap((void *)buf, len);
+}
+
+/** Return the stamp of the repositories: a digest of their names, priorities
+ * and directories and of the size and mtime of their SLACKBUILDS.TXT.  It
+ * changes whenever any of them does.
+ * \param found receive the number of repositories with a SLACKBUILDS.TXT
+ */
+uint64_t sb_index_stamp(int *found)
+{
+    uint64_t h=14695981039346656037ULL;
+    *found=0;
+    for(int i=0; i<repo_count(); i++){
+        const repo_s *r=repo_get(i);
+        struct stat st;
+        int64_t v[3]={r->priority, -1, -1};
+        if(stat(r->txt, &st)==0){
+            v[1]=st.st_size;
+            v[2]=stamp_mtime(&st);
+            (*found)++;
+        }
+        for(const char *p=r->name; *p; p++)
+            h=(h^(unsigned char)*p)*1099511628211ULL;
+        for(const char *p=r->dir; *p; p++)
+            h=(h^(unsigned char)*p)*1099511628211ULL;
+        for(size_t k=0; k<sizeof(v); k++)
+            h=(h^((unsigned char *)v)[k])*1099511628211ULL;
+    }
+    return h;
+}
+
+/** Parse the SLACKBUILDS.TXT of every repository into an index image.  Of
+ * the packages found in several repositories only the one of the repository
+ * of highest priority is kept.
+ * \param stamp the stamp of the repositories, from sb_index_stamp()
+ * \param size receive the size of the image
+ * \return a malloc'ed image.
+ */
+static void *build_image(uint64_t stamp, size_t *size)
+{
+    GString *pool=g_string_new(NULL);
+    sb_index_entry_s *entries=NULL;
+    size_t count=0, alloc=0, kept=0;
+    g_string_append_c(pool, '\0'); //offset 0 is the empty string
+    for(int r=0; r<repo_count(); r++)
+        parse_txt(r, pool, &entries, &count, &alloc);
+
+    sort_strings=pool->str;
+    qsort(entries, count, sizeof(*entries), entry_cmp);
+    for(size_t i=0; i<count; i++)//Shadowed packages follow the one that shadows them
+        if(kept==0 || strcmp(pool->str+entries[i].key, pool->str+entries[kept-1].key))
+            entries[kept++]=entries[i];
+
+    sb_index_header_s hdr={};
+    memcpy(hdr.magic, SB_INDEX_MAGIC, sizeof(hdr.magic));
+    hdr.stamp=stamp;
+    hdr.count=kept;
+    hdr.strings_size=pool->len;
+    *size=sizeof(hdr)+kept*sizeof(*entries)+pool->len;
+    char *image=malloc(*size);
+    memcpy(image, &hdr, sizeof(hdr));
+    memcpy(image+sizeof(hdr), entries, kept*sizeof(*entries));
+    memcpy(image+sizeof(hdr)+kept*sizeof(*entries), pool->str, pool->len);
+    free(entries);
+    g_string_free(pool, TRUE);
+    return image;
+}
+
+/** Point the index members to their place in the image and check the image
+ * was built from the repositories as they are now.
+ * \param stamp the stamp of the repositories, from sb_index_stamp()
+ * \return 0 if the image can be used, -1 otherwise.
+ */
+static int attach_image(sb_index_s *idx, uint64_t stamp)
+{
+    const sb_index_header_s *hdr=idx->data;
+    if(idx->size<sizeof(*hdr) || memcmp(hdr->magic, SB_INDEX_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    if(hdr->stamp!=stamp)
+        return -1;
+    if(idx->size!=sizeof(*hdr)+(size_t)hdr->count*sizeof(sb_index_entry_s)+hdr->strings_size)
+        return -1;
+    idx->hdr=hdr;
+    idx->entries=(const sb_index_entry_s *)(hdr+1);
+    idx->strings=(const char *)(idx->entries+hdr->count);
+    return 0;
+}
+
+/** Build the index of the repositories and save it at idx.
+ * \return 0 on success, -1 if idx cannot be written.
+ */
+int sb_index_build(const char *idx)
+{
+    size_t size;
+    int found;
+    void *image=build_image(sb_index_stamp(&found), &size);
+    int ret=write_file_atomic(idx, image, size);
+    free(image);
+    return ret;
+}
+
+/** Return the index of the repositories, opening or rebuilding it on first use.
+ * \return the index, NULL if no repository has a SLACKBUILDS.TXT, e.g. in
+ * the middle of a resync.
+ */
+sb_index_s *sb_index_try_get(void)
+{
+    uint64_t stamp;
+    uint64_t t;
+    int found;
+    if(sb_index)
+        return sb_index;
+    t=STATS_BEGIN();
+    stamp=sb_index_stamp(&found);
+    if(found==0)
+        return NULL;
+    sb_index=calloc(1, sizeof(*sb_index));
+    if((sb_index->data=map_file(SB_INDEX_PATH, &sb_index->size))){
+        sb_index->mapped=1;
+        if(attach_image(sb_index, stamp)==0){
+            STATS_END(STATS_INDEX, t);
+            return sb_index;
+        }
+        munmap(sb_index->data, sb_index->size);
+        sb_index->mapped=0;
+    }
+    sb_index->data=build_image(stamp, &sb_index->size);
+    write_file_atomic(SB_INDEX_PATH, sb_index->data, sb_index->size); //Best effort, may not be root
+    attach_image(sb_index, stamp);
+    STATS_END(STATS_INDEX, t);
+    return sb_index;
+}
+
+/** Return the index of the repositories, as \c sb_index_try_get() does.
+ * Exit if no repository has a SLACKBUILDS.TXT, as \c file_open() would.
+ */
+sb_index_s *sb_index_get(void)
+{
+    sb_index_s *idx=sb_index_try_get();
+    if(idx==NULL){
+        printf("Cannot open file %s for mode %s\n", repo_get(0)->txt, "r");
+        printf("%s\n","Cannot proceed further");
+        exit(1);
+    }
+    return idx;
+}
+
+/** Tell if the repositories changed since the index was opened.
+ * \return 1 if the index must be reopened, 0 otherwise.
+ */
+int sb_index_stale(void)
+{
+    int found;
+    return sb_index && sb_index->hdr->stamp!=sb_index_stamp(&found);
+}
+
+/** Unmap or free the index.
+ */
+void sb_index_release(void)
+{
+    if(sb_index==NULL)
+        return;
+    if(sb_index->mapped)
+        munmap(sb_index->data, sb_index->size);
+    else
+        free(sb_index->data);
+    free(sb_index);
+    sb_index=NULL;
+}
+
+/** Find a package by name, ignoring case.
+ * \return the entry or NULL if there is no such package.
+ */
+const sb_index_entry_s *sb_index_lookup(sb_index_s *idx, const char *name)
+{
+    char *key=g_ascii_strdown(name, -1);
+    size_t lo=0;
+    size_t hi=idx->hdr->count;
+    const sb_index_entry_s *found=NULL;
+    while(lo<hi){
+        size_t mid=lo+(hi-lo)/2;
+        int c=strcmp(key, idx->strings+idx->entries[mid].key);
+        if(c==0){
+            found=&idx->entries[mid];
+            break;
+        }
+        if(c<0)
+            hi=mid;
+        else
+            lo=mid+1;
+    }
+    g_free(key);
+    return found;
+}
+
+/** Return the string stored at offset in the pool.
+ */
+const char *sb_index_str(sb_index_s *idx, uint32_t offset)
+{
+    return idx->strings+offset;
+}
+
+/** Read the record of entry e from the SLACKBUILDS.TXT of its repository.
+ * \return a NUL terminated copy of the record to be freed by the caller,
+ * NULL if SLACKBUILDS.TXT cannot be opened.
+ */
+char *sb_index_read_record(const sb_index_entry_s *e)
+{
+    const char *txt=repo_get(e->repo)->txt;
+    FILE *fp=file_try_open(txt, "r");
+    char *record;
+    if(fp==NULL)
+        return NULL;
+    record=calloc(1, e->length+1);
+    if(fseeko(fp, e->offset, SEEK_SET)==0 && fread(record, 1, e->length, fp)!=e->length)
+        record[0]='\0';
+    STATS_FILE(txt, e->length);
+    fclose(fp);
+    return record;
+}
@@ -0,0 +1,71 @@
+/** \file
+ * On-disk index of SLACKBUILDS.TXT.
+ *
+ * The index is a memory-mapped file made of a header, a table of entries
+ * sorted on the case-folded package name and a pool of NUL terminated
+ * strings.  Each entry keeps the fixed fields of a package, its repository
+ * and the byte range of its record in the SLACKBUILDS.TXT of that
+ * repository, so a lookup is a binary search followed by a single read of
+ * the record.  The SLACKBUILDS.TXT of all the repositories are merged in the
+ * one index, a package shadowed by a repository of higher priority being
+ * left out when the index is built.
+ */
+#ifndef BRIGHT_INDEX_H
+#define BRIGHT_INDEX_H
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define BS_CACHEDIR bs_path(PATH_BS_CACHEDIR)  //!< Where brightstar keeps its indexes and caches.
+#define CACHE_PATH(f) bs_file(PATH_BS_CACHEDIR, f) //!< The full path of a file of \c BS_CACHEDIR.
+#define SB_INDEX "SLACKBUILDS.idx"             //!< The index file of SLACKBUILDS.TXT.
+#define SB_INDEX_PATH CACHE_PATH(SB_INDEX)     //!< The full path of the SLACKBUILDS.TXT index.
+#define SB_INDEX_MAGIC "BSIDX02"               //!< Change it whenever the layout below changes.
+
+/**Header of the index file.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t stamp;          //!< sb_index_stamp() when the index was built, to detect staleness.
+    uint32_t count;          //!< Number of entries.
+    uint32_t strings_size;   //!< Size of the string pool following the entries.
+} sb_index_header_s;
+
+/**One package of SLACKBUILDS.TXT.  String fields are offsets in the pool.
+ */
+typedef struct {
+    uint64_t offset;         //!< Byte offset of the record in the SLACKBUILDS.TXT of the repository.
+    uint32_t length;         //!< Length of the record, trailing blank line excluded.
+    uint32_t key;            //!< Case-folded name, the sort key.
+    uint32_t name;           //!< Name as spelled in SLACKBUILDS.TXT.
+    uint32_t location;
+    uint32_t version;
+    uint32_t shortdescr;
+    uint32_t repo;           //!< The repository of the package, for repo_get().
+} sb_index_entry_s;
+
+/**An opened index, either mapped from the cache or built in memory.
+ */
+typedef struct {
+    void *data;                      //!< The whole index image.
+    size_t size;                     //!< Size of the image.
+    int mapped;                      //!< 1 if data is mmap'ed, 0 if malloc'ed.
+    const sb_index_header_s *hdr;
+    const sb_index_entry_s *entries;
+    const char *strings;
+} sb_index_s;
+
+int64_t stamp_mtime(const struct stat *st);
+int stamp_matches(const struct stat *st, uint64_t size, int64_t mtime);
+void *map_file(const char *path, size_t *size);
+int write_file_atomic(const char *path, const void *buf, size_t size);
+sb_index_s *sb_index_try_get(void);
+sb_index_s *sb_index_get(void);
+void sb_index_release(void);
+int sb_index_build(const char *idx);
+uint64_t sb_index_stamp(int *found);
+int sb_index_stale(void);
+const sb_index_entry_s *sb_index_lookup(sb_index_s *idx, const char *name);
+const char *sb_index_str(sb_index_s *idx, uint32_t offset);
+char *sb_index_read_record(const sb_index_entry_s *e);
+#endif /* BRIGHT_INDEX_H */
@@ -0,0 +1,222 @@
+/** \file
+ * Load and query the table of installed packages.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+
+static GHashTable *installed=NULL;
+
+/** Split a package full name into its name, version, arch, build and tag.
+ * The name may itself contain dashes, so the fields are taken from the right.
+ * \param fullname like gtk+2-2.24.10-i486-1 or bind-9.9.2_P1-i486-1_slack14.0
+ * \return a new installed_s or NULL if fullname does not follow the convention.
+ */
+installed_s *installed_parse(const char *fullname)
+{
+    installed_s *inst;
+    char *buf;
+    char *dash[3];
+    size_t len=strlen(fullname);
+    inst=calloc(1, sizeof(*inst)+2*len+3);
+    inst->fullname=(char *)(inst+1);
+    strcpy(inst->fullname, fullname);
+    buf=inst->fullname+len+1;
+    strcpy(buf, fullname);
+    for(int i=0; i<3; i++){
+        if((dash[i]=rindex(buf, '-'))==NULL || dash[i]==buf){
+            free(inst);
+            return NULL;
+        }
+        *dash[i]='\0';
+    }
+    inst->name=buf;
+    inst->version=dash[2]+1;
+    inst->arch=dash[1]+1;
+    /*Build and tag share the last field, the build being its leading digits.
+     *The tag is moved one byte to the right to make room for the NUL.*/
+    char *buildtag=dash[0]+1;
+    size_t digits=strspn(buildtag, "0123456789");
+    memmove(buildtag+digits+1, buildtag+digits, strlen(buildtag+digits)+1);
+    buildtag[digits]='\0';
+    inst->build=buildtag;
+    inst->tag=buildtag+digits+1;
+    return inst;
+}
+
+/** Free an installed_s returned by installed_parse().
+ */
+void installed_free(installed_s *inst)
+{
+    free(inst);
+}
+
+static void add_entry(const char *fullname)
+{
+    installed_s *inst;
+    if(fullname[0]=='.' || (inst=installed_parse(fullname))==NULL)
+        return;
+    g_hash_table_replace(installed, inst->name, inst);
+}
+
+/** Fill the table from the cache if it was written for the current mtime of \c SB_DB.
+ * \return 0 if the cache was used, -1 otherwise.
+ */
+static int load_cache(const struct stat *st)
+{
+    size_t size;
+    char *buf=map_file(CACHE_PATH(INSTALLED_CACHE), &size);
+    char *copy;
+    char *line;
+    char *pline;
+    long long sec, nsec;
+    if(buf==NULL)
+        return -1;
+    copy=strndup(buf, size);
+    munmap(buf, size);
+    line=strtok_r(copy, "\n", &pline);
+    if(line==NULL || sscanf(line, INSTALLED_MAGIC " %lld %lld", &sec, &nsec)!=2
+            || sec!=st->st_mtim.tv_sec || nsec!=st->st_mtim.tv_nsec){
+        free(copy);
+        return -1;
+    }
+    while((line=strtok_r(NULL, "\n", &pline)))
+        add_entry(line);
+    free(copy);
+    return 0;
+}
+
+/** Read \c SB_DB and save the entry names in the cache, best effort.
+ */
+static void scan_db(const struct stat *st)
+{
+    DIR *dir;
+    struct dirent *d;
+    GString *cache=g_string_new(NULL);
+    if((dir=opendir(SB_DB))==NULL){
+        perror("opendir");
+        g_string_free(cache, TRUE);
+        return;
+    }
+    STATS_COUNT(STATS_OPENDIR, 1);
+    g_string_append_printf(cache, INSTALLED_MAGIC " %lld %lld\n",
+            (long long)st->st_mtim.tv_sec, (long long)st->st_mtim.tv_nsec);
+    while((d=readdir(dir))){
+        if(d->d_name[0]=='.')
+            continue;
+        add_entry(d->d_name);
+        g_string_append_printf(cache, "%s\n", d->d_name);
+    }
+    closedir(dir);
+    write_file_atomic(CACHE_PATH(INSTALLED_CACHE), cache->str, cache->len);
+    g_string_free(cache, TRUE);
+}
+
+/** Return the table of installed packages, name -> installed_s, loading it on first use.
+ */
+GHashTable *installed_table(void)
+{
+    struct stat st;
+    uint64_t t;
+    if(installed)
+        return installed;
+    t=STATS_BEGIN();
+    installed=g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)installed_free);
+    if(stat(SB_DB, &st)<0){
+        perror("stat");
+        return installed;
+    }
+    if(load_cache(&st)<0)
+        scan_db(&st);
+    STATS_END(STATS_INDEX, t);
+    return installed;
+}
+
+/** Find an installed package by its exact name.
+ * \return the package or NULL if it is not installed.
+ */
+const installed_s *installed_lookup(const char *name)
+{
+    return g_hash_table_lookup(installed_table(), name);
+}
+
+/** Tell whether inst was built from a Slackbuild rather than installed from
+ * Slackware.  Without a Slackware package of its name it comes from the
+ * Slackbuild of its name, whatever the tag given by its repository: SBo,
+ * an overlay or a local build.  When both exist, the Slackware packages are
+ * the ones without a tag or with a tag of \c INSTALLED_SLACKWARE_TAG.
+ * \param slackbuild whether a repository has a Slackbuild of its name
+ * \param slackware whether the Slackware catalog has a package of its name
+ */
+int installed_from_slackbuild(const installed_s *inst, int slackbuild, int slackware)
+{
+    if(!slackbuild)
+        return 0;
+    if(!slackware)
+        return 1;
+    return inst->tag[0]!='\0' && strncmp(inst->tag, INSTALLED_SLACKWARE_TAG, strlen(INSTALLED_SLACKWARE_TAG));
+}
+
+/** Free the table of installed packages.
+ */
+void installed_release(void)
+{
+    if(installed==NULL)
+        return;
+    g_hash_table_destroy(installed);
+    installed=NULL;
+}
+
+/** Read the record of an installed package.
+ * \param fullname the entry of the package in \c SB_DB
+ * \param size receive the size of the record
+ * \return the record followed by a NUL, to be freed by the caller, or NULL if
+ * it cannot be read.
+ */
+char *installed_read_record(const char *fullname, size_t *size)
+{
+    char *path=g_strconcat(SB_DB, fullname, NULL);
+    int fd=open(path, O_RDONLY);
+    struct stat st;
+    char *buf=NULL;
+    size_t n=0;
+    if(fd<0 || fstat(fd, &st)<0)
+        goto done;
+    STATS_COUNT(STATS_FOPEN, 1);
+    buf=malloc(st.st_size+1);
+    while(n<(size_t)st.st_size){
+        ssize_t r=read(fd, buf+n, st.st_size-n);
+        if(r<0 && errno==EINTR)
+            continue;
+        if(r<=0)
+            break;
+        n+=r;
+    }
+    buf[n]='\0';
+    *size=n;
+    STATS_FILE(path, n);
+done:
+    if(fd>=0)
+        close(fd);
+    g_free(path);
+    return buf;
+}
+
+/** Return the first line of the file list of a record, NULL if the record
+ * has no \c INSTALLED_FILE_LIST line.
+ */
+const char *installed_file_list(const char *record, size_t size)
+{
+    size_t len=strlen(INSTALLED_FILE_LIST);
+    const char *eof=record+size;
+    for(const char *line=record; line<eof; ){
+        const char *nl=memchr(line, '\n', eof-line);
+        if((size_t)(eof-line)>=len && !memcmp(line, INSTALLED_FILE_LIST, len)
+                && (line+len==eof || line[len]=='\n' || line[len]=='\r'))
+            return nl ? nl+1 : eof;
+        line=nl ? nl+1 : eof;
+    }
+    return NULL;
+}
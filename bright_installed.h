@@ -0,0 +1,40 @@
+/** \file
+ * Table of the packages installed on the system.
+ *
+ * The entries of \c SB_DB are named after the Slackware convention
+ * name-version-arch-buildtag.  They are read once per process into a hash
+ * table keyed on the package name.  The list of entries is cached in
+ * \c BS_CACHEDIR and reused as long as the mtime of \c SB_DB is unchanged.
+ * Each entry is also a record of the package, its headers followed by the
+ * list of its files, which installed_read_record() reads.
+ */
+#ifndef BRIGHT_INSTALLED_H
+#define BRIGHT_INSTALLED_H
+
+#define INSTALLED_CACHE "installed.cache"             //!< The cache file of the installed packages list.
+#define INSTALLED_MAGIC "BSINST01"                    //!< First word of the cache file.
+#define INSTALLED_FILE_LIST "FILE LIST:"              //!< The line of a record after which its files are listed.
+#define INSTALLED_SIZEC "COMPRESSED PACKAGE SIZE"     //!< Size of the package file, in a record.
+#define INSTALLED_SIZEU "UNCOMPRESSED PACKAGE SIZE"   //!< Size of the installed files, in a record.
+#define INSTALLED_SLACKWARE_TAG "_slack"              //!< Start of the tag of the Slackware patches, _slack14.0.
+
+/**An installed package, split from its entry name in \c SB_DB.
+ */
+typedef struct {
+    char *fullname;  //!< The entry name, e.g. bind-9.9.2_P1-i486-1_slack14.0
+    char *name;      //!< bind
+    char *version;   //!< 9.9.2_P1
+    char *arch;      //!< i486
+    char *build;     //!< 1
+    char *tag;       //!< _slack14.0, empty for native packages.
+} installed_s;
+
+installed_s *installed_parse(const char *fullname);
+void installed_free(installed_s *inst);
+GHashTable *installed_table(void);
+const installed_s *installed_lookup(const char *name);
+int installed_from_slackbuild(const installed_s *inst, int slackbuild, int slackware);
+void installed_release(void);
+char *installed_read_record(const char *fullname, size_t *size);
+const char *installed_file_list(const char *record, size_t size);
+#endif /* BRIGHT_INSTALLED_H */
@@ -0,0 +1,464 @@
+/** \file
+ * Build, cache and query the index of the files of the installed packages.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_pool.h"
+#include "bright_owner.h"
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/mman.h>
+
+static owner_index_s *owners=NULL;
+
+/**An installed package while the index is built.
+ */
+typedef struct {
+    char *fullname;
+    uint64_t size;
+    int64_t mtime;
+    int64_t old;             //!< Its number in the previous index if its record is unchanged, -1 otherwise.
+    char *record;            //!< The record read, its lines cut into the paths.
+    GPtrArray *paths;        //!< The paths of the package, sorted.
+} build_pkg_s;
+
+/**A growing byte buffer.
+ */
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t alloc;
+} bytes_s;
+
+static void bytes_reserve(bytes_s *b, size_t n)
+{
+    if(b->len+n<=b->alloc)
+        return;
+    while(b->len+n>b->alloc)
+        b->alloc=b->alloc ? b->alloc*2 : 65536;
+    b->data=realloc(b->data, b->alloc);
+}
+
+static void put_varint(bytes_s *b, uint64_t v)
+{
+    bytes_reserve(b, 10);
+    do{
+        uint8_t c=v&0x7f;
+        v>>=7;
+        b->data[b->len++]=c|(v ? 0x80 : 0);
+    }while(v);
+}
+
+static uint64_t get_varint(const uint8_t **p)
+{
+    uint64_t v=0;
+    int shift=0;
+    uint8_t c;
+    do{
+        c=*(*p)++;
+        v|=(uint64_t)(c&0x7f)<<shift;
+        shift+=7;
+    }while(c&0x80 && shift<64);
+    return v;
+}
+
+/**A position in the coded pairs and the pair last decoded.
+ */
+typedef struct {
+    const uint8_t *p;
+    uint32_t i;              //!< Number of the next pair.
+    size_t len;
+    uint32_t pkg;
+    char path[OWNER_PATH_MAX];
+} cursor_s;
+
+/** Decode the next pair.
+ * \return 1 if there was one, 0 at the end of the index.
+ */
+static int cursor_next(const owner_index_s *o, cursor_s *c)
+{
+    size_t shared, rest;
+    if(c->i>=o->hdr->npairs)
+        return 0;
+    shared=get_varint(&c->p);
+    rest=get_varint(&c->p);
+    if(shared>c->len || shared+rest>=OWNER_PATH_MAX)
+        return 0;
+    memcpy(c->path+shared, c->p, rest);
+    c->p+=rest;
+    c->len=shared+rest;
+    c->path[c->len]='\0';
+    c->pkg=get_varint(&c->p);
+    if(c->pkg>=o->hdr->npkgs)
+        return 0;
+    c->i++;
+    return 1;
+}
+
+/** Place c at the start of the last block whose first path sorts before key,
+ * so that the pairs from key on come next.
+ */
+static void cursor_seek(const owner_index_s *o, cursor_s *c, const char *key)
+{
+    size_t klen=strlen(key);
+    uint32_t lo=0, hi=o->hdr->nblocks;
+    while(lo<hi){
+        uint32_t mid=lo+(hi-lo)/2;
+        const uint8_t *p=o->pairs+o->blocks[mid];
+        size_t rest;
+        int cmp;
+        get_varint(&p);//0, the first pair of a block shares nothing
+        rest=get_varint(&p);
+        cmp=memcmp(p, key, rest<klen ? rest : klen);
+        if(cmp==0)
+            cmp=rest<klen ? -1 : rest>klen;
+        if(cmp<0)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    lo=lo ? lo-1 : 0;
+    c->p=o->pairs+(o->hdr->nblocks ? o->blocks[lo] : 0);
+    c->i=lo*OWNER_BLOCK;
+    c->len=0;
+}
+
+/** Point the index members to their place in the image.
+ * \return 0 if the image can be used, -1 otherwise.
+ */
+static int attach_image(owner_index_s *o)
+{
+    const owner_header_s *hdr=o->data;
+    size_t size;
+    if(o->size<sizeof(*hdr) || memcmp(hdr->magic, OWNER_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    size=sizeof(*hdr)+(size_t)hdr->npkgs*sizeof(owner_pkg_s)+(size_t)hdr->nblocks*sizeof(uint32_t)
+        +hdr->data_size+hdr->strings_size;
+    if(o->size!=size || hdr->nblocks!=(hdr->npairs+OWNER_BLOCK-1)/OWNER_BLOCK)
+        return -1;
+    o->hdr=hdr;
+    o->pkgs=(const owner_pkg_s *)(hdr+1);
+    o->blocks=(const uint32_t *)(o->pkgs+hdr->npkgs);
+    o->pairs=(const uint8_t *)(o->blocks+hdr->nblocks);
+    o->strings=(const char *)(o->pairs+hdr->data_size);
+    return 0;
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+static int compare_pkgs(const void *a, const void *b)
+{
+    return strcmp(((const build_pkg_s *)a)->fullname, ((const build_pkg_s *)b)->fullname);
+}
+
+/** Read the record of a package that changed and sort its paths.
+ */
+static void read_pkg(size_t i, void *arg)
+{
+    build_pkg_s *pkg=&((build_pkg_s *)arg)[i];
+    size_t size;
+    char *p;
+    char *eof;
+    if(pkg->old>=0)
+        return;
+    if((pkg->record=installed_read_record(pkg->fullname, &size))==NULL)
+        return;
+    eof=pkg->record+size;
+    if((p=(char *)installed_file_list(pkg->record, size))==NULL)
+        return;
+    while(p<eof){
+        char *nl=memchr(p, '\n', eof-p);
+        if(nl==NULL)
+            nl=eof;
+        *nl='\0';
+        if(nl>p && strcmp(p, "./") && nl-p<OWNER_PATH_MAX)
+            g_ptr_array_add(pkg->paths, p);
+        p=nl+1;
+    }
+    qsort(pkg->paths->pdata, pkg->paths->len, sizeof(gpointer), compare_paths);
+}
+
+/** List the records of \c SB_DB with their size and mtime, sorted on their name.
+ */
+static GArray *list_pkgs(void)
+{
+    GArray *pkgs=g_array_new(FALSE, TRUE, sizeof(build_pkg_s));
+    DIR *dir;
+    struct dirent *d;
+    if((dir=opendir(SB_DB))==NULL){
+        perror("opendir");
+        return pkgs;
+    }
+    STATS_COUNT(STATS_OPENDIR, 1);
+    while((d=readdir(dir))){
+        build_pkg_s pkg={};
+        struct stat st;
+        if(d->d_name[0]=='.' || fstatat(dirfd(dir), d->d_name, &st, 0)<0 || !S_ISREG(st.st_mode))
+            continue;
+        pkg.fullname=strdup(d->d_name);
+        pkg.size=st.st_size;
+        pkg.mtime=stamp_mtime(&st);
+        pkg.old=-1;
+        g_array_append_val(pkgs, pkg);
+    }
+    closedir(dir);
+    g_array_sort(pkgs, compare_pkgs);
+    return pkgs;
+}
+
+/** Give the packages whose record is unchanged their paths in the previous index.
+ * \param strings where the decoded paths are allocated
+ */
+static void reuse_paths(const owner_index_s *prev, build_pkg_s *pkgs, guint npkgs, arena_s *strings)
+{
+    GHashTable *names=g_hash_table_new(g_str_hash, g_str_equal);
+    int64_t *map=malloc((prev->hdr->npkgs ? prev->hdr->npkgs : 1)*sizeof(int64_t));
+    int reused=0;
+    cursor_s c={prev->pairs, 0, 0};
+    for(uint32_t i=0; i<prev->hdr->npkgs; i++){
+        map[i]=-1;
+        g_hash_table_insert(names, (char *)prev->strings+prev->pkgs[i].fullname, GINT_TO_POINTER(i+1));
+    }
+    for(guint i=0; i<npkgs; i++){
+        int64_t old=GPOINTER_TO_INT(g_hash_table_lookup(names, pkgs[i].fullname))-1;
+        if(old>=0 && prev->pkgs[old].size==pkgs[i].size && prev->pkgs[old].mtime==pkgs[i].mtime){
+            pkgs[i].old=old;
+            map[old]=i;
+            reused++;
+        }
+    }
+    while(reused && cursor_next(prev, &c))//Decoded in order, so each list comes out sorted
+        if(map[c.pkg]>=0)
+            g_ptr_array_add(pkgs[map[c.pkg]].paths, arena_strndup(strings, c.path, c.len));
+    free(map);
+    g_hash_table_destroy(names);
+}
+
+/** Restore the heap property from node i down, the package of lowest
+ * current path, then lowest number, being at the top.
+ */
+static void sift_down(uint32_t *heap, int n, int i, const build_pkg_s *pkgs, const guint *pos)
+{
+    for(;;){
+        int least=i;
+        for(int k=2*i+1; k<=2*i+2 && k<n; k++){
+            int cmp=strcmp(pkgs[heap[k]].paths->pdata[pos[heap[k]]], pkgs[heap[least]].paths->pdata[pos[heap[least]]]);
+            if(cmp<0 || (cmp==0 && heap[k]<heap[least]))
+                least=k;
+        }
+        if(least==i)
+            return;
+        uint32_t t=heap[i];
+        heap[i]=heap[least];
+        heap[least]=t;
+        i=least;
+    }
+}
+
+/** Merge the sorted paths of every package and front code them.
+ * \param blocks receive the offset of each block
+ * \return the number of pairs.
+ */
+static uint32_t merge_pairs(build_pkg_s *pkgs, guint npkgs, bytes_s *data, GArray *blocks)
+{
+    uint32_t *heap=malloc((npkgs ? npkgs : 1)*sizeof(uint32_t));
+    guint *pos=calloc(npkgs ? npkgs : 1, sizeof(guint));
+    const char *prev="";
+    uint32_t npairs=0;
+    int n=0;
+    for(guint i=0; i<npkgs; i++)
+        if(pkgs[i].paths->len)
+            heap[n++]=i;
+    for(int i=n/2-1; i>=0; i--)
+        sift_down(heap, n, i, pkgs, pos);
+    while(n>0){
+        uint32_t p=heap[0];
+        const char *path=pkgs[p].paths->pdata[pos[p]];
+        size_t len=strlen(path);
+        size_t shared=0;
+        if(npairs%OWNER_BLOCK==0){
+            uint32_t offset=data->len;
+            g_array_append_val(blocks, offset);
+        }
+        else
+            while(prev[shared] && prev[shared]==path[shared])
+                shared++;
+        put_varint(data, shared);
+        put_varint(data, len-shared);
+        bytes_reserve(data, len-shared);
+        memcpy(data->data+data->len, path+shared, len-shared);
+        data->len+=len-shared;
+        put_varint(data, p);
+        prev=path;
+        npairs++;
+        if(++pos[p]==pkgs[p].paths->len)
+            heap[0]=heap[--n];
+        sift_down(heap, n, 0, pkgs, pos);
+    }
+    free(heap);
+    free(pos);
+    return npairs;
+}
+
+/** Build the index image from the records of \c SB_DB.
+ * \param prev the previous index, whose paths are reused for the records
+ *        that did not change, or NULL
+ * \param db_mtime the mtime of \c SB_DB
+ */
+static void *build_image(const owner_index_s *prev, int64_t db_mtime, size_t *size)
+{
+    GArray *list=list_pkgs();
+    build_pkg_s *pkgs=(build_pkg_s *)list->data;
+    arena_s *strings=arena_new();
+    bytes_s data={};
+    GArray *blocks=g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    GString *pool=g_string_new(NULL);
+    owner_header_s hdr={};
+    owner_pkg_s *table=calloc(list->len ? list->len : 1, sizeof(owner_pkg_s));
+    char *image;
+    char *p;
+    for(guint i=0; i<list->len; i++)
+        pkgs[i].paths=g_ptr_array_new();
+    if(prev)
+        reuse_paths(prev, pkgs, list->len, strings);
+    parallel_for(list->len, read_pkg, pkgs);
+    hdr.npairs=merge_pairs(pkgs, list->len, &data, blocks);
+
+    for(guint i=0; i<list->len; i++){
+        table[i].size=pkgs[i].size;
+        table[i].mtime=pkgs[i].mtime;
+        table[i].fullname=pool->len;
+        g_string_append_len(pool, pkgs[i].fullname, strlen(pkgs[i].fullname)+1);
+        g_ptr_array_free(pkgs[i].paths, TRUE);
+        free(pkgs[i].record);
+        free(pkgs[i].fullname);
+    }
+    memcpy(hdr.magic, OWNER_MAGIC, sizeof(hdr.magic));
+    hdr.db_mtime=db_mtime;
+    hdr.npkgs=list->len;
+    hdr.nblocks=blocks->len;
+    hdr.strings_size=pool->len;
+    hdr.data_size=data.len;
+    *size=sizeof(hdr)+hdr.npkgs*sizeof(owner_pkg_s)+hdr.nblocks*sizeof(uint32_t)+data.len+pool->len;
+    p=image=malloc(*size);
+    memcpy(p, &hdr, sizeof(hdr));
+    p+=sizeof(hdr);
+    memcpy(p, table, hdr.npkgs*sizeof(owner_pkg_s));
+    p+=hdr.npkgs*sizeof(owner_pkg_s);
+    memcpy(p, blocks->data, hdr.nblocks*sizeof(uint32_t));
+    p+=hdr.nblocks*sizeof(uint32_t);
+    if(data.len)
+        memcpy(p, data.data, data.len);
+    p+=data.len;
+    memcpy(p, pool->str, pool->len);
+    free(table);
+    free(data.data);
+    g_array_free(blocks, TRUE);
+    g_string_free(pool, TRUE);
+    g_array_free(list, TRUE);
+    arena_free(strings);
+    return image;
+}
+
+/** Return the index, mapped from \c BS_CACHEDIR if it is up to date with
+ * \c SB_DB, built again otherwise.
+ */
+owner_index_s *owner_get(void)
+{
+    owner_index_s *prev;
+    struct stat st={};
+    uint64_t t;
+    if(owners)
+        return owners;
+    t=STATS_BEGIN();
+    if(stat(SB_DB, &st)<0)
+        perror("stat");
+    prev=calloc(1, sizeof(*prev));
+    if((prev->data=map_file(CACHE_PATH(OWNER_INDEX), &prev->size))){
+        prev->mapped=1;
+        if(attach_image(prev)==0 && prev->hdr->db_mtime==stamp_mtime(&st)){
+            owners=prev;
+            STATS_END(STATS_INDEX, t);
+            return owners;
+        }
+    }
+    owners=calloc(1, sizeof(*owners));
+    owners->data=build_image(prev->hdr ? prev : NULL, stamp_mtime(&st), &owners->size);
+    write_file_atomic(CACHE_PATH(OWNER_INDEX), owners->data, owners->size); //Best effort, may not be root
+    attach_image(owners);
+    if(prev->mapped)
+        munmap(prev->data, prev->size);
+    free(prev);
+    STATS_END(STATS_INDEX, t);
+    return owners;
+}
+
+/** Unmap or free the index.
+ */
+void owner_release(void)
+{
+    if(owners==NULL)
+        return;
+    if(owners->mapped)
+        munmap(owners->data, owners->size);
+    else
+        free(owners->data);
+    free(owners);
+    owners=NULL;
+}
+
+/** Print to out the packages owning the paths matched by pattern, one
+ * "package: /path" line each.
+ * A pattern with *, ? or [ is a glob, whose * does not match a slash.  A
+ * pattern ending with a slash matches everything under that directory.
+ * Otherwise the pattern is the path of a file or of a directory.
+ * \return the number of lines printed.
+ */
+int owner_query(FILE *out, const char *pattern)
+{
+    owner_index_s *o=owner_get();
+    cursor_s *c=malloc(sizeof(*c));
+    const char *q=pattern;
+    size_t qlen;
+    int glob;
+    int dir;
+    char *key;
+    size_t klen;
+    int found=0;
+    uint64_t t;
+    while(*q=='/')
+        q++;
+    qlen=strlen(q);
+    glob=strpbrk(q, "*?[")!=NULL;
+    dir=!glob && qlen>0 && q[qlen-1]=='/';
+    key=g_strndup(q, glob ? strcspn(q, "*?[") : qlen);
+    klen=strlen(key);
+    t=STATS_BEGIN();
+    cursor_seek(o, c, key);
+    while(cursor_next(o, c)){
+        int cmp=strncmp(c->path, key, klen);
+        if(cmp<0)
+            continue;
+        if(cmp>0)
+            break;
+        if(glob){
+            char *name=g_strndup(c->path, c->len>1 && c->path[c->len-1]=='/' ? c->len-1 : c->len);
+            cmp=fnmatch(q, name, FNM_PATHNAME);
+            g_free(name);
+            if(cmp)
+                continue;
+        }
+        else if(!dir && c->len!=klen && !(c->len==klen+1 && c->path[klen]=='/'))
+            continue;
+        fprintf(out, "%s: /%s\n", o->strings+o->pkgs[c->pkg].fullname, c->path);
+        found++;
+    }
+    STATS_END(STATS_LOOKUP, t);
+    g_free(key);
+    free(c);
+    return found;
+}
@@ -0,0 +1,65 @@
+/** \file
+ * Index of the files of the installed packages: which package owns a path.
+ *
+ * Every path of the file list of the records of \c SB_DB is paired with the
+ * package listing it.  The pairs are sorted on the path and front coded:
+ * each keeps the length of the prefix it shares with the path before it, the
+ * rest of the path and the package number, all three as varints.  Every
+ * \c OWNER_BLOCK pairs the shared prefix starts again from empty, so a lookup
+ * binary searches the first paths of the blocks and decodes at most one block
+ * before reaching the match.
+ *
+ * The size and mtime of every record are kept too.  When \c SB_DB changes,
+ * only the records that changed are read again, the paths of the others
+ * being decoded from the previous index.
+ */
+#ifndef BRIGHT_OWNER_H
+#define BRIGHT_OWNER_H
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define OWNER_INDEX "owners.idx"     //!< The index file in \c BS_CACHEDIR.
+#define OWNER_MAGIC "BSOWN01"        //!< Change it whenever the layout below changes.
+#define OWNER_BLOCK 16               //!< Pairs per front coded block.
+#define OWNER_PATH_MAX 4096          //!< Longer paths are left out of the index.
+
+/**Header of the index, followed by pkgs[npkgs], blocks[nblocks], the
+ * coded pairs and the string pool.
+ */
+typedef struct {
+    char magic[8];
+    int64_t db_mtime;        //!< mtime of \c SB_DB when the index was built, in nanoseconds.
+    uint32_t npkgs;
+    uint32_t npairs;
+    uint32_t nblocks;
+    uint32_t strings_size;
+    uint64_t data_size;      //!< Size of the coded pairs.
+} owner_header_s;
+
+/**An installed package, as its record was when it was read.
+ */
+typedef struct {
+    uint64_t size;
+    int64_t mtime;           //!< In nanoseconds.
+    uint32_t fullname;       //!< Offset in the string pool.
+    uint32_t pad;
+} owner_pkg_s;
+
+/**An opened index, either mapped from the cache or built in memory.
+ */
+typedef struct {
+    void *data;
+    size_t size;
+    int mapped;
+    const owner_header_s *hdr;
+    const owner_pkg_s *pkgs;
+    const uint32_t *blocks;          //!< Offset of each block in pairs.
+    const uint8_t *pairs;
+    const char *strings;
+} owner_index_s;
+
+owner_index_s *owner_get(void);
+void owner_release(void);
+int owner_query(FILE *out, const char *pattern);
+#endif /* BRIGHT_OWNER_H */
@@ -1,4 +1,7 @@
 #include "bright_parse.h"
+#include "bright_stats.h"
+#include "bright_footprint.h"
+#include <string.h>
 
 config_s *config=NULL;
 config_s *init_config(void)
@@ -17,6 +20,20 @@ int parsearg_op(int opt)
         case 'D':config->op = (config->op != OP_MAIN ? 0 : OP_DISPLAY); break;
         case 'S':config->op = (config->op != OP_MAIN ? 0 : OP_SYSTEM); break;
         case 'h':config->help = 1; break;
+        case OPT_SERVE:config->op = (config->op != OP_MAIN ? 0 : OP_SERVE); break;
+        case OPT_QUERY:
+            config->op = (config->op != OP_MAIN ? 0 : OP_QUERY);
+            config->query = optarg;
+            break;
+        case OPT_SOCKET:config->socket = optarg; break;
+        case OPT_STATS:
+            if(optarg && strcmp(optarg, "json")){
+                fprintf(stderr, "--stats=%s: only json is supported, the summary is printed instead\n", optarg);
+                config->stats = STATS_TEXT;
+            }
+            else
+                config->stats = optarg ? STATS_JSON : STATS_TEXT;
+            break;
         default: return 1;
     }
     return 0;
@@ -26,9 +43,14 @@ int parsearg_system(int opt)
 {
     switch(opt)
     {
+        case 'b':config->op_s_build = 1; break;
         case 'd':config->op_s_download = 1; break;
         case 'h':config->op_s_help = 1; break;
         case 'i':config->op_s_install = 1; break;
+        case 'j':config->jobs = atol(optarg); break;
+        case OPT_HOST_CONNECTIONS:config->host_connections = atol(optarg); break;
+        case OPT_MANIFEST:config->op_s_manifest = 1; break;
+        case OPT_BUILD_JOBS:config->build_jobs = atol(optarg); break;
         case 's':config->op_s_sync = 1; break;
         case 'u':config->op_s_uninstall = 1; break;
         default: return 1;
@@ -41,11 +63,38 @@ int parsearg_display(int opt)
     switch(opt)
     {
         case 'a':config->op_d_all_pkgname = 1; break; 
+        case 'b':config->op_d_build_order = 1; break; 
         case 'd':config->op_d_descpkg = 1; break; 
+        case 'x':config->op_d_export = 1; break; 
         case 'h':config->op_d_help = 1; break; 
         case 'r':config->op_d_readme = 1; break; 
         case 'c':config->op_d_changelog = 1; break; 
+        case 'f':config->op_d_fuzzy = 1; break; 
         case 'm':config->op_d_match_name = 1; break; 
+        case 'o':config->op_d_outdated = 1; break; 
+        case 'w':config->op_d_owner = 1; break; 
+        case OPT_PREFIX:config->search_prefix = 1; break;
+        case OPT_DESCR:config->search_descr = 1; break;
+        case OPT_TOP:config->search_top = atol(optarg); break;
+        case OPT_FOOTPRINT:
+            if(optarg==NULL || !strcmp(optarg, "package"))
+                config->footprint_by = FOOTPRINT_PACKAGE;
+            else if(!strcmp(optarg, "series"))
+                config->footprint_by = FOOTPRINT_SERIES;
+            else if(!strcmp(optarg, "repo"))
+                config->footprint_by = FOOTPRINT_REPO;
+            else{
+                printf("--footprint=%s: package, series or repo expected\n", optarg);
+                return 1;
+            }
+            config->op_d_footprint = 1;
+            break;
+        case OPT_DISK:config->footprint_disk = 1; break;
+        case OPT_VERIFY:config->op_d_verify = 1; break;
+        case OPT_HASH:config->verify_hash = 1; break;
+        case OPT_REQUIRED_BY:config->op_d_required_by = 1; break;
+        case OPT_DIRECT:config->rdeps_direct = 1; break;
+        case OPT_INSTALLED:config->rdeps_installed = 1; break;
         default: return 1;
     }
     return 0;
@@ -55,22 +104,46 @@ int parse_args(int argc, char *argv[])
 {
     int opt;
     int option_index = 0;
-    const char *optstring = ":DSacdhimrspu";
+    const char *optstring = ":DSabcdfhij:moprsuwx";
     struct option long_options[] =
     {
         {"display",no_argument, 0, 'D'},
         {"system",no_argument, 0, 'S'},
         {"all",no_argument, 0, 'a'},
+        {"build-order",no_argument, 0, 'b'},
+        {"build",no_argument, 0, 'b'},
+        {"build-jobs",required_argument, 0, OPT_BUILD_JOBS},
         {"changelog",no_argument, 0, 'c'},
         {"download",no_argument, 0, 'd'},
         {"describe",no_argument, 0, 'd'},
+        {"fuzzy",no_argument, 0, 'f'},
+        {"prefix",no_argument, 0, OPT_PREFIX},
+        {"descr",no_argument, 0, OPT_DESCR},
+        {"top",required_argument, 0, OPT_TOP},
         {"help",no_argument, 0, 'h'},
         {"install",no_argument, 0, 'i'},
+        {"jobs",required_argument, 0, 'j'},
+        {"host-connections",required_argument, 0, OPT_HOST_CONNECTIONS},
         {"match",no_argument, 0, 'm'},
+        {"outdated",no_argument, 0, 'o'},
+        {"owner",no_argument, 0, 'w'},
         {"readme",no_argument, 0, 'r'},
         {"package",no_argument, 0, 'p'},
         {"sync",no_argument, 0, 's'},
         {"uninstall",no_argument, 0, 'u'},
+        {"export",no_argument, 0, 'x'},
+        {"footprint",optional_argument, 0, OPT_FOOTPRINT},
+        {"disk",no_argument, 0, OPT_DISK},
+        {"verify",no_argument, 0, OPT_VERIFY},
+        {"hash",no_argument, 0, OPT_HASH},
+        {"manifest",no_argument, 0, OPT_MANIFEST},
+        {"required-by",no_argument, 0, OPT_REQUIRED_BY},
+        {"direct",no_argument, 0, OPT_DIRECT},
+        {"installed",no_argument, 0, OPT_INSTALLED},
+        {"serve",no_argument, 0, OPT_SERVE},
+        {"query",required_argument, 0, OPT_QUERY},
+        {"socket",required_argument, 0, OPT_SOCKET},
+        {"stats",optional_argument, 0, OPT_STATS},
         {0, 0, 0, 0}
     };
 
@@ -110,6 +183,9 @@ int parse_args(int argc, char *argv[])
             case OP_DISPLAY:
                 parsearg_display(opt);
                 break;
+            case OP_SERVE:
+            case OP_QUERY:
+                break;
             default:
                 return 1;
         }
@@ -6,23 +6,51 @@
 
 typedef struct config_s{
     unsigned int op;
+    unsigned int op_s_build;
     unsigned int op_s_download;
     unsigned int op_s_help;
     unsigned int op_s_install;
+    unsigned int op_s_manifest;
     unsigned int op_s_sync;
     unsigned int op_s_uninstall;
     unsigned int op_d_all_pkgname;
+    unsigned int op_d_build_order;
     unsigned int op_d_changelog;
     unsigned int op_d_descpkg;
+    unsigned int op_d_export;
+    unsigned int op_d_footprint;
+    unsigned int op_d_fuzzy;
     unsigned int op_d_help;
     unsigned int op_d_match_name;
+    unsigned int op_d_outdated;
+    unsigned int op_d_owner;
     unsigned int op_d_readme;
+    unsigned int op_d_required_by;
+    unsigned int op_d_verify;
     unsigned int help;
+    long jobs;                 //!< Parallel downloads, 0 for the default.
+    long host_connections;     //!< Connections per host, 0 for the default.
+    long build_jobs;           //!< SlackBuilds run at the same time, 0 for the default.
+    unsigned int search_prefix;  //!< -m matches the beginning of names only.
+    unsigned int search_descr;   //!< -m also looks in the short descriptions.
+    long search_top;             //!< Number of -f matches, 0 for the default.
+    char *socket;                //!< Socket of the daemon, NULL for the default.
+    char *query;                 //!< The query sent by --query.
+    int stats;                   //!< Format of the --stats report, STATS_OFF if none.
+    int footprint_by;            //!< What --footprint groups by, FOOTPRINT_PACKAGE by default.
+    unsigned int footprint_disk; //!< --footprint also measures the files under ROOT.
+    unsigned int verify_hash;    //!< --verify also compares the files to their manifest.
+    unsigned int rdeps_direct;   //!< --required-by stops at the direct dependents.
+    unsigned int rdeps_installed; //!< --required-by lists the installed dependents only.
 } config_s;
 
 extern config_s *config;
 
-enum{OP_MAIN=1, OP_SYSTEM, OP_DISPLAY};
+enum{OP_MAIN=1, OP_SYSTEM, OP_DISPLAY, OP_SERVE, OP_QUERY};
+enum{OPT_HOST_CONNECTIONS=256, OPT_PREFIX, OPT_DESCR, OPT_TOP,
+    OPT_SERVE, OPT_QUERY, OPT_SOCKET, OPT_STATS, OPT_FOOTPRINT, OPT_DISK,
+    OPT_VERIFY, OPT_HASH, OPT_MANIFEST, OPT_REQUIRED_BY, OPT_DIRECT, OPT_INSTALLED,
+    OPT_BUILD_JOBS}; //!< Long options without a short equivalent.
 
 
 config_s *init_config(void);
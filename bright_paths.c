@@ -0,0 +1,62 @@
+/** \file
+ * Resolve the directories of brightstar and the files they hold.
+ */
+#include "brightstar.h"
+
+static const struct {
+    const char *env;
+    const char *fallback;
+} defaults[PATH_COUNT]={
+    [PATH_SB_REPODIR]={"SB_REPODIR", SB_REPODIR_DEFAULT},
+    [PATH_SB_DB]={"SB_DB", SB_DB_DEFAULT},
+    [PATH_SK_DB]={"SK_DB", SK_DB_DEFAULT},
+    [PATH_BS_CACHEDIR]={"BS_CACHEDIR", BS_CACHEDIR_DEFAULT},
+    [PATH_BS_CONFDIR]={"BS_CONFDIR", BS_CONFDIR_DEFAULT},
+    [PATH_ROOT]={"ROOT", ROOT_DEFAULT},
+};
+
+static char *dirs[PATH_COUNT];
+static GHashTable *files[PATH_COUNT];   //!< name -> full path, per directory.
+
+/** Return directory dir, one of the PATH_ constants, always ending with a slash.
+ */
+const char *bs_path(int dir)
+{
+    const char *v;
+    if(dirs[dir])
+        return dirs[dir];
+    if((v=getenv(defaults[dir].env))==NULL || *v=='\0')
+        v=defaults[dir].fallback;
+    dirs[dir]=g_str_has_suffix(v, "/") ? g_strdup(v) : g_strconcat(v, "/", NULL);
+    return dirs[dir];
+}
+
+/** Return the full path of the file name of directory dir.  The path is
+ * built once and stays valid until paths_release().
+ * \param dir one of the PATH_ constants
+ * \param name the file name, like \c SB_TXT
+ */
+const char *bs_file(int dir, const char *name)
+{
+    char *path;
+    if(files[dir]==NULL)
+        files[dir]=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    if((path=g_hash_table_lookup(files[dir], name)))
+        return path;
+    path=g_strconcat(bs_path(dir), name, NULL);
+    g_hash_table_insert(files[dir], g_strdup(name), path);
+    return path;
+}
+
+/** Forget the directories and paths, so that the environment is read again.
+ */
+void paths_release(void)
+{
+    for(int i=0; i<PATH_COUNT; i++){
+        g_free(dirs[i]);
+        dirs[i]=NULL;
+        if(files[i])
+            g_hash_table_destroy(files[i]);
+        files[i]=NULL;
+    }
+}
@@ -0,0 +1,23 @@
+/** \file
+ * The directories brightstar reads and writes.
+ *
+ * Each directory has a compiled-in default that the environment variable of
+ * the same name replaces, e.g. SB_REPODIR=/srv/sbo/ brightstar -D -d foo.
+ * The values are read on first use and kept for the life of the process.
+ */
+#ifndef BRIGHT_PATHS_H
+#define BRIGHT_PATHS_H
+
+#define SB_REPODIR_DEFAULT "/var/lib/sbopkg/SBo/14.0/"   //!< The local directory of Slackbuild files
+#define SB_DB_DEFAULT "/var/log/packages/"               //!< The Slackware installed packages database.
+#define SK_DB_DEFAULT "/var/lib/slackpkg/"               //!< The DB folder of all slackware packages.
+#define BS_CACHEDIR_DEFAULT "/var/cache/brightstar/"     //!< Where brightstar keeps its indexes and caches.
+#define BS_CONFDIR_DEFAULT "/etc/brightstar/"            //!< Where brightstar reads its configuration.
+#define ROOT_DEFAULT "/"                                 //!< Where the files of the installed packages are, as for installpkg.
+
+enum {PATH_SB_REPODIR=0, PATH_SB_DB, PATH_SK_DB, PATH_BS_CACHEDIR, PATH_BS_CONFDIR, PATH_ROOT, PATH_COUNT};
+
+const char *bs_path(int dir);
+const char *bs_file(int dir, const char *name);
+void paths_release(void);
+#endif /* BRIGHT_PATHS_H */
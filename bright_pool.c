@@ -0,0 +1,63 @@
+/** \file
+ * A parallel loop over pthreads.  Workers take the next index from a shared
+ * counter, so slow items do not hold back a whole slice of the work.
+ */
+#include "brightstar.h"
+#include "bright_pool.h"
+#include <pthread.h>
+
+typedef struct {
+    size_t next;
+    size_t count;
+    void (*fn)(size_t i, void *arg);
+    void *arg;
+} pool_work_s;
+
+/** Return the number of worker threads to use, one per online processor.
+ */
+int pool_threads(void)
+{
+    long n=sysconf(_SC_NPROCESSORS_ONLN);
+    if(n<1)
+        n=1;
+    if(n>POOL_MAX_THREADS)
+        n=POOL_MAX_THREADS;
+    return n;
+}
+
+static void *worker(void *p)
+{
+    pool_work_s *work=p;
+    size_t i;
+    while((i=__atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED))<work->count)
+        work->fn(i, work->arg);
+    return NULL;
+}
+
+/** Call fn(i, arg) for every i in [0, count), spread over the worker threads.
+ * Return once every call is done.
+ */
+void parallel_for(size_t count, void (*fn)(size_t i, void *arg), void *arg)
+{
+    parallel_for_threads(count, pool_threads(), fn, arg);
+}
+
+/** Like parallel_for(), on n threads instead of one per processor, for
+ * work that mostly waits on the disk.  n is capped to \c POOL_MAX_THREADS.
+ */
+void parallel_for_threads(size_t count, int n, void (*fn)(size_t i, void *arg), void *arg)
+{
+    pool_work_s work={0, count, fn, arg};
+    pthread_t threads[POOL_MAX_THREADS];
+    int started=0;
+    if(n>POOL_MAX_THREADS)
+        n=POOL_MAX_THREADS;
+    if((size_t)n>count)
+        n=count;
+    for(int t=1; t<n; t++)
+        if(pthread_create(&threads[started], NULL, worker, &work)==0)
+            started++;
+    worker(&work);
+    for(int t=0; t<started; t++)
+        pthread_join(threads[t], NULL);
+}
@@ -0,0 +1,13 @@
+/** \file
+ * Run independent pieces of work on all the processors.
+ */
+#ifndef BRIGHT_POOL_H
+#define BRIGHT_POOL_H
+#include <stddef.h>
+
+#define POOL_MAX_THREADS 64 //!< Upper bound on the number of worker threads.
+
+int pool_threads(void);
+void parallel_for(size_t count, void (*fn)(size_t i, void *arg), void *arg);
+void parallel_for_threads(size_t count, int n, void (*fn)(size_t i, void *arg), void *arg);
+#endif /* BRIGHT_POOL_H */
@@ -0,0 +1,115 @@
+/** \file
+ * Read the list of repositories.
+ */
+#include "brightstar.h"
+#include "bright_repo.h"
+
+static repo_s *repos=NULL;
+static int nrepos=0;
+
+static char *optional(const char *s)
+{
+    return (s==NULL || !strcmp(s, "-")) ? NULL : g_strdup(s);
+}
+
+static void add_repo(const char *name, int priority, const char *dir, const char *sync, const char *reponet)
+{
+    repo_s *r=&repos[nrepos++];
+    r->name=g_strdup(name);
+    r->priority=priority;
+    r->dir=g_str_has_suffix(dir, "/") ? g_strdup(dir) : g_strconcat(dir, "/", NULL);
+    r->txt=g_strconcat(r->dir, SB_TXT, NULL);
+    r->sync=optional(sync);
+    r->reponet=optional(reponet);
+}
+
+/** Read \c REPOS_CONF.
+ * \return the number of repositories read, -1 if there is no such file.
+ */
+static int read_conf(void)
+{
+    FILE *fp;
+    char line[MAXLEN];
+    int n=0;
+    if((fp=fopen(bs_file(PATH_BS_CONFDIR, REPOS_CONF), "r"))==NULL)
+        return -1;
+    while(fgets(line, sizeof(line), fp)){
+        char *field[5]={};
+        char *pline;
+        char *end;
+        long priority;
+        int i;
+        line[strcspn(line, "#")]='\0';
+        for(i=0; i<5; i++)
+            if((field[i]=strtok_r(i ? NULL : line, " \t\n", &pline))==NULL)
+                break;
+        if(i==0)
+            continue;
+        priority=strtol(field[1] ? field[1] : "", &end, 10);
+        if(i<3 || *end!='\0'){
+            fprintf(stderr, "%s: ignoring \"%s\", expected name priority directory [source [download]]\n",
+                    REPOS_CONF, field[0]);
+            continue;
+        }
+        if(n==REPO_MAX){
+            fprintf(stderr, "%s: more than %d repositories, ignoring %s\n", REPOS_CONF, REPO_MAX, field[0]);
+            continue;
+        }
+        add_repo(field[0], priority, field[2], field[3], field[4]);
+        n++;
+    }
+    fclose(fp);
+    return n;
+}
+
+static void load(void)
+{
+    repos=calloc(REPO_MAX, sizeof(repo_s));
+    if(read_conf()<=0){
+        const char *url=getenv("RSYNC_URL") ? getenv("RSYNC_URL") : RSYNC_URL;
+        nrepos=0;
+        add_repo(REPO_DEFAULT, 0, SB_REPODIR, url, SB_REPONET);
+    }
+    //Decreasing priority, the order of REPOS_CONF breaking ties
+    for(int i=1; i<nrepos; i++){
+        repo_s r=repos[i];
+        int j=i;
+        for(; j>0 && repos[j-1].priority<r.priority; j--)
+            repos[j]=repos[j-1];
+        repos[j]=r;
+    }
+}
+
+/** Return the number of repositories, reading them on first use.
+ */
+int repo_count(void)
+{
+    if(repos==NULL)
+        load();
+    return nrepos;
+}
+
+/** Return repository i, 0 being the one of highest priority.
+ */
+const repo_s *repo_get(int i)
+{
+    if(repos==NULL)
+        load();
+    return &repos[i];
+}
+
+/** Forget the repositories.
+ */
+void repo_release(void)
+{
+    for(int i=0; i<nrepos; i++){
+        g_free(repos[i].name);
+        g_free(repos[i].dir);
+        g_free(repos[i].txt);
+        g_free(repos[i].sync);
+        g_free(repos[i].reponet);
+    }
+    free(repos);
+    repos=NULL;
+    nrepos=0;
+}
@@ -0,0 +1,37 @@
+/** \file
+ * The Slackbuild repositories.
+ *
+ * Repositories are listed in \c REPOS_CONF of \c BS_CONFDIR, one per line:
+ * \code
+ * # name   priority  local directory               sync source                      download location
+ * overlay  100       /var/lib/brightstar/overlay/  rsync://build.lan/overlay/       -
+ * SBo-14.0 10        /var/lib/sbopkg/SBo/14.0/     rsync://rsync.slackbuilds.org/slackbuilds/14.0/ slackbuilds.org/slackbuilds/14.0/
+ * \endcode
+ * A "-" source leaves the repository out of the sync, a "-" download location
+ * makes its Slackbuilds unavailable for download.  When a package is in
+ * several repositories the one of highest priority shadows the others.
+ * Without \c REPOS_CONF, or when it lists none, the only repository is SBo
+ * in \c SB_REPODIR, synchronized from \c RSYNC_URL.
+ */
+#ifndef BRIGHT_REPO_H
+#define BRIGHT_REPO_H
+
+#define REPOS_CONF "repos.conf"   //!< The list of repositories in \c BS_CONFDIR.
+#define REPO_DEFAULT "SBo"        //!< Name of the repository used without \c REPOS_CONF.
+#define REPO_MAX 64               //!< Most repositories read from \c REPOS_CONF.
+
+/**A repository of Slackbuilds.
+ */
+typedef struct {
+    char *name;
+    int priority;            //!< Higher shadows lower.
+    char *dir;               //!< Local tree, ending with a slash.
+    char *txt;               //!< SLACKBUILDS.TXT in dir.
+    char *sync;              //!< rsync source, NULL if the repository is not synchronized.
+    char *reponet;           //!< Remote location of the Slackbuild tarballs, NULL if none.
+} repo_s;
+
+int repo_count(void);
+const repo_s *repo_get(int i);
+void repo_release(void);
+#endif /* BRIGHT_REPO_H */
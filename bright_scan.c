@@ -0,0 +1,195 @@
+/** \file
+ * Line and key scanning of the text metadata.
+ */
+#include "brightstar.h"
+#include "bright_installed.h"
+#include "bright_scan.h"
+#include <pthread.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/** Find the newline ending the line at p and the first colon before it.
+ * \param colon receive the colon, left alone if already set
+ * \return the newline, or eof.
+ */
+typedef const char *(*find_f)(const char *p, const char *eof, const char **colon);
+
+static const char *find_scalar(const char *p, const char *eof, const char **colon)
+{
+    for(; p<eof; p++){
+        if(*p=='\n')
+            return p;
+        if(*p==':' && *colon==NULL)
+            *colon=p;
+    }
+    return eof;
+}
+
+#ifdef SCAN_X86
+static const char *find_sse2(const char *p, const char *eof, const char **colon)
+{
+    const __m128i nl=_mm_set1_epi8('\n');
+    const __m128i co=_mm_set1_epi8(':');
+    for(; eof-p>=16; p+=16){
+        __m128i v=_mm_loadu_si128((const __m128i *)p);
+        unsigned n=_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        if(*colon==NULL){
+            unsigned c=_mm_movemask_epi8(_mm_cmpeq_epi8(v, co));
+            if(c && (n==0 || __builtin_ctz(c)<__builtin_ctz(n)))
+                *colon=p+__builtin_ctz(c);
+        }
+        if(n)
+            return p+__builtin_ctz(n);
+    }
+    return find_scalar(p, eof, colon);
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *p, const char *eof, const char **colon)
+{
+    const __m256i nl=_mm256_set1_epi8('\n');
+    const __m256i co=_mm256_set1_epi8(':');
+    for(; eof-p>=32; p+=32){
+        __m256i v=_mm256_loadu_si256((const __m256i *)p);
+        unsigned n=_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+        if(*colon==NULL){
+            unsigned c=_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, co));
+            if(c && (n==0 || __builtin_ctz(c)<__builtin_ctz(n)))
+                *colon=p+__builtin_ctz(c);
+        }
+        if(n)
+            return p+__builtin_ctz(n);
+    }
+    return find_sse2(p, eof, colon);
+}
+
+static int has_sse2(void)
+{
+    return 1;
+}
+
+static int has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+static int has_scalar(void)
+{
+    return 1;
+}
+
+/**The variants, best first.
+ */
+static const struct {
+    const char *name;
+    find_f find;
+    int (*supported)(void);
+} impls[]={
+#ifdef SCAN_X86
+    {"avx2", find_avx2, has_avx2},
+    {"sse2", find_sse2, has_sse2},
+#endif
+    {"scalar", find_scalar, has_scalar},
+};
+#define NIMPLS (int)(sizeof(impls)/sizeof(impls[0]))
+
+static int impl=-1;
+static pthread_once_t impl_once=PTHREAD_ONCE_INIT;
+
+static void select_best(void)
+{
+    if(impl<0)
+        scan_select(NULL);
+}
+
+/** Choose the variant used by scan_line().
+ * \param name "avx2", "sse2" or "scalar", NULL for the best one the processor supports
+ * \return 0 on success, -1 if the variant is unknown or not supported.
+ */
+int scan_select(const char *name)
+{
+    for(int i=0; i<NIMPLS; i++)
+        if((name==NULL || !strcmp(name, impls[i].name)) && impls[i].supported()){
+            impl=i;
+            return 0;
+        }
+    return -1;
+}
+
+/** Return the name of the variant used by scan_line().
+ */
+const char *scan_impl(void)
+{
+    pthread_once(&impl_once, select_best);
+    return impls[impl].name;
+}
+
+/**The keys, at the slot given by SCAN_SLOT.  The multiplier and the
+ * character were searched for the slots of the keys to be all different.
+ */
+#define SCAN_SLOT(key, len) (((len)+3*(unsigned char)(key)[11])&63)
+#define SCAN_KEY_MIN 12          //!< Length of the shortest key, PKG_NAME.
+static const struct {
+    const char *key;
+    size_t len;
+    int id;
+} slots[64]={
+#define KEY(slot, s, id) [slot]={s, sizeof(s)-1, id}
+    KEY(57, VAR_NAME, SCAN_SB_NAME),
+    KEY(55, VAR_LOCATION, SCAN_SB_LOCATION),
+    KEY(34, VAR_FILES, SCAN_SB_FILES),
+    KEY(20, VAR_VERSION, SCAN_SB_VERSION),
+    KEY(31, VAR_DOWNLOAD, SCAN_SB_DOWNLOAD),
+    KEY(38, VAR_DOWNLOAD64, SCAN_SB_DOWNLOAD64),
+    KEY(56, VAR_MD5SUM, SCAN_SB_MD5SUM),
+    KEY(63, VAR_MD5SUM64, SCAN_SB_MD5SUM64),
+    KEY(21, VAR_SHORTDESCR, SCAN_SB_SHORTDESCR),
+    KEY(27, PKG_NAME, SCAN_PKG_NAME),
+    KEY(19, PKG_LOCATION, SCAN_PKG_LOCATION),
+    KEY(40, PKG_SIZEC, SCAN_PKG_SIZEC),
+    KEY(42, PKG_SIZEU, SCAN_PKG_SIZEU),
+    KEY(28, PKG_DESCRIPTION, SCAN_PKG_DESCRIPTION),
+    KEY(7, INSTALLED_SIZEC, SCAN_INST_SIZEC),
+    KEY(37, INSTALLED_SIZEU, SCAN_INST_SIZEU),
+#undef KEY
+};
+
+/** Return the SCAN_* number of the len bytes at key, SCAN_NONE if it is not
+ * a known key.
+ */
+int scan_key(const char *key, size_t len)
+{
+    unsigned slot;
+    if(len<SCAN_KEY_MIN)
+        return SCAN_NONE;
+    slot=SCAN_SLOT(key, len);
+    if(slots[slot].len!=len || memcmp(slots[slot].key, key, len))
+        return SCAN_NONE;
+    return slots[slot].id;
+}
+
+/** Split the line starting at p.
+ * \param eof the end of the buffer
+ * \param l receive the line
+ * \return the start of the next line, eof after the last one.
+ */
+const char *scan_line(const char *p, const char *eof, scan_line_s *l)
+{
+    pthread_once(&impl_once, select_best);
+    l->line=p;
+    l->colon=NULL;
+    l->end=impls[impl].find(p, eof, &l->colon);
+    l->key=SCAN_NONE;
+    if(l->colon==NULL){
+        l->value=l->end;
+        return l->end<eof ? l->end+1 : eof;
+    }
+    l->key=scan_key(p, l->colon-p);
+    for(l->value=l->colon+1; l->value<l->end && (*l->value==' ' || *l->value=='\t'); l->value++)
+        ;
+    return l->end<eof ? l->end+1 : eof;
+}
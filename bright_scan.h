@@ -0,0 +1,37 @@
+/** \file
+ * Vectorised splitting of the "KEY: value" lines of the text metadata.
+ *
+ * scan_line() finds the end of a line and its first colon in one pass over
+ * the bytes, 32 or 16 at a time with AVX2 or SSE2.  The variant is chosen at
+ * the first call from what the processor supports, the scalar one being used
+ * elsewhere.  The key before the colon is then mapped to its SCAN_* number by
+ * a perfect hash of the keys of SLACKBUILDS.TXT, PACKAGES.TXT and the records
+ * of \c SB_DB, so a line costs a single memcmp however many keys the parser
+ * knows.
+ */
+#ifndef BRIGHT_SCAN_H
+#define BRIGHT_SCAN_H
+#include <stddef.h>
+
+/**The known keys.  SCAN_NONE for any other text, or a line without a colon.
+ */
+enum {SCAN_NONE=0, SCAN_SB_NAME, SCAN_SB_LOCATION, SCAN_SB_FILES, SCAN_SB_VERSION,
+    SCAN_SB_DOWNLOAD, SCAN_SB_DOWNLOAD64, SCAN_SB_MD5SUM, SCAN_SB_MD5SUM64, SCAN_SB_SHORTDESCR,
+    SCAN_PKG_NAME, SCAN_PKG_LOCATION, SCAN_PKG_SIZEC, SCAN_PKG_SIZEU, SCAN_PKG_DESCRIPTION,
+    SCAN_INST_SIZEC, SCAN_INST_SIZEU, SCAN_KEYS};
+
+/**One line split by scan_line().
+ */
+typedef struct {
+    const char *line;        //!< First byte of the line.
+    const char *end;         //!< The '\n' ending the line, or the end of the buffer.
+    const char *colon;       //!< The first ':' of the line, NULL if there is none.
+    const char *value;       //!< After the colon, blanks skipped, or end if there is no colon.
+    int key;                 //!< SCAN_* of the text before the colon.
+} scan_line_s;
+
+const char *scan_line(const char *p, const char *eof, scan_line_s *l);
+int scan_key(const char *key, size_t len);
+int scan_select(const char *impl);
+const char *scan_impl(void);
+#endif /* BRIGHT_SCAN_H */
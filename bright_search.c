@@ -0,0 +1,367 @@
+/** \file
+ * Build the trigram index and answer substring, prefix and fuzzy searches.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_search.h"
+#include <sys/mman.h>
+
+static trigram_index_s *trigram=NULL;
+
+#define TRIGRAM(a, b, c) (((uint32_t)(unsigned char)(a)<<16)|((uint32_t)(unsigned char)(b)<<8)|(unsigned char)(c))
+
+/** A package/trigram pair, used while building a table.
+ */
+typedef struct {
+    uint32_t trigram;
+    uint32_t package;
+} trigram_pair_s;
+
+static int pair_cmp(const void *a, const void *b)
+{
+    const trigram_pair_s *pa=a;
+    const trigram_pair_s *pb=b;
+    if(pa->trigram!=pb->trigram)
+        return pa->trigram<pb->trigram ? -1 : 1;
+    return pa->package<pb->package ? -1 : pa->package>pb->package;
+}
+
+/** Add the trigrams of the case-folded s to pairs.
+ */
+static void add_trigrams(GArray *pairs, const char *s, uint32_t package, int pad)
+{
+    char *low=g_ascii_strdown(s, -1);
+    char *t=pad ? g_strconcat("^", low, "$", NULL) : low;
+    size_t len=strlen(t);
+    for(size_t i=0; i+2<len; i++){
+        trigram_pair_s pair={TRIGRAM(t[i], t[i+1], t[i+2]), package};
+        g_array_append_val(pairs, pair);
+    }
+    if(pad)
+        g_free(t);
+    g_free(low);
+}
+
+/** Turn the pairs of one table into its trigram and posting arrays, appended to image.
+ */
+static void lay_table(GArray *pairs, GByteArray *image, uint32_t *ntrigrams, uint32_t *npostings)
+{
+    trigram_pair_s *p=(trigram_pair_s *)pairs->data;
+    GArray *tris=g_array_new(FALSE, FALSE, sizeof(trigram_s));
+    GArray *posts=g_array_new(FALSE, FALSE, sizeof(uint32_t));
+    qsort(p, pairs->len, sizeof(*p), pair_cmp);
+    for(guint i=0; i<pairs->len; i++){
+        if(i>0 && p[i].trigram==p[i-1].trigram && p[i].package==p[i-1].package)
+            continue;
+        if(i==0 || p[i].trigram!=p[i-1].trigram){
+            trigram_s t={p[i].trigram, posts->len};
+            g_array_append_val(tris, t);
+        }
+        g_array_append_val(posts, p[i].package);
+    }
+    *ntrigrams=tris->len;
+    *npostings=posts->len;
+    trigram_s sentinel={UINT32_MAX, posts->len};
+    g_array_append_val(tris, sentinel);
+    g_byte_array_append(image, (guint8 *)tris->data, tris->len*sizeof(trigram_s));
+    g_byte_array_append(image, (guint8 *)posts->data, posts->len*sizeof(uint32_t));
+    g_array_free(tris, TRUE);
+    g_array_free(posts, TRUE);
+}
+
+static void *build_image(sb_index_s *idx, size_t *size)
+{
+    GArray *pairs[TRIGRAM_TABLES];
+    GByteArray *image=g_byte_array_new();
+    trigram_header_s hdr={};
+    for(int t=0; t<TRIGRAM_TABLES; t++)
+        pairs[t]=g_array_new(FALSE, FALSE, sizeof(trigram_pair_s));
+    for(uint32_t i=0; i<idx->hdr->count; i++){
+        add_trigrams(pairs[TRIGRAM_NAME], sb_index_str(idx, idx->entries[i].name), i, 1);
+        add_trigrams(pairs[TRIGRAM_DESCR], sb_index_str(idx, idx->entries[i].shortdescr), i, 0);
+    }
+    g_byte_array_append(image, (guint8 *)&hdr, sizeof(hdr));
+    for(int t=0; t<TRIGRAM_TABLES; t++){
+        lay_table(pairs[t], image, &hdr.ntrigrams[t], &hdr.npostings[t]);
+        g_array_free(pairs[t], TRUE);
+    }
+    memcpy(hdr.magic, TRIGRAM_MAGIC, sizeof(hdr.magic));
+    hdr.stamp=idx->hdr->stamp;
+    hdr.count=idx->hdr->count;
+    memcpy(image->data, &hdr, sizeof(hdr));
+    *size=image->len;
+    return g_byte_array_free(image, FALSE);
+}
+
+/** Point the index members to their place in the image and check the image
+ * was built from the current SLACKBUILDS.TXT index.
+ * \return 0 if the image can be used, -1 otherwise.
+ */
+static int attach_image(trigram_index_s *ti, sb_index_s *idx)
+{
+    const trigram_header_s *hdr=ti->data;
+    const char *p;
+    size_t expected=sizeof(*hdr);
+    if(ti->size<sizeof(*hdr) || memcmp(hdr->magic, TRIGRAM_MAGIC, sizeof(hdr->magic)))
+        return -1;
+    if(hdr->stamp!=idx->hdr->stamp || hdr->count!=idx->hdr->count)
+        return -1;
+    for(int t=0; t<TRIGRAM_TABLES; t++)
+        expected+=(hdr->ntrigrams[t]+1)*sizeof(trigram_s)+hdr->npostings[t]*sizeof(uint32_t);
+    if(ti->size!=expected)
+        return -1;
+    ti->hdr=hdr;
+    p=(const char *)(hdr+1);
+    for(int t=0; t<TRIGRAM_TABLES; t++){
+        ti->trigrams[t]=(const trigram_s *)p;
+        p+=(hdr->ntrigrams[t]+1)*sizeof(trigram_s);
+        ti->postings[t]=(const uint32_t *)p;
+        p+=hdr->npostings[t]*sizeof(uint32_t);
+    }
+    return 0;
+}
+
+/** Return the trigram index, loading or rebuilding it on first use.
+ */
+trigram_index_s *trigram_get(void)
+{
+    sb_index_s *idx=sb_index_get();
+    uint64_t t;
+    if(trigram)
+        return trigram;
+    t=STATS_BEGIN();
+    trigram=calloc(1, sizeof(*trigram));
+    if((trigram->data=map_file(CACHE_PATH(TRIGRAM_CACHE), &trigram->size))){
+        trigram->mapped=1;
+        if(attach_image(trigram, idx)==0){
+            STATS_END(STATS_INDEX, t);
+            return trigram;
+        }
+        munmap(trigram->data, trigram->size);
+        trigram->mapped=0;
+    }
+    trigram->data=build_image(idx, &trigram->size);
+    write_file_atomic(CACHE_PATH(TRIGRAM_CACHE), trigram->data, trigram->size); //Best effort, may not be root
+    attach_image(trigram, idx);
+    STATS_END(STATS_INDEX, t);
+    return trigram;
+}
+
+/** Unmap or free the trigram index.
+ */
+void trigram_release(void)
+{
+    if(trigram==NULL)
+        return;
+    if(trigram->mapped)
+        munmap(trigram->data, trigram->size);
+    else
+        g_free(trigram->data);
+    free(trigram);
+    trigram=NULL;
+}
+
+/** Find the postings of a trigram in a table.
+ * \return the number of packages, *list pointing to them.
+ */
+static uint32_t postings_of(trigram_index_s *ti, int table, uint32_t tri, const uint32_t **list)
+{
+    const trigram_s *t=ti->trigrams[table];
+    size_t lo=0;
+    size_t hi=ti->hdr->ntrigrams[table];
+    while(lo<hi){
+        size_t mid=lo+(hi-lo)/2;
+        if(t[mid].trigram==tri){
+            *list=ti->postings[table]+t[mid].offset;
+            return t[mid+1].offset-t[mid].offset;
+        }
+        if(t[mid].trigram<tri)
+            lo=mid+1;
+        else
+            hi=mid;
+    }
+    *list=NULL;
+    return 0;
+}
+
+/** Levenshtein distance between a and b, ignoring case.
+ */
+int edit_distance(const char *a, const char *b)
+{
+    size_t la=strlen(a);
+    size_t lb=strlen(b);
+    int row[lb+1];
+    for(size_t j=0; j<=lb; j++)
+        row[j]=j;
+    for(size_t i=1; i<=la; i++){
+        int diag=row[0];
+        row[0]=i;
+        for(size_t j=1; j<=lb; j++){
+            int up=row[j];
+            int cost=tolower((unsigned char)a[i-1])!=tolower((unsigned char)b[j-1]);
+            int best=diag+cost;
+            if(up+1<best)
+                best=up+1;
+            if(row[j-1]+1<best)
+                best=row[j-1]+1;
+            row[j]=best;
+            diag=up;
+        }
+    }
+    return row[lb];
+}
+
+/** Mark in hit the packages of table whose text contains the query, ignoring
+ * case.  Only the packages having every trigram of the query are checked.
+ * \return the number of packages newly marked.
+ */
+static int substring_in(trigram_index_s *ti, sb_index_s *idx, int table, const char *query, uint8_t *hit)
+{
+    char *low=g_ascii_strdown(query, -1);
+    size_t len=strlen(low);
+    int n=0;
+    uint32_t count=idx->hdr->count;
+    uint16_t *seen=NULL;
+    int ntri=0;
+    if(len>=3){
+        //Count for each package how many distinct query trigrams it has
+        seen=calloc(count, sizeof(uint16_t));
+        GHashTable *done=g_hash_table_new(g_direct_hash, g_direct_equal);
+        for(size_t i=0; i+2<len; i++){
+            uint32_t tri=TRIGRAM(low[i], low[i+1], low[i+2]);
+            const uint32_t *list;
+            uint32_t nl;
+            if(g_hash_table_contains(done, GUINT_TO_POINTER(tri+1)))
+                continue;
+            g_hash_table_add(done, GUINT_TO_POINTER(tri+1));
+            ntri++;
+            nl=postings_of(ti, table, tri, &list);
+            for(uint32_t k=0; k<nl; k++)
+                seen[list[k]]++;
+        }
+        g_hash_table_destroy(done);
+    }
+    for(uint32_t i=0; i<count; i++){
+        const sb_index_entry_s *e=&idx->entries[i];
+        if(hit[i] || (seen && seen[i]<ntri))
+            continue;
+        if(strcasestr(sb_index_str(idx, table==TRIGRAM_NAME ? e->name : e->shortdescr), low)){
+            hit[i]=1;
+            n++;
+        }
+    }
+    free(seen);
+    g_free(low);
+    return n;
+}
+
+typedef struct {
+    uint32_t package;
+    int shared;      //!< Trigrams shared with the query.
+    int distance;    //!< Edit distance to the query.
+} fuzzy_s;
+
+static int shared_cmp(const void *a, const void *b)
+{
+    const fuzzy_s *fa=a;
+    const fuzzy_s *fb=b;
+    return fb->shared-fa->shared;
+}
+
+static int distance_cmp(const void *a, const void *b)
+{
+    const fuzzy_s *fa=a;
+    const fuzzy_s *fb=b;
+    if(fa->distance!=fb->distance)
+        return fa->distance-fb->distance;
+    if(fa->shared!=fb->shared)
+        return fb->shared-fa->shared;
+    return fa->package<fb->package ? -1 : 1;
+}
+
+#define FUZZY_CANDIDATES 256 //!< Packages sharing the most trigrams that are ranked by edit distance.
+
+/** Rank the packages by edit distance to query, using the shared trigrams
+ * to pick the candidates.
+ */
+static int fuzzy(trigram_index_s *ti, sb_index_s *idx, const char *query, int top, uint32_t *found)
+{
+    uint32_t count=idx->hdr->count;
+    char *low=g_ascii_strdown(query, -1);
+    char *padded=g_strconcat("^", low, "$", NULL);
+    size_t len=strlen(padded);
+    fuzzy_s *cand=calloc(count, sizeof(fuzzy_s));
+    int ncand=0;
+    int limit;
+    int n;
+    for(uint32_t i=0; i<count; i++)
+        cand[i].package=i;
+    for(size_t i=0; i+2<len; i++){
+        const uint32_t *list;
+        uint32_t nl=postings_of(ti, TRIGRAM_NAME, TRIGRAM(padded[i], padded[i+1], padded[i+2]), &list);
+        for(uint32_t k=0; k<nl; k++)
+            cand[list[k]].shared++;
+    }
+    qsort(cand, count, sizeof(*cand), shared_cmp);
+    //Without any shared trigram every package is a candidate.
+    limit=(count>0 && cand[0].shared>0) ? FUZZY_CANDIDATES : (int)count;
+    while(ncand<(int)count && ncand<limit && (cand[ncand].shared>0 || cand[0].shared==0))
+        ncand++;
+    for(int i=0; i<ncand; i++)
+        cand[i].distance=edit_distance(low, sb_index_str(idx, idx->entries[cand[i].package].name));
+    qsort(cand, ncand, sizeof(*cand), distance_cmp);
+    n=ncand<top ? ncand : top;
+    for(int i=0; i<n; i++)
+        found[i]=cand[i].package;
+    free(cand);
+    g_free(padded);
+    g_free(low);
+    return n;
+}
+
+/** Search the packages matching query.
+ * \param query what to look for, case is ignored
+ * \param mode SEARCH_SUBSTRING, SEARCH_PREFIX or SEARCH_FUZZY
+ * \param with_descr also look in the short descriptions, for SEARCH_SUBSTRING
+ * \param top the number of matches kept, for SEARCH_FUZZY
+ * \param found receive the malloc'ed list of packages, index positions
+ * \return the number of packages in found, in index order except for
+ * SEARCH_FUZZY where the best match comes first.
+ */
+int search_packages(const char *query, int mode, int with_descr, int top, uint32_t **found)
+{
+    sb_index_s *idx=sb_index_get();
+    uint32_t count=idx->hdr->count;
+    int n=0;
+    *found=malloc((count ? count : 1)*sizeof(uint32_t));
+    if(mode==SEARCH_PREFIX){
+        //Keys are sorted, the matches are a contiguous range.
+        char *low=g_ascii_strdown(query, -1);
+        size_t len=strlen(low);
+        size_t lo=0;
+        size_t hi=count;
+        while(lo<hi){
+            size_t mid=lo+(hi-lo)/2;
+            if(strcmp(sb_index_str(idx, idx->entries[mid].key), low)<0)
+                lo=mid+1;
+            else
+                hi=mid;
+        }
+        while(lo<count && !strncmp(sb_index_str(idx, idx->entries[lo].key), low, len))
+            (*found)[n++]=lo++;
+        g_free(low);
+    }
+    else if(mode==SEARCH_FUZZY)
+        n=fuzzy(trigram_get(), idx, query, top, *found);
+    else{
+        uint8_t *hit=calloc(count ? count : 1, 1);
+        substring_in(trigram_get(), idx, TRIGRAM_NAME, query, hit);
+        if(with_descr)
+            substring_in(trigram_get(), idx, TRIGRAM_DESCR, query, hit);
+        for(uint32_t i=0; i<count; i++)
+            if(hit[i])
+                (*found)[n++]=i;
+        free(hit);
+    }
+    return n;
+}
@@ -0,0 +1,57 @@
+/** \file
+ * Trigram index over the package names and short descriptions.
+ *
+ * For every trigram of the case-folded names, and separately of the
+ * short descriptions, the index keeps the sorted list of the packages
+ * containing it.  Names are indexed with a leading '^' and a trailing '$'
+ * so that short names and word edges still produce trigrams.  Packages
+ * are designated by their position in the SLACKBUILDS.TXT index.
+ */
+#ifndef BRIGHT_SEARCH_H
+#define BRIGHT_SEARCH_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRIGRAM_CACHE "trigram.idx"  //!< The cache file of the trigram index.
+#define TRIGRAM_MAGIC "BSTRI02"      //!< Change it whenever the layout below changes.
+#define SEARCH_TOP 10                //!< Default number of fuzzy matches displayed.
+
+enum {TRIGRAM_NAME=0, TRIGRAM_DESCR=1, TRIGRAM_TABLES=2};
+
+/**Header of the image, followed for each table by trigrams[ntrigrams+1] and
+ * postings[npostings].  The last trigram of a table is a sentinel whose
+ * offset is npostings.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t stamp;          //!< Stamp of the SLACKBUILDS.TXT index it was built from.
+    uint32_t count;          //!< Number of packages.
+    uint32_t ntrigrams[TRIGRAM_TABLES];
+    uint32_t npostings[TRIGRAM_TABLES];
+} trigram_header_s;
+
+/**A trigram and where its postings start.
+ */
+typedef struct {
+    uint32_t trigram;
+    uint32_t offset;
+} trigram_s;
+
+typedef struct {
+    void *data;
+    size_t size;
+    int mapped;
+    const trigram_header_s *hdr;
+    const trigram_s *trigrams[TRIGRAM_TABLES];
+    const uint32_t *postings[TRIGRAM_TABLES];
+} trigram_index_s;
+
+/**Kind of search.
+ */
+enum {SEARCH_SUBSTRING=0, SEARCH_PREFIX, SEARCH_FUZZY};
+
+trigram_index_s *trigram_get(void);
+void trigram_release(void);
+int search_packages(const char *query, int mode, int with_descr, int top, uint32_t **found);
+int edit_distance(const char *a, const char *b);
+#endif /* BRIGHT_SEARCH_H */
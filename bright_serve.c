@@ -0,0 +1,448 @@
+/** \file
+ * Run the query daemon and send it queries.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_deps.h"
+#include "bright_search.h"
+#include "bright_serve.h"
+#include "bright_version.h"
+#include "bright_catalog.h"
+#include "bright_owner.h"
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <grp.h>
+
+/**A connected client, the part of its query read so far and the part of
+ * the replies not sent yet.
+ */
+typedef struct {
+    int fd;
+    GString *in;
+    GString *out;
+} client_s;
+
+static volatile sig_atomic_t stopping=0;
+static struct stat st_db, st_list, st_packages;
+static int sb_loaded=0;         //!< The index of the repositories is loaded.
+static int slack_loaded=0;      //!< The index of the Slackware catalog is loaded.
+static char error[MAXLEN];      //!< The error message of the last query, when it needs one.
+
+static void on_signal(int sig)
+{
+    stopping=1;
+}
+
+static int changed(const char *path, struct stat *old)
+{
+    struct stat st={};
+    int ret;
+    stat(path, &st);
+    ret=st.st_size!=old->st_size || st.st_mtim.tv_sec!=old->st_mtim.tv_sec
+        || st.st_mtim.tv_nsec!=old->st_mtim.tv_nsec;
+    *old=st;
+    return ret;
+}
+
+/** Reload whatever data changed on disk since it was loaded.  Nothing
+ * here exits: data that cannot be read, e.g. during a resync, is loaded
+ * again on the next query.  The Slackware catalog is optional.
+ * \param force reload everything
+ * \return NULL on success, an error message if the repositories cannot be read.
+ */
+static const char *reload(int force)
+{
+    if(changed(SB_DB, &st_db) || force){
+        installed_release();
+        installed_table();
+        owner_release(); //Built again on the next owner query, reading only the records that changed
+    }
+    if(changed(SK_LIST_PATH, &st_list) | changed(SK_PACKAGES, &st_packages) || force || !slack_loaded){
+        slack_index_release();
+        slack_loaded=slack_index_try_get()!=NULL;
+    }
+    if(!sb_loaded || sb_index_stale() || force){
+        trigram_release();
+        deps_release();
+        sb_index_release();
+        if((sb_loaded=sb_index_try_get()!=NULL)==0)
+            return "no SLACKBUILDS.TXT, try again once the repositories are synchronized";
+        trigram_get();
+        deps_get();
+    }
+    return NULL;
+}
+
+/** Print to out the names of the packages at the given index positions.
+ */
+static void print_nodes(FILE *out, const uint32_t *nodes, int n)
+{
+    sb_index_s *idx=sb_index_get();
+    for(int i=0; i<n; i++)
+        fprintf(out, "%s\n", sb_index_str(idx, idx->entries[nodes[i]].name));
+}
+
+/** Run one query and print its result lines to out.
+ * \return NULL on success, an error message otherwise.
+ */
+static const char *run_query(FILE *out, char *line)
+{
+    char *arg;
+    char *cmd=strtok_r(line, " \t\r", &arg);
+    const char *err;
+    sb_index_s *idx;
+    if(cmd==NULL)
+        return "empty query";
+    g_strstrip(arg);
+    if(!strcmp(cmd, "ping")){
+        fprintf(out, "pong\n");
+        return NULL;
+    }
+    if((err=reload(0)))
+        return err;
+    idx=sb_index_get();
+    if(!strcmp(cmd, "installed")){
+        GHashTableIter iter;
+        gpointer key, value;
+        if(arg[0]!='\0'){
+            const installed_s *inst=installed_lookup(arg);
+            if(inst==NULL)
+                return "not installed";
+            fprintf(out, "%s %s %s %s %s\n", inst->name, inst->version, inst->arch, inst->build, inst->tag);
+            return NULL;
+        }
+        g_hash_table_iter_init(&iter, installed_table());
+        while(g_hash_table_iter_next(&iter, &key, &value))
+            fprintf(out, "%s\n", ((installed_s *)value)->fullname);
+        return NULL;
+    }
+    if(!strcmp(cmd, "outdated")){
+        outdated_report(out);
+        return NULL;
+    }
+    if(arg[0]=='\0')
+        return "missing argument";
+    if(!strcmp(cmd, "owner")){
+        if(owner_query(out, arg)==0)
+            return "not owned";
+        return NULL;
+    }
+    if(!strcmp(cmd, "describe")){
+        char *name;
+        char *pname;
+        arena_s *a=arena_new();
+        for(name=strtok_r(arg, " \t", &pname); name; name=strtok_r(NULL, " \t", &pname))
+            if(describe_one(out, a, name, slack_loaded ? describe_slack(a, name) : NULL)<0){
+                snprintf(error, sizeof(error), "cannot read the Slackbuild files of %s", name);
+                arena_free(a);
+                return error;
+            }
+        arena_free(a);
+        return NULL;
+    }
+    if(!strcmp(cmd, "match") || !strcmp(cmd, "fuzzy")){
+        uint32_t *found;
+        int n=search_packages(arg, cmd[0]=='m' ? SEARCH_SUBSTRING : SEARCH_FUZZY, 0, SEARCH_TOP, &found);
+        print_nodes(out, found, n);
+        free(found);
+        return NULL;
+    }
+    if(!strcmp(cmd, "requires")){
+        deps_graph_s *g=deps_get();
+        const sb_index_entry_s *e=sb_index_lookup(idx, arg);
+        uint32_t node;
+        if(e==NULL)
+            return "no such package";
+        node=e-idx->entries;
+        for(uint32_t k=g->offsets[node]; k<g->offsets[node+1]; k++){
+            const char *dep=sb_index_str(idx, idx->entries[g->edges[k]].name);
+            fprintf(out, "%s %s\n", dep, installed_lookup(dep) ? "installed" : "not-installed");
+        }
+        return NULL;
+    }
+    if(!strcmp(cmd, "requiredby") || !strcmp(cmd, "rebuild")){
+        const sb_index_entry_s *e=sb_index_lookup(idx, arg);
+        uint32_t node;
+        uint32_t *found;
+        int n;
+        if(e==NULL)
+            return "no such package";
+        node=e-idx->entries;
+        n=deps_dependents(deps_get(), &node, 1, !strcmp(cmd, "requiredby") ? DEPS_DIRECT : 0, &found);
+        for(int i=0; i<n; i++){
+            const char *dep=sb_index_str(idx, idx->entries[found[i]].name);
+            fprintf(out, "%s %s\n", dep, installed_lookup(dep) ? "installed" : "not-installed");
+        }
+        free(found);
+        return NULL;
+    }
+    if(!strcmp(cmd, "order")){
+        GArray *roots=g_array_new(FALSE, FALSE, sizeof(uint32_t));
+        char *name;
+        char *pname;
+        uint32_t *order;
+        int n;
+        for(name=strtok_r(arg, " \t", &pname); name; name=strtok_r(NULL, " \t", &pname)){
+            const sb_index_entry_s *e=sb_index_lookup(idx, name);
+            uint32_t node;
+            if(e==NULL){
+                g_array_free(roots, TRUE);
+                return "no such package";
+            }
+            node=e-idx->entries;
+            g_array_append_val(roots, node);
+        }
+        n=deps_order(deps_get(), (uint32_t *)roots->data, roots->len, 1, &order);
+        g_array_free(roots, TRUE);
+        if(n<0)
+            return "dependency cycle";
+        print_nodes(out, order, n);
+        free(order);
+        return NULL;
+    }
+    return "unknown command";
+}
+
+/** Write all of buf to fd, waiting when the socket is full.  Only for the
+ * client, the daemon never waits on a socket.
+ */
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while(len>0){
+        ssize_t n=send(fd, buf, len, MSG_NOSIGNAL);
+        if(n<0 && (errno==EAGAIN || errno==EINTR)){
+            struct pollfd p={fd, POLLOUT, 0};
+            poll(&p, 1, 1000);
+            continue;
+        }
+        if(n<=0)
+            return -1;
+        buf+=n;
+        len-=n;
+    }
+    return 0;
+}
+
+/** Answer one query line, queuing the reply for the client.
+ */
+static void answer(client_s *c, char *line)
+{
+    char *body=NULL;
+    size_t len=0;
+    FILE *out=open_memstream(&body, &len);
+    const char *err=run_query(out, line);
+    GString *reply=c->out;
+    char *p;
+    char *pl;
+    fclose(out);
+    if(err)
+        g_string_append_printf(reply, "ERR %s\n", err);
+    else{
+        g_string_append(reply, "OK\n");
+        for(p=body; p<body+len; p=pl+1){
+            if((pl=memchr(p, '\n', body+len-p))==NULL)
+                pl=body+len;
+            if(p[0]=='.')
+                g_string_append_c(reply, '.');
+            g_string_append_len(reply, p, pl-p);
+            g_string_append_c(reply, '\n');
+        }
+    }
+    g_string_append(reply, ".\n");
+    free(body);
+}
+
+/** Send what the socket of c takes of its pending replies, without waiting.
+ * \return 0 on success, -1 if the client is gone.
+ */
+static int flush_client(client_s *c)
+{
+    while(c->out->len>0){
+        ssize_t n=send(c->fd, c->out->str, c->out->len, MSG_NOSIGNAL|MSG_DONTWAIT);
+        if(n<0 && (errno==EAGAIN || errno==EWOULDBLOCK))
+            return 0;
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<=0)
+            return -1;
+        g_string_erase(c->out, 0, n);
+    }
+    return 0;
+}
+
+/** Read what c sent, answer its complete queries and send the replies.
+ * The queries of a client are left unread while it has more than
+ * \c SERVE_MAX_PENDING bytes of replies not taken, so a slow reader only
+ * slows itself down.
+ * \param revents the events poll() returned for c
+ * \return 0 on success, -1 to drop the client.
+ */
+static int serve_client(client_s *c, short revents)
+{
+    char *nl;
+    if(revents & POLLIN){
+        char buf[4096];
+        ssize_t n=read(c->fd, buf, sizeof(buf));
+        if(n==0 || (n<0 && errno!=EAGAIN && errno!=EINTR))
+            return -1;
+        if(n>0)
+            g_string_append_len(c->in, buf, n);
+    }
+    else if(revents & (POLLERR|POLLHUP|POLLNVAL))
+        return -1;
+    if(c->in->len>SERVE_MAX_LINE && memchr(c->in->str, '\n', c->in->len)==NULL)
+        return -1;
+    while(c->out->len<=SERVE_MAX_PENDING && (nl=memchr(c->in->str, '\n', c->in->len))){
+        size_t len=nl-c->in->str;
+        char *line=g_strndup(c->in->str, len);
+        g_string_erase(c->in, 0, len+1);
+        answer(c, line);
+        g_free(line);
+    }
+    return flush_client(c);
+}
+
+/** Open the listening socket, replacing a stale socket file.  The socket
+ * is only open to its owner and to the group named by \c SERVE_GROUP_ENV,
+ * or to the group of the daemon if unset.
+ */
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr={.sun_family=AF_UNIX};
+    const char *group=getenv(SERVE_GROUP_ENV);
+    struct group *gr=NULL;
+    mode_t mask;
+    int ret;
+    int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd<0 || strlen(path)>=sizeof(addr.sun_path)){
+        fprintf(stderr, "Cannot create socket %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))==0){
+        fprintf(stderr, "A daemon already listens on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    if(group && (gr=getgrnam(group))==NULL){
+        fprintf(stderr, "No group %s for %s\n", group, path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    mask=umask(0777 & ~SERVE_SOCKET_MODE); //No window where the socket is open to everybody
+    ret=bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if(ret<0 || listen(fd, SERVE_MAX_CLIENTS)<0
+            || (gr && chown(path, -1, gr->gr_gid)<0) || chmod(path, SERVE_SOCKET_MODE)<0){
+        fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/** Load every index and answer queries on the socket at path until SIGINT or SIGTERM.
+ * \return 0 on a clean stop, 1 if the socket cannot be opened.
+ */
+int serve(const char *path)
+{
+    struct pollfd fds[SERVE_MAX_CLIENTS+1];
+    client_s clients[SERVE_MAX_CLIENTS];
+    int nclients=0;
+    int lfd=listen_on(path);
+    struct sigaction sa={.sa_handler=on_signal};
+    if(lfd<0)
+        return 1;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    if(reload(1))
+        fprintf(stderr, "No SLACKBUILDS.TXT yet, the queries fail until the repositories are synchronized\n");
+    printf("Serving on %s\n", path);
+    fflush(stdout);
+    while(!stopping){
+        fds[0]=(struct pollfd){lfd, POLLIN, 0};
+        for(int i=0; i<nclients; i++)
+            fds[i+1]=(struct pollfd){clients[i].fd,
+                (clients[i].out->len<=SERVE_MAX_PENDING ? POLLIN : 0)|(clients[i].out->len ? POLLOUT : 0), 0};
+        if(poll(fds, nclients+1, -1)<0)
+            continue;
+        for(int i=nclients-1; i>=0; i--){
+            if(fds[i+1].revents==0 || serve_client(&clients[i], fds[i+1].revents)==0)
+                continue;
+            close(clients[i].fd);
+            g_string_free(clients[i].in, TRUE);
+            g_string_free(clients[i].out, TRUE);
+            clients[i]=clients[--nclients];
+        }
+        if(fds[0].revents & POLLIN){
+            int cfd;
+            while((cfd=accept(lfd, NULL, NULL))>=0){
+                if(nclients==SERVE_MAX_CLIENTS){
+                    close(cfd);
+                    continue;
+                }
+                fcntl(cfd, F_SETFL, O_NONBLOCK);
+                clients[nclients].fd=cfd;
+                clients[nclients].in=g_string_new(NULL);
+                clients[nclients++].out=g_string_new(NULL);
+            }
+        }
+    }
+    for(int i=0; i<nclients; i++){
+        close(clients[i].fd);
+        g_string_free(clients[i].in, TRUE);
+        g_string_free(clients[i].out, TRUE);
+    }
+    close(lfd);
+    unlink(path);
+    return 0;
+}
+
+/** Send command to the daemon listening at path and print the result lines.
+ * \return 0 if the daemon answered OK, 1 otherwise.
+ */
+int query(const char *path, const char *command)
+{
+    struct sockaddr_un addr={.sun_family=AF_UNIX};
+    int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+    char *request;
+    FILE *in;
+    char line[MAXLEN];
+    int first=1;
+    int ret=1;
+    if(fd<0 || strlen(path)>=sizeof(addr.sun_path))
+        return 1;
+    strcpy(addr.sun_path, path);
+    if(connect(fd, (struct sockaddr *)&addr, sizeof(addr))<0){
+        fprintf(stderr, "Cannot connect to %s: %s\n", path, strerror(errno));
+        close(fd);
+        return 1;
+    }
+    request=g_strconcat(command, "\n", NULL);
+    send_all(fd, request, strlen(request));
+    g_free(request);
+    in=fdopen(fd, "r");
+    while(fgets(line, sizeof(line), in)){
+        if(!strcmp(line, ".\n"))
+            break;
+        if(first){
+            first=0;
+            if(!strcmp(line, "OK\n"))
+                ret=0;
+            else
+                fprintf(stderr, "%s", line);
+            continue;
+        }
+        fputs(line[0]=='.' ? line+1 : line, stdout);
+    }
+    fclose(in);
+    return ret;
+}
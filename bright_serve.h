@@ -0,0 +1,33 @@
+/** \file
+ * Resident query daemon and its client.
+ *
+ * The daemon keeps the indexes and the installed packages table loaded
+ * and answers queries on a Unix socket.  A query is one line,
+ * "command arguments".  The answer starts with a line "OK" or
+ * "ERR message", goes on with the result lines and ends with a line
+ * holding a single dot.  Result lines starting with a dot get a second
+ * dot prepended, as in SMTP.
+ *
+ * Commands: ping, describe NAME..., installed [NAME], match STRING,
+ * fuzzy STRING, requires NAME, requiredby NAME, rebuild NAME, order NAME...,
+ * outdated, owner PATH
+ *
+ * A file that cannot be read, e.g. during a resync, fails the query with an
+ * ERR line and the daemon goes on.  Replies are sent without ever waiting
+ * on a client.  The socket is only open to the owner and the group of the
+ * daemon, or the group given by \c SERVE_GROUP_ENV, since every query
+ * makes the daemon read files on behalf of the client.
+ */
+#ifndef BRIGHT_SERVE_H
+#define BRIGHT_SERVE_H
+
+#define BS_SOCKET "/var/run/brightstar.sock"  //!< Default socket of the daemon.
+#define SERVE_MAX_CLIENTS 64                  //!< Clients connected at the same time.
+#define SERVE_MAX_LINE 4096                   //!< Longest query accepted.
+#define SERVE_MAX_PENDING 65536               //!< Bytes of replies not taken by a client before its queries are left unread.
+#define SERVE_SOCKET_MODE 0660                //!< Mode of the socket.
+#define SERVE_GROUP_ENV "BS_SOCKET_GROUP"     //!< Environment variable naming the group allowed to query.
+
+int serve(const char *path);
+int query(const char *path, const char *command);
+#endif /* BRIGHT_SERVE_H */
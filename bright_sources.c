@@ -0,0 +1,215 @@
+/** \file
+ * Store, find and evict the cached source files.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_download.h"
+#include "bright_sources.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+/**A source of the cache, while the cache is evicted.
+ */
+typedef struct {
+    char *name;
+    uint64_t size;
+    int64_t mtime;
+} source_s;
+
+/** Return the size of the cache, in bytes.
+ */
+uint64_t sources_max(void)
+{
+    const char *v=getenv(SOURCES_MAX_ENV);
+    char *unit;
+    double max;
+    if(v==NULL || *v=='\0')
+        return SOURCES_MAX_DEFAULT;
+    max=strtod(v, &unit);
+    switch(*unit){
+        case 'G': case 'g': max*=1024;
+        /* fall through */
+        case 'M': case 'm': max*=1024;
+        /* fall through */
+        case 'K': case 'k': max*=1024;
+        /* fall through */
+        default: break;
+    }
+    return max>0 ? (uint64_t)max : 0;
+}
+
+/** Return the path of the source of checksum md5, or of its sha256sum with
+ * suffix, NULL if md5 is not a md5sum.  To be freed by the caller.
+ */
+static char *source_path(const char *md5, const char *suffix)
+{
+    char *path;
+    if(md5==NULL || strlen(md5)!=2*MD5_DIGEST_LENGTH || strspn(md5, "0123456789abcdefABCDEF")!=2*MD5_DIGEST_LENGTH)
+        return NULL;
+    path=g_strconcat(CACHE_PATH(SOURCES_DIR), md5, suffix, NULL);
+    for(char *p=path+strlen(path)-strlen(suffix)-2*MD5_DIGEST_LENGTH; *p; p++)
+        *p=tolower(*p);
+    return path;
+}
+
+/** Make dest a copy of src: a hard link, else a reflink, else a plain copy.
+ * An existing dest is replaced.
+ * \return 0 on success, -1 on failure.
+ */
+static int place(const char *src, const char *dest)
+{
+    char *tmp=g_strconcat(dest, DL_PART, NULL);
+    char buf[65536];
+    ssize_t n=0;
+    int in, out;
+    unlink(tmp);
+    if(link(src, tmp)==0)
+        goto done;
+    if((in=open(src, O_RDONLY))<0){
+        g_free(tmp);
+        return -1;
+    }
+    if((out=open(tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644))<0){
+        close(in);
+        g_free(tmp);
+        return -1;
+    }
+    if(ioctl(out, FICLONE, in)<0)
+        while((n=read(in, buf, sizeof(buf)))>0)
+            if(write(out, buf, n)!=n){
+                n=-1;
+                break;
+            }
+    close(in);
+    if(close(out)<0 || n<0){
+        unlink(tmp);
+        g_free(tmp);
+        return -1;
+    }
+done:
+    n=rename(tmp, dest);
+    g_free(tmp);
+    return n<0 ? -1 : 0;
+}
+
+/** Link the source of checksum md5 at dest, if it is in the cache.
+ * \param sha256 the sha256sum the source must also have, NULL if none
+ * \return 0 if dest holds the source, -1 if it must be downloaded.
+ */
+int sources_fetch(const char *md5, const char *sha256, const char *dest)
+{
+    char *path=source_path(md5, "");
+    char *sidecar=source_path(md5, SOURCES_SHA256);
+    char *known=NULL;
+    int ret=-1;
+    if(path==NULL || sources_max()==0 || access(path, R_OK)<0)
+        goto done;
+    if(sha256 && *sha256 && (!g_file_get_contents(sidecar, &known, NULL, NULL)
+                || strncasecmp(g_strstrip(known), sha256, 2*SHA256_DIGEST_LENGTH+1)))
+        goto done;
+    if(place(path, dest)==0){
+        utimensat(AT_FDCWD, path, NULL, 0);//Most recently used
+        ret=0;
+    }
+done:
+    g_free(known);
+    g_free(path);
+    g_free(sidecar);
+    return ret;
+}
+
+/** Keep the file at path, downloaded and checked, in the cache.  When the
+ * cache already has the same content, path is made a link to it instead.
+ * A cached source of the same md5sum but of another sha256sum is another
+ * content: path is then left as it is, and the cache untouched.
+ * \return 0 on success, -1 if the file cannot be cached.
+ */
+int sources_add(const char *path, const char *md5, const char *sha256)
+{
+    char *object=source_path(md5, "");
+    char *sidecar=source_path(md5, SOURCES_SHA256);
+    char *known=NULL;
+    int cached;
+    int ret=-1;
+    if(object==NULL || sources_max()==0)
+        goto done;
+    mkdir(BS_CACHEDIR, 0755);
+    mkdir(CACHE_PATH(SOURCES_DIR), 0755);
+    chmod(path, 0444);
+    cached=access(object, R_OK)==0;
+    if(cached && sha256 && *sha256){
+        if(!g_file_get_contents(sidecar, &known, NULL, NULL))
+            cached=0;//Nothing tells its sha256sum, so the one just checked replaces it
+        else if(strncasecmp(g_strstrip(known), sha256, 2*SHA256_DIGEST_LENGTH+1))
+            goto done;
+    }
+    if(cached)
+        ret=place(object, path);
+    else if((ret=place(path, object))==0)
+        chmod(object, 0444);
+    if(ret==0){
+        utimensat(AT_FDCWD, object, NULL, 0);
+        if(sha256 && *sha256)
+            write_file_atomic(sidecar, sha256, strlen(sha256));
+    }
+done:
+    g_free(known);
+    g_free(object);
+    g_free(sidecar);
+    return ret;
+}
+
+static int compare_mtime(const void *a, const void *b)
+{
+    const source_s *x=a;
+    const source_s *y=b;
+    return x->mtime<y->mtime ? -1 : x->mtime>y->mtime;
+}
+
+/** Remove the least recently used sources until the cache holds no more
+ * than max bytes.  A source still linked from elsewhere, e.g. the directory
+ * of a Slackbuild, would not free its space once removed: it is neither
+ * counted nor removed.
+ */
+void sources_evict(uint64_t max)
+{
+    const char *dir=CACHE_PATH(SOURCES_DIR);
+    GArray *sources=g_array_new(FALSE, FALSE, sizeof(source_s));
+    uint64_t total=0;
+    DIR *d;
+    struct dirent *e;
+    if((d=opendir(dir))==NULL){
+        g_array_free(sources, TRUE);
+        return;
+    }
+    STATS_COUNT(STATS_OPENDIR, 1);
+    while((e=readdir(d))){
+        source_s s;
+        struct stat st;
+        if(strlen(e->d_name)!=2*MD5_DIGEST_LENGTH || fstatat(dirfd(d), e->d_name, &st, 0)<0
+                || !S_ISREG(st.st_mode) || st.st_nlink>1)
+            continue;
+        s.name=g_strdup(e->d_name);
+        s.size=st.st_size;
+        s.mtime=stamp_mtime(&st);
+        total+=s.size;
+        g_array_append_val(sources, s);
+    }
+    closedir(d);
+    g_array_sort(sources, compare_mtime);
+    for(guint i=0; i<sources->len; i++){
+        source_s *s=&g_array_index(sources, source_s, i);
+        if(total>max){
+            char *path=g_strconcat(dir, s->name, NULL);
+            char *sidecar=g_strconcat(path, SOURCES_SHA256, NULL);
+            if(unlink(path)==0)
+                total-=s->size;
+            unlink(sidecar);
+            g_free(path);
+            g_free(sidecar);
+        }
+        g_free(s->name);
+    }
+    g_array_free(sources, TRUE);
+}
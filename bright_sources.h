@@ -0,0 +1,32 @@
+/** \file
+ * Cache of the source files downloaded, addressed by their content.
+ *
+ * A source is kept in \c SOURCES_DIR of \c BS_CACHEDIR under its md5sum, the
+ * one checksum every .info file gives, and its sha256sum is kept beside it
+ * in a file with the \c SOURCES_SHA256 suffix.  Two packages downloading the
+ * same tarball, whatever its name, share one copy, and a package whose .info
+ * gives a sha256sum only gets a source whose sha256sum matches too.  Sources
+ * are hard linked into the directory they are wanted in, reflinked or copied
+ * when it is on another file system, and are stored read-only so a link
+ * cannot be changed behind the cache.
+ *
+ * Each use sets the mtime of a source, and the least recently used ones are
+ * evicted once the cache grows over the size given by \c SOURCES_MAX_ENV,
+ * \c SOURCES_MAX_DEFAULT if unset, with a K, M or G suffix.  The sources
+ * still hard linked from elsewhere are left out of that size, as removing
+ * them would free nothing.
+ */
+#ifndef BRIGHT_SOURCES_H
+#define BRIGHT_SOURCES_H
+#include <stdint.h>
+
+#define SOURCES_DIR "sources/"                  //!< The cache directory in \c BS_CACHEDIR.
+#define SOURCES_SHA256 ".sha256"                //!< Suffix of the file holding the sha256sum of a source.
+#define SOURCES_MAX_ENV "BS_SOURCES_MAX"        //!< Environment variable giving the size of the cache, 0 for no cache.
+#define SOURCES_MAX_DEFAULT (4ULL<<30)          //!< Size of the cache without \c SOURCES_MAX_ENV.
+
+uint64_t sources_max(void);
+int sources_fetch(const char *md5, const char *sha256, const char *dest);
+int sources_add(const char *path, const char *md5, const char *sha256);
+void sources_evict(uint64_t max);
+#endif /* BRIGHT_SOURCES_H */
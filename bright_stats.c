@@ -0,0 +1,146 @@
+/** \file
+ * Record and print the counters and timings of --stats.
+ */
+#include "brightstar.h"
+#include "bright_stats.h"
+#include <pthread.h>
+#include <time.h>
+
+int stats_on=0;
+
+static uint64_t phase_ns[STATS_PHASES];
+static uint64_t phase_calls[STATS_PHASES];
+static uint64_t counters[STATS_COUNTERS];
+static GHashTable *files=NULL;        //!< path -> bytes read, in a uint64_t.
+static GPtrArray *order=NULL;         //!< The paths in the order they were first read.
+static pthread_mutex_t files_lock=PTHREAD_MUTEX_INITIALIZER;
+
+static const char *phase_names[STATS_PHASES]={"index", "lookup", "info", "installed",
+    "requires", "output", "download", "hash"};
+static const char *counter_names[STATS_COUNTERS]={"fopen", "opendir", "mmap", "allocations",
+    "allocated_bytes", "arena_blocks", "downloaded_bytes"};
+
+/** Start recording.
+ */
+void stats_enable(void)
+{
+    stats_on=1;
+}
+
+/** Return the monotonic clock in nanoseconds.
+ */
+uint64_t stats_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+/** Add the time elapsed since start, a value of stats_clock(), to phase.
+ */
+void stats_time(int phase, uint64_t start)
+{
+    __atomic_fetch_add(&phase_ns[phase], stats_clock()-start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&phase_calls[phase], 1, __ATOMIC_RELAXED);
+}
+
+void stats_count(int counter, uint64_t n)
+{
+    __atomic_fetch_add(&counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/** Add bytes to the bytes read from path.
+ */
+void stats_file(const char *path, uint64_t bytes)
+{
+    uint64_t *total;
+    pthread_mutex_lock(&files_lock);
+    if(files==NULL){
+        files=g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free);
+        order=g_ptr_array_new_with_free_func(g_free);
+    }
+    if((total=g_hash_table_lookup(files, path))==NULL){
+        char *key=g_strdup(path);
+        total=calloc(1, sizeof(*total));
+        g_ptr_array_add(order, key);
+        g_hash_table_insert(files, key, total);
+    }
+    *total+=bytes;
+    pthread_mutex_unlock(&files_lock);
+}
+
+/** Print a JSON string, escaping what must be.
+ */
+static void print_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for(; *s; s++){
+        if(*s=='"' || *s=='\\')
+            fprintf(out, "\\%c", *s);
+        else if((unsigned char)*s<0x20)
+            fprintf(out, "\\u%04x", *s);
+        else
+            fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void print_json(FILE *out)
+{
+    fprintf(out, "{\"phases\":{");
+    for(int i=0; i<STATS_PHASES; i++)
+        fprintf(out, "%s\"%s\":{\"calls\":%llu,\"ms\":%.3f}", i ? "," : "", phase_names[i],
+                (unsigned long long)phase_calls[i], phase_ns[i]/1e6);
+    fprintf(out, "},\"files\":{");
+    for(guint i=0; order && i<order->len; i++){
+        fprintf(out, "%s", i ? "," : "");
+        print_json_string(out, order->pdata[i]);
+        fprintf(out, ":%llu", (unsigned long long)*(uint64_t *)g_hash_table_lookup(files, order->pdata[i]));
+    }
+    fprintf(out, "}");
+    for(int i=0; i<STATS_COUNTERS; i++)
+        fprintf(out, ",\"%s\":%llu", counter_names[i], (unsigned long long)counters[i]);
+    fprintf(out, "}\n");
+}
+
+static void print_text(FILE *out)
+{
+    uint64_t bytes=0;
+    fprintf(out, "%-12s %10s %12s\n", "phase", "calls", "ms");
+    for(int i=0; i<STATS_PHASES; i++)
+        if(phase_calls[i])
+            fprintf(out, "%-12s %10llu %12.3f\n", phase_names[i],
+                    (unsigned long long)phase_calls[i], phase_ns[i]/1e6);
+    fprintf(out, "%12s  %s\n", "bytes read", "file");
+    for(guint i=0; order && i<order->len; i++){
+        uint64_t n=*(uint64_t *)g_hash_table_lookup(files, order->pdata[i]);
+        fprintf(out, "%12llu  %s\n", (unsigned long long)n, (char *)order->pdata[i]);
+        bytes+=n;
+    }
+    fprintf(out, "%12llu  %s\n", (unsigned long long)bytes, "total");
+    for(int i=0; i<STATS_COUNTERS; i++)
+        fprintf(out, "%-17s %llu\n", counter_names[i], (unsigned long long)counters[i]);
+}
+
+/** Print what was recorded to out, as a table or as one JSON object.
+ * \param format \c STATS_TEXT or \c STATS_JSON, nothing is printed for \c STATS_OFF
+ */
+void stats_print(FILE *out, int format)
+{
+    if(format==STATS_JSON)
+        print_json(out);
+    else if(format==STATS_TEXT)
+        print_text(out);
+}
+
+/** Forget the files read.
+ */
+void stats_release(void)
+{
+    if(files==NULL)
+        return;
+    g_hash_table_destroy(files);
+    g_ptr_array_free(order, TRUE);
+    files=NULL;
+    order=NULL;
+}
@@ -0,0 +1,36 @@
+/** \file
+ * Counters and timings of a run, printed by --stats.
+ *
+ * Each phase of a query accumulates its monotonic time and number of calls,
+ * and the files read are listed with the bytes read from them.  Phases may
+ * nest, the first lookup including the load of the index for instance.  A
+ * mapped file counts for its whole size.
+ * Nothing is recorded unless stats_enable() was called, the macros below
+ * then cost a test of \c stats_on.
+ */
+#ifndef BRIGHT_STATS_H
+#define BRIGHT_STATS_H
+#include <stdint.h>
+#include <stdio.h>
+
+enum {STATS_INDEX=0, STATS_LOOKUP, STATS_INFO, STATS_INSTALLED, STATS_REQUIRES,
+    STATS_OUTPUT, STATS_DOWNLOAD, STATS_HASH, STATS_PHASES}; //!< The timed phases.
+enum {STATS_FOPEN=0, STATS_OPENDIR, STATS_MMAP, STATS_ALLOCS, STATS_ALLOC_BYTES,
+    STATS_BLOCKS, STATS_DOWNLOADED, STATS_COUNTERS};         //!< The counters.
+enum {STATS_OFF=0, STATS_TEXT, STATS_JSON};                  //!< Formats of the report.
+
+extern int stats_on;
+
+#define STATS_BEGIN() (stats_on ? stats_clock() : 0)                        //!< Start timing, the value goes to STATS_END.
+#define STATS_END(phase, t) do{ if(stats_on) stats_time(phase, t); }while(0)
+#define STATS_COUNT(c, n) do{ if(stats_on) stats_count(c, n); }while(0)
+#define STATS_FILE(path, n) do{ if(stats_on) stats_file(path, n); }while(0)   //!< n bytes were read from path.
+
+void stats_enable(void);
+uint64_t stats_clock(void);
+void stats_time(int phase, uint64_t start);
+void stats_count(int counter, uint64_t n);
+void stats_file(const char *path, uint64_t bytes);
+void stats_print(FILE *out, int format);
+void stats_release(void);
+#endif /* BRIGHT_STATS_H */
@@ -0,0 +1,337 @@
+/** \file
+ * Verify the files of the installed packages and record their manifests.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_pool.h"
+#include "bright_verify.h"
+#include <fcntl.h>
+
+enum {FILE_OK=0, FILE_MISSING, FILE_TYPE, FILE_CHANGED, FILE_UNREADABLE, FILE_STATES};
+static const char *file_states[FILE_STATES]={"ok", "missing", "wrong type", "changed", "unreadable"};
+
+enum {MANIFEST_NONE=0, MANIFEST_STALE, MANIFEST_OK};
+
+/**An installed package being verified.
+ */
+typedef struct {
+    const installed_s *inst;
+    uint64_t size;           //!< Of the record.
+    int64_t mtime;           //!< Of the record, in nanoseconds.
+    char *record;            //!< The record read, its file list cut into the paths.
+    GPtrArray *paths;
+    char *manifest;          //!< The manifest read, its lines cut into sums and paths.
+    GHashTable *sums;        //!< path -> recorded sum, NULL unless the manifest is MANIFEST_OK.
+    int manifest_state;
+    uint32_t first;          //!< Number of its first path in the list checked.
+    uint32_t counts[FILE_STATES];
+} vf_pkg_s;
+
+/**A path of a file list and what was found there.
+ */
+typedef struct {
+    const char *path;        //!< Relative to \c ROOT, ending with a slash for a directory.
+    uint32_t pkg;
+    uint8_t state;
+    uint8_t hashed;          //!< digest holds the sum of the file.
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+} vf_file_s;
+
+/**What the workers share.
+ */
+typedef struct {
+    vf_pkg_s *pkgs;
+    vf_file_s *files;
+    const char *db;
+    const char *manifests;
+    int rootfd;
+    int mode;
+} vf_job_s;
+
+/** Cut the lines of the manifest of pkg into its table of sums, if the
+ * manifest was made from the record as it is now.
+ */
+static void read_manifest(vf_job_s *job, vf_pkg_s *pkg)
+{
+    char *path=g_strconcat(job->manifests, pkg->inst->fullname, NULL);
+    char magic[8];
+    unsigned long long size;
+    long long mtime;
+    gsize len;
+    char *p;
+    char *eof;
+    if(!g_file_get_contents(path, &pkg->manifest, &len, NULL)){
+        g_free(path);
+        return;
+    }
+    g_free(path);
+    pkg->manifest_state=MANIFEST_STALE;
+    if(sscanf(pkg->manifest, "# %7s %llu %lld", magic, &size, &mtime)!=3 || strcmp(magic, VERIFY_MAGIC)
+            || size!=pkg->size || mtime!=pkg->mtime)
+        return;
+    pkg->manifest_state=MANIFEST_OK;
+    pkg->sums=g_hash_table_new(g_str_hash, g_str_equal);
+    eof=pkg->manifest+len;
+    for(p=pkg->manifest; p<eof; ){
+        char *nl=memchr(p, '\n', eof-p);
+        if(nl==NULL)
+            nl=eof;
+        *nl='\0';
+        //sha256sum format, the sum and two blanks before the path
+        if(nl-p>2*SHA256_DIGEST_LENGTH+2 && p[2*SHA256_DIGEST_LENGTH]==' '){
+            p[2*SHA256_DIGEST_LENGTH]='\0';
+            g_hash_table_insert(pkg->sums, p+2*SHA256_DIGEST_LENGTH+2, p);
+        }
+        p=nl+1;
+    }
+}
+
+/** Read the record of a package and cut its file list into paths, the
+ * directories of the package tree and its install/ scripts left out.
+ */
+static void read_pkg(size_t i, void *arg)
+{
+    vf_job_s *job=arg;
+    vf_pkg_s *pkg=&job->pkgs[i];
+    char *path=g_strconcat(job->db, pkg->inst->fullname, NULL);
+    struct stat st;
+    size_t size;
+    char *p;
+    char *eof;
+    if(stat(path, &st)==0){
+        pkg->size=st.st_size;
+        pkg->mtime=stamp_mtime(&st);
+    }
+    g_free(path);
+    if(job->mode==VERIFY_HASH)
+        read_manifest(job, pkg);
+    if((pkg->record=installed_read_record(pkg->inst->fullname, &size))==NULL)
+        return;
+    eof=pkg->record+size;
+    if((p=(char *)installed_file_list(pkg->record, size))==NULL)
+        return;
+    while(p<eof){
+        char *nl=memchr(p, '\n', eof-p);
+        if(nl==NULL)
+            nl=eof;
+        *nl='\0';
+        if(nl>p && nl[-1]=='\r')
+            nl[-1]='\0';
+        if(*p && strcmp(p, "./") && strncmp(p, "install/", 8))
+            g_ptr_array_add(pkg->paths, p);
+        p=nl+1;
+    }
+}
+
+/** Compute the SHA-256 of the file path of the directory fd.
+ * \return 0 on success, -1 if the file cannot be read.
+ */
+static int hash_file(int dirfd, const char *path, unsigned char digest[SHA256_DIGEST_LENGTH])
+{
+    SHA256_CTX ctx;
+    char *buf;
+    ssize_t n;
+    int fd=openat(dirfd, path, O_RDONLY|O_NOFOLLOW|O_CLOEXEC);
+    if(fd<0)
+        return -1;
+    STATS_COUNT(STATS_FOPEN, 1);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    buf=malloc(VERIFY_BUFSIZE);
+    SHA256_Init(&ctx);
+    while((n=read(fd, buf, VERIFY_BUFSIZE))!=0){
+        if(n<0 && errno==EINTR)
+            continue;
+        if(n<0)
+            break;
+        SHA256_Update(&ctx, buf, n);
+    }
+    SHA256_Final(digest, &ctx);
+    free(buf);
+    close(fd);
+    return n<0 ? -1 : 0;
+}
+
+/** Check one path: its type and, with a manifest, its content.  In
+ * VERIFY_RECORD mode every regular file is hashed instead.
+ */
+static void check_file(size_t i, void *arg)
+{
+    vf_job_s *job=arg;
+    vf_file_s *f=&job->files[i];
+    const vf_pkg_s *pkg=&job->pkgs[f->pkg];
+    const char *sum=NULL;
+    char hex[2*SHA256_DIGEST_LENGTH+1];
+    struct stat st;
+    if(f->path[strlen(f->path)-1]=='/'){
+        //Without its slash, or a file there is not found at all
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%.*s", (int)strlen(f->path)-1, f->path);
+        //followed, a directory may be reached through a link like lib64 -> usr/lib64
+        if(fstatat(job->rootfd, dir, &st, 0)<0)
+            f->state=FILE_MISSING;
+        else if(!S_ISDIR(st.st_mode))
+            f->state=FILE_TYPE;
+        return;
+    }
+    if(fstatat(job->rootfd, f->path, &st, AT_SYMLINK_NOFOLLOW)<0){
+        f->state=FILE_MISSING;
+        return;
+    }
+    if(S_ISDIR(st.st_mode)){
+        f->state=FILE_TYPE;
+        return;
+    }
+    if(job->mode==VERIFY_HASH && (pkg->sums==NULL || (sum=g_hash_table_lookup(pkg->sums, f->path))==NULL))
+        return;
+    if(job->mode==VERIFY_TYPES)
+        return;
+    if(!S_ISREG(st.st_mode)){
+        if(sum)
+            f->state=FILE_CHANGED;
+        return;
+    }
+    if(hash_file(job->rootfd, f->path, f->digest)<0){
+        f->state=FILE_UNREADABLE;
+        return;
+    }
+    f->hashed=1;
+    if(sum){
+        to_hex(hex, f->digest, SHA256_DIGEST_LENGTH);
+        if(strcasecmp(hex, sum))
+            f->state=FILE_CHANGED;
+    }
+}
+
+/** Write the manifest of pkg from the sums of its files.
+ * \return 0 on success, -1 on failure.
+ */
+static int write_manifest(vf_job_s *job, vf_pkg_s *pkg)
+{
+    GString *s=g_string_new(NULL);
+    char *path=g_strconcat(job->manifests, pkg->inst->fullname, NULL);
+    char hex[2*SHA256_DIGEST_LENGTH+1];
+    int ret;
+    g_string_append_printf(s, "# %s %llu %lld\n", VERIFY_MAGIC, (unsigned long long)pkg->size, (long long)pkg->mtime);
+    for(guint j=0; j<pkg->paths->len; j++){
+        const vf_file_s *f=&job->files[pkg->first+j];
+        if(!f->hashed)
+            continue;
+        to_hex(hex, f->digest, SHA256_DIGEST_LENGTH);
+        g_string_append_printf(s, "%s  %s\n", hex, f->path);
+    }
+    ret=write_file_atomic(path, s->str, s->len);
+    g_free(path);
+    g_string_free(s, TRUE);
+    return ret;
+}
+
+static int compare_pkgs(const void *a, const void *b)
+{
+    return strcmp(((const vf_pkg_s *)a)->inst->fullname, ((const vf_pkg_s *)b)->inst->fullname);
+}
+
+/** Check the files of the packages of names, or of every installed package
+ * when count is 0, and print the paths that are missing or have changed as
+ * "fullname: state /path", followed by a summary.
+ * \param mode VERIFY_TYPES to check that the paths exist with the type of
+ *        the record, VERIFY_HASH to also compare the files to their manifest,
+ *        VERIFY_RECORD to write the manifests instead
+ * \return 0 if every file is as recorded, 1 otherwise.
+ */
+int verify_packages(FILE *out, char *names[], int count, int mode)
+{
+    GHashTable *table=installed_table();
+    vf_job_s job={.mode=mode};
+    uint32_t totals[FILE_STATES]={0};
+    size_t npkgs=0;
+    size_t nfiles=0;
+    int ret=0;
+    uint64_t t;
+    job.pkgs=calloc((count ? count : g_hash_table_size(table))+1, sizeof(vf_pkg_s));
+    if(count==0){
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, table);
+        while(g_hash_table_iter_next(&iter, NULL, &value))
+            job.pkgs[npkgs++].inst=value;
+    }
+    for(int i=0; i<count; i++)
+        if((job.pkgs[npkgs].inst=installed_lookup(names[i])))
+            npkgs++;
+        else{
+            fprintf(stderr, "%s is not installed\n", names[i]);
+            ret=1;
+        }
+    qsort(job.pkgs, npkgs, sizeof(vf_pkg_s), compare_pkgs);
+    if((job.rootfd=open(bs_path(PATH_ROOT), O_RDONLY|O_DIRECTORY|O_CLOEXEC))<0){
+        fprintf(stderr, "Cannot open %s: %s\n", bs_path(PATH_ROOT), strerror(errno));
+        free(job.pkgs);
+        return 1;
+    }
+    job.db=SB_DB;//resolved before the workers start
+    job.manifests=CACHE_PATH(VERIFY_MANIFESTS);
+    for(size_t i=0; i<npkgs; i++)
+        job.pkgs[i].paths=g_ptr_array_new();
+
+    t=STATS_BEGIN();
+    parallel_for(npkgs, read_pkg, &job);
+    STATS_END(STATS_INSTALLED, t);
+    for(size_t i=0; i<npkgs; i++){
+        job.pkgs[i].first=nfiles;
+        nfiles+=job.pkgs[i].paths->len;
+    }
+    job.files=calloc(nfiles+1, sizeof(vf_file_s));
+    for(size_t i=0; i<npkgs; i++)
+        for(guint j=0; j<job.pkgs[i].paths->len; j++){
+            job.files[job.pkgs[i].first+j].path=job.pkgs[i].paths->pdata[j];
+            job.files[job.pkgs[i].first+j].pkg=i;
+        }
+    t=STATS_BEGIN();
+    parallel_for_threads(nfiles, pool_threads()*VERIFY_IO_FACTOR, check_file, &job);
+    STATS_END(STATS_HASH, t);
+
+    t=STATS_BEGIN();
+    for(size_t i=0; i<npkgs; i++){
+        vf_pkg_s *pkg=&job.pkgs[i];
+        const char *name=pkg->inst->fullname;
+        if(pkg->record==NULL){
+            fprintf(out, "%s: cannot read the record\n", name);
+            ret=1;
+        }
+        else if(mode==VERIFY_HASH && pkg->manifest_state==MANIFEST_NONE)
+            fprintf(out, "%s: no manifest, contents not checked\n", name);
+        else if(mode==VERIFY_HASH && pkg->manifest_state==MANIFEST_STALE)
+            fprintf(out, "%s: manifest older than the record, contents not checked\n", name);
+        for(guint j=0; j<pkg->paths->len; j++){
+            const vf_file_s *f=&job.files[pkg->first+j];
+            pkg->counts[f->state]++;
+            totals[f->state]++;
+            if(f->state!=FILE_OK)
+                fprintf(out, "%s: %s /%s\n", name, file_states[f->state], f->path);
+        }
+        if(mode==VERIFY_RECORD && pkg->record){
+            if(write_manifest(&job, pkg)<0){
+                fprintf(stderr, "Cannot write the manifest of %s: %s\n", name, strerror(errno));
+                ret=1;
+            }
+        }
+        g_ptr_array_free(pkg->paths, TRUE);
+        if(pkg->sums)
+            g_hash_table_destroy(pkg->sums);
+        g_free(pkg->manifest);
+        free(pkg->record);
+    }
+    fprintf(out, "%zu package%s, %zu file%s", npkgs, npkgs!=1 ? "s" : "", nfiles, nfiles!=1 ? "s" : "");
+    for(int s=FILE_MISSING; s<FILE_STATES; s++){
+        fprintf(out, "%s %u %s", s==FILE_MISSING ? ":" : ",", totals[s], file_states[s]);
+        if(totals[s])
+            ret=1;
+    }
+    fprintf(out, "%s\n", mode==VERIFY_RECORD ? ", manifests written" : "");
+    STATS_END(STATS_OUTPUT, t);
+    close(job.rootfd);
+    free(job.files);
+    free(job.pkgs);
+    return ret;
+}
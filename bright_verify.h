@@ -0,0 +1,29 @@
+/** \file
+ * Check the files of the installed packages against their records.
+ *
+ * Every path of the file list of a record of \c SB_DB must still be under
+ * \c ROOT, a directory where the list has a directory and something else
+ * where it has a file.  Slackware records keep no checksums, so the content
+ * is checked against a manifest of SHA-256 sums recorded beforehand in
+ * \c VERIFY_MANIFESTS of \c BS_CACHEDIR, one file per package in the format
+ * of sha256sum, under a header giving the size and mtime of the record it was
+ * made from.  A manifest older than its record is not used.
+ *
+ * The records are read on the thread pool and their paths gathered in one
+ * list, which is then checked on \c VERIFY_IO_FACTOR threads per processor:
+ * the workers take the paths one at a time, so a package of many files or
+ * a large file to hash keeps no thread idle.
+ */
+#ifndef BRIGHT_VERIFY_H
+#define BRIGHT_VERIFY_H
+#include <stdio.h>
+
+#define VERIFY_MANIFESTS "manifests/"  //!< The directory of the manifests in \c BS_CACHEDIR.
+#define VERIFY_MAGIC "BSMAN01"         //!< First word of the header of a manifest.
+#define VERIFY_IO_FACTOR 4             //!< Checking threads per processor, most of them waiting on the disk.
+#define VERIFY_BUFSIZE (128*1024)      //!< Read size when hashing a file.
+
+enum {VERIFY_TYPES=0, VERIFY_HASH, VERIFY_RECORD}; //!< What verify_packages() does.
+
+int verify_packages(FILE *out, char *names[], int count, int mode);
+#endif /* BRIGHT_VERIFY_H */
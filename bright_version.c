@@ -0,0 +1,185 @@
+/** \file
+ * Compare Slackware and SBo versions and find the installed packages that
+ * have a newer version in the Slackbuilds repository or in patches.
+ */
+#include "brightstar.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_catalog.h"
+#include "bright_repo.h"
+#include "bright_version.h"
+
+/** Tell if the alphabetic segment s of length len marks a pre-release, which
+ * sorts before the release itself: 1.0rc1 < 1.0.  Only spelled-out tags
+ * count: a single letter after the digits is a post-release, as in the
+ * letter releases of openssl, 1.0.1a > 1.0.1.
+ */
+static int is_prerelease(const char *s, size_t len)
+{
+    static const char *tags[]={"alpha", "beta", "pre", "rc", "dev", NULL};
+    for(int i=0; tags[i]; i++)
+        if(strlen(tags[i])==len && !strncasecmp(s, tags[i], len))
+            return 1;
+    return 0;
+}
+
+/** Compare two versions the way package versions are usually ordered.
+ * The versions are split in runs of digits, compared as numbers, and runs
+ * of letters, compared as strings.  Separators like . _ - + only split.
+ * A run of digits is newer than a run of letters, and a pre-release run
+ * (alpha, beta, pre, rc, dev) is older than the end of the version, while
+ * any other run of letters, like the a of 1.0.1a, is newer.
+ * \return <0 if a is older than b, 0 if they are the same, >0 if a is newer.
+ */
+int version_compare(const char *a, const char *b)
+{
+    while(*a || *b){
+        const char *sa, *sb;
+        size_t la, lb;
+        int c;
+        while(*a && !isalnum((unsigned char)*a))
+            a++;
+        while(*b && !isalnum((unsigned char)*b))
+            b++;
+        if(*a=='\0' || *b=='\0'){
+            //Only one version goes on: it is newer unless it goes on with a pre-release
+            const char *rest=*a ? a : b;
+            size_t len=0;
+            if(*rest=='\0')
+                return 0;
+            while(isalpha((unsigned char)rest[len]))
+                len++;
+            c=(len>0 && is_prerelease(rest, len)) ? -1 : 1;
+            return *a ? c : -c;
+        }
+        sa=a;
+        sb=b;
+        if(isdigit((unsigned char)*a) && isdigit((unsigned char)*b)){
+            while(*sa=='0')
+                sa++;
+            while(*sb=='0')
+                sb++;
+            for(a=sa; isdigit((unsigned char)*a); a++)
+                ;
+            for(b=sb; isdigit((unsigned char)*b); b++)
+                ;
+            la=a-sa;
+            lb=b-sb;
+            if(la!=lb)
+                return la<lb ? -1 : 1;
+            if((c=strncmp(sa, sb, la)))
+                return c;
+            continue;
+        }
+        if(isdigit((unsigned char)*a)!=isdigit((unsigned char)*b)){
+            //Digits are newer than letters: 1.0.1 > 1.0a
+            return isdigit((unsigned char)*a) ? 1 : -1;
+        }
+        for(a=sa; isalpha((unsigned char)*a); a++)
+            ;
+        for(b=sb; isalpha((unsigned char)*b); b++)
+            ;
+        la=a-sa;
+        lb=b-sb;
+        if((c=strncasecmp(sa, sb, la<lb ? la : lb)))
+            return c;
+        if(la!=lb)
+            return la<lb ? -1 : 1;
+    }
+    return 0;
+}
+
+/**An installed package waiting to be matched against the repository.
+ */
+typedef struct {
+    const installed_s *inst;
+    char *key;       //!< Case-folded name.
+} outdated_s;
+
+static int outdated_cmp(const void *a, const void *b)
+{
+    return strcmp(((const outdated_s *)a)->key, ((const outdated_s *)b)->key);
+}
+
+/** Print one line for every installed package that has a newer version,
+ * "name installed -> newer (source)".  Slackware packages are matched with the
+ * patches entries of pkglist, the packages built from a Slackbuild, as told by
+ * installed_from_slackbuild(), with the merged index of the repositories, the
+ * source being the repository.  Both the installed list and the index are
+ * sorted on the case-folded name, so they are merged in one linear walk.
+ * \param out where to print
+ * \return the number of outdated packages.
+ */
+int outdated_report(FILE *out)
+{
+    GHashTable *table=installed_table();
+    GHashTable *patches=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    sb_index_s *idx=sb_index_get();
+    slack_index_s *sidx=slack_index_try_get();
+    guint count=g_hash_table_size(table);
+    outdated_s *list=calloc(count ? count : 1, sizeof(outdated_s));
+    GHashTableIter iter;
+    gpointer key, value;
+    FILE *fp;
+    char line[MAXLEN];
+    guint n=0;
+    uint32_t e=0;
+    int found=0;
+
+    //The latest patches entry of each package, "version build"
+    if((fp=file_try_open(SK_LIST_PATH, "r"))==NULL)
+        fprintf(stderr, "Cannot open file %s for mode %s, the patches are left out\n", SK_LIST_PATH, "r");
+    while(fp && fgets(line, sizeof(line), fp)){
+        char *pvalue;
+        char *repo=strtok_r(line, " ", &pvalue);
+        char *name=strtok_r(NULL, " ", &pvalue);
+        char *version=strtok_r(NULL, " ", &pvalue);
+        char *arch=strtok_r(NULL, " ", &pvalue);
+        char *build=strtok_r(NULL, " ", &pvalue);
+        if(repo==NULL || build==NULL || strcmp(repo, "patches") || arch==NULL)
+            continue;
+        g_hash_table_replace(patches, g_strdup(name), g_strdup_printf("%s %s", version, build));
+    }
+    if(fp)
+        file_close(fp, SK_LIST_PATH);
+
+    g_hash_table_iter_init(&iter, table);
+    while(g_hash_table_iter_next(&iter, &key, &value)){
+        list[n].inst=value;
+        list[n++].key=g_ascii_strdown(key, -1);
+    }
+    qsort(list, n, sizeof(*list), outdated_cmp);
+
+    for(guint i=0; i<n; i++){
+        const installed_s *inst=list[i].inst;
+        const sb_index_entry_s *sb;
+        char *patch=g_hash_table_lookup(patches, inst->name);
+        if(patch){
+            char version[100];
+            int build;
+            if(sscanf(patch, "%99s %d", version, &build)==2){
+                int c=version_compare(inst->version, version);
+                if(c<0 || (c==0 && atoi(inst->build)<build)){
+                    fprintf(out, "%s %s-%s -> %s-%d (patches)\n", inst->name, inst->version, inst->build, version, build);
+                    found++;
+                }
+            }
+            continue;
+        }
+        while(e<idx->hdr->count && strcmp(sb_index_str(idx, idx->entries[e].key), list[i].key)<0)
+            e++;
+        sb=e<idx->hdr->count && !strcmp(sb_index_str(idx, idx->entries[e].key), list[i].key) ? &idx->entries[e] : NULL;
+        if(installed_from_slackbuild(inst, sb!=NULL, sidx && slack_index_lookup(sidx, inst->name))){
+            const char *version=sb_index_str(idx, sb->version);
+            if(version_compare(inst->version, version)<0){
+                fprintf(out, "%s %s -> %s (%s)\n", inst->name, inst->version, version, repo_get(sb->repo)->name);
+                found++;
+            }
+        }
+    }
+    for(guint i=0; i<n; i++)
+        g_free(list[i].key);
+    free(list);
+    g_hash_table_destroy(patches);
+    return found;
+}
@@ -0,0 +1,10 @@
+/** \file
+ * Version ordering and the report of outdated packages.
+ */
+#ifndef BRIGHT_VERSION_H
+#define BRIGHT_VERSION_H
+#include <stdio.h>
+
+int version_compare(const char *a, const char *b);
+int outdated_report(FILE *out);
+#endif /* BRIGHT_VERSION_H */
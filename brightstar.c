@@ -41,6 +41,25 @@ or better, use make command.
 
 #include "brightstar.h"
 #include "bright_parse.h"
+#include "bright_index.h"
+#include "bright_installed.h"
+#include "bright_download.h"
+#include "bright_deps.h"
+#include "bright_search.h"
+#include "bright_serve.h"
+#include "bright_version.h"
+#include "bright_changelog.h"
+#include "bright_catalog.h"
+#include "bright_export.h"
+#include "bright_scan.h"
+#include "bright_owner.h"
+#include "bright_footprint.h"
+#include "bright_verify.h"
+#include "bright_build.h"
+#include "bright_sources.h"
+#include <fcntl.h>
+
+int section=NONE;
 
 /** A simple wrapper to fopen that provides a more friendly message if
  * file cannot be open.
@@ -56,9 +75,34 @@ FILE * file_open(const char *filename, const char *mode)
         printf("%s\n","Cannot proceed further");
         exit(1);
     }
+    STATS_COUNT(STATS_FOPEN, 1);
+    return fp;
+}
+
+/** Open a file like \c file_open() but without exiting, for the callers
+ * that must survive a missing file, such as the query daemon.
+ * \param filename the full path of the file to open
+ * \param mode like r, w
+ * \return the file, NULL if it cannot be opened.
+ */
+FILE *file_try_open(const char *filename, const char *mode)
+{
+    FILE *fp=fopen(filename, mode);
+    if(fp)
+        STATS_COUNT(STATS_FOPEN, 1);
     return fp;
 }
 
+/** Close a file read sequentially, counting for --stats the bytes read from it.
+ * \param fp the file
+ * \param filename the path it was opened with
+ */
+void file_close(FILE *fp, const char *filename)
+{
+    STATS_FILE(filename, ftello(fp));
+    fclose(fp);
+}
+
 /**Strip newline character at end of string.
  * \param s the string to strip of newline character.
  */
@@ -67,29 +111,17 @@ void chomp(char *s)
     s[strcspn ( s, "\n" )] = '\0';
 }
 
-/**Calculate md5sum of filename.
- *  \param md5 Store the md5 to be calculated from filename.
- *  \param filename The filename to calculate the md5sum.
+/**Write the len bytes of digest in lowercase hexadecimal.
+ * \param out 2*len+1 bytes, the string ends with a nul
  */
-void do_md5(char md5[33], char *filename)
+void to_hex(char *out, const unsigned char *digest, int len)
 {
-    unsigned char c[MD5_DIGEST_LENGTH];
-    FILE *inFile = file_open(filename, "rb");
-    MD5_CTX mdContext;
-    int bytes;
-    unsigned char data[1024];
-    char md[2]={};
-
-    MD5_Init (&mdContext);
-    while ((bytes = fread (data, 1, 1024, inFile)) != 0)
-        MD5_Update (&mdContext, data, bytes);
-    MD5_Final (c,&mdContext);
-    for (int i = 0; i < MD5_DIGEST_LENGTH; i++)
-    {
-        sprintf(md,"%02x",c[i]);
-        strncat(md5, md,2);
+    static const char digits[]="0123456789abcdef";
+    for(int i=0; i<len; i++){
+        out[2*i]=digits[digest[i]>>4];
+        out[2*i+1]=digits[digest[i]&15];
     }
-    fclose (inFile);
+    out[2*len]='\0';
 }
 
 /**Compare the value of two md5 and return 0 if they match or -1 if they don't.
@@ -117,480 +149,612 @@ int set_section_flag(char *line, int current)
     if (strstr(line,"REQUIRES=")) return 6;
     if (strstr(line,"MAINTAINER=")) return 7;
     if (strstr(line,"EMAIL=")) return 8;
+    if (strstr(line,"SHA256SUM=")) return 9;
+    if (strstr(line,"SHA256SUM_x86_64=")) return 10;
     return current;
 }
 
 /** Search for a package name matching name.  If name is not provided,
  * print a list of all packages found in the repository.
- * \param name the string to search for in the package name
+ * The names are read from the SLACKBUILDS.TXT index rather than the file itself.
+ * \param name the string to search for in the package name, case is ignored
  */
 int search_name(const char *name)
 {
-    FILE *fp;
-    int linelength=80;
-    char line[linelength];
-    fp=file_open(SB_BUILDS_LIST, "r");
-    while(fgets(line, linelength,fp))
-    {
-        if(strstr(line,VAR_NAME))
-        {
-            char *p;
-            p=rindex(line,':');
-            if(name!=NULL && strstr(&p[2], name))
-                printf("%s",&p[2]);
-            else if(name==NULL)
-                printf("%s",&p[2]);
-        }
-    }
-    fclose(fp);
+    sb_index_s *idx=sb_index_get();
+    if(name!=NULL)
+        return display_matches(name, SEARCH_SUBSTRING, 0, 0);
+    for(uint32_t i=0; i<idx->hdr->count; i++)
+        printf("%s\n", sb_index_str(idx, idx->entries[i].name));
     return 0;    
 }
 
-/**A utility function that puts into an array the strings of the download URL and md5sum.
- * \param a The package structure to write to.
- * \param s the string to be put into the array
- * \param section the section of the package structure where the array is placed.
+/** Print the names of the packages matching query, through the trigram index.
+ * \param query the string to search for, case is ignored
+ * \param mode SEARCH_SUBSTRING, SEARCH_PREFIX or SEARCH_FUZZY
+ * \param with_descr also match the short descriptions
+ * \param top number of fuzzy matches, 0 for \c SEARCH_TOP
  */
-void split2array(package_s *a, char *s, int section)
+int display_matches(const char *query, int mode, int with_descr, int top)
 {
-    char *pvalue;
-    char *t;
-    char *p=s;
-    int i=0;
-    int j;
-    char *tmp[45]={};
-    t=strtok_r(p, " ", &pvalue);
-    asprintf(&tmp[i++], "%s", t);
-    while((t=strtok_r(NULL, " ", &pvalue)))
-        asprintf(&tmp[i++], "%s", t);
-    for(j=0; j<=i; j++)
-    {
-        if(section==LINE_DOWNLOAD)
-        {
-            asprintf(&a->download[j], "%s", tmp[j]);
-            a->download_count=j;
-        }
-        else if(section==LINE_DOWNLOAD64) 
-        {
-            asprintf(&a->download_64[j], "%s", tmp[j]);
-            a->download_64_count=j;
-        }
-        else if(section==LINE_MD5SUM)
-        {
-            asprintf(&a->md5sum[j], "%s", tmp[j]);
-            a->md5sum_count=j;
-        }
-        else if(section==LINE_MD5SUM64)
-        {
-            asprintf(&a->md5sum_64[j], "%s", tmp[j]);
-            a->md5sum_64_count=j;
-        }
-        free(tmp[j]);
-    }
+    sb_index_s *idx=sb_index_get();
+    uint32_t *found;
+    int n=search_packages(query, mode, with_descr, top>0 ? top : SEARCH_TOP, &found);
+    for(int i=0; i<n; i++)
+        printf("%s\n", sb_index_str(idx, idx->entries[found[i]].name));
+    free(found);
+    return 0;
 }
 
-slackware_s describe_slack(const char *name){
-    FILE *fp;
-    slackware_s slack_s = {};
-    char line[MAXLEN];
-    int found=0;
-    fp=file_open(SK_LIST_PATH, "r");
-    while(fgets(line, sizeof(line), fp)){
-        char *p=line;
-        char *pvalue;
-        char *tmp_repo;
-        char *tmp_name;
-        tmp_repo=strtok_r(p, " ", &pvalue);
-        tmp_name=strtok_r(NULL, " ", &pvalue);
-        if(!strcmp(tmp_repo,"slackware") && !strcmp(tmp_name, name)){
-            found=1;
-            strcpy(slack_s.repo, tmp_repo);
-            strcpy(slack_s.name,tmp_name);
-            strcpy(slack_s.version, strtok_r(NULL, " ", &pvalue));
-            strcpy(slack_s.arch, strtok_r(NULL, " ", &pvalue));
-            strcpy(slack_s.release, strtok_r(NULL, " ", &pvalue));
-            strcpy(slack_s.fullname, strtok_r(NULL, " ", &pvalue));
-            strcpy(slack_s.location, strtok_r(NULL, " ", &pvalue));
-            strcpy(slack_s.extension, strtok_r(NULL, " ", &pvalue));
-            chomp(slack_s.extension);
-            break;
-        }
-        else if(!strcmp(tmp_repo,"patches") && !strcmp(tmp_name, name)){
-            strcpy(slack_s.patch, strtok_r(NULL, " ", &pvalue));
-        }
+/**Fill the sizes and description of spkg from its PACKAGES.TXT record.
+ * \param a the arena of spkg
+ * \param fd PACKAGES.TXT
+ * \param e the catalog entry of the package
+ * \param spkg the package to fill
+ */
+static void read_slack_record(arena_s *a, int fd, const slack_index_entry_s *e, slackware_s *spkg)
+{
+    char *record=malloc(e->descr_length+1);
+    ssize_t n=pread(fd, record, e->descr_length, e->descr);
+    GPtrArray *descr=g_ptr_array_new();
+    STATS_FILE(SK_PACKAGES, n>0 ? n : 0);
+    const char *eof=record+(n>0 ? n : 0);
+    const char *line=record;
+    int found_descr=0;
+    while(line<eof){
+        scan_line_s l;
+        line=scan_line(line, eof, &l);
+        if(l.colon==NULL)
+            continue;
+        *(char *)l.end='\0';
+        if(l.key==SCAN_PKG_SIZEC)
+            spkg->sizec=arena_intern(a, l.value);
+        else if(l.key==SCAN_PKG_SIZEU)
+            spkg->sizeu=arena_intern(a, l.value);
+        else if(l.key==SCAN_PKG_DESCRIPTION)
+            found_descr=1;
+        else if(found_descr)
+            g_ptr_array_add(descr, (char *)l.value);
     }
-    fclose(fp);
-    if(found==1){ //We have a package name, lets continue.
-        found=0;
-        int found_descr=0;
-        int descr_line=0;
-        fp=file_open(SK_PACKAGES, "r");
-        while(fgets(line, sizeof(line), fp)){
-            char *p=line;
-            char *pvalue;
-            char *t;
-            char needle[300]={};
-            strcpy(needle, slack_s.fullname);
-            strcat(strcat(needle, "."), slack_s.extension);
-            t=strtok_r(p, ":", &pvalue);
-            chomp(pvalue);
-            g_strchug(pvalue);
-            if(!strcmp(t, "PACKAGE NAME") && strcasestr(pvalue, slack_s.fullname)){
-                found=1;
+    spkg->descr=arena_span(a, (const char **)descr->pdata, descr->len);
+    g_ptr_array_free(descr, TRUE);
+    free(record);
+}
+
+/**Describe the Slackware packages named in names from the catalog index.
+ * Only the PACKAGES.TXT records of the packages found are read.
+ * \param a the arena receiving the descriptions
+ * \param names the package names
+ * \param count the number of names
+ * \param spkg receive count descriptions, in the order of names, NULL when
+ * there is no such Slackware package.
+ */
+void describe_slack_batch(arena_s *a, char *names[], int count, slackware_s *spkg[])
+{
+    uint64_t t=STATS_BEGIN();
+    slack_index_s *idx=slack_index_get();
+    int fd=-1;
+    for(int i=0; i<count; i++){
+        const slack_index_entry_s *e=slack_index_lookup(idx, names[i]);
+        slackware_s *s;
+        spkg[i]=NULL;
+        if(e==NULL)
+            continue;
+        s=spkg[i]=arena_alloc(a, sizeof(slackware_s));
+#define FIELD(f) s->f=arena_intern(a, slack_index_str(idx, e->f))
+        FIELD(repo);
+        FIELD(name);
+        FIELD(version);
+        FIELD(arch);
+        FIELD(release);
+        FIELD(fullname);
+        FIELD(location);
+        FIELD(extension);
+        FIELD(patch);
+#undef FIELD
+        s->sizec=s->sizeu="";
+        s->descr=arena_span(a, NULL, 0);
+        if(e->descr_length==0)
+            continue;
+        if(fd<0){
+            if((fd=open(SK_PACKAGES, O_RDONLY))<0)
                 continue;
-            }
-            if(found==1){
-                //if(!strcmp(t, PKG_LOCATION))
-                //    strcpy(slack_s.location, pvalue);
-                if(!strcmp(t, PKG_SIZEC))
-                    strcpy(slack_s.sizec, pvalue);
-                if(!strcmp(t, PKG_SIZEU))
-                    strcpy(slack_s.sizeu, pvalue);
-                if(!strcmp(t, PKG_DESCRIPTION)){
-                    found_descr=1;
-                    continue;
-                }
-                if(found_descr){
-                    asprintf(&slack_s.descr[descr_line++], "%s", pvalue);
-                    slack_s.descr_count=descr_line;
-                }
-                if(t[0]=='\n'){//We are done with description, get out.
-                    break;
-                }
-            }
+            STATS_COUNT(STATS_FOPEN, 1);
         }
-        fclose(fp);
+        read_slack_record(a, fd, e, s);
     }
+    if(fd>=0)
+        close(fd);
+    STATS_END(STATS_LOOKUP, t);
+}
+
+/**Describe one Slackware package from the catalog index.
+ * \param a the arena receiving the description
+ * \param name the package name
+ * \return the description, NULL if there is no such Slackware package.
+ */
+slackware_s *describe_slack(arena_s *a, const char *name){
+    slackware_s *slack_s;
+    char *names[1]={(char *)name};
+    describe_slack_batch(a, names, 1, &slack_s);
     return slack_s;
 }
 
 /**For the package searched, extract name, location, files
- * version and short description from the SLACKBUILDS.TXT file
+ * version and short description from the SLACKBUILDS.TXT file.
+ * The record of the package is located through the index, only that record is read.
+ * \param a the arena receiving the package
  * \param *name The name of the package to describe.
+ * \return the package, NULL if there is no such Slackbuild or its
+ * SLACKBUILDS.TXT cannot be read.
  */
-package_s describe_package(const char *name)
+package_s *describe_package(arena_s *a, const char *name)
 {
-    FILE *fp;
-    package_s p_s={};
-    char line[MAXLEN];
-    int thisline=1;
-    int flag=0;
-    fp=file_open(SB_BUILDS_LIST, "r");
-    while(fgets(line, sizeof(line),fp)){
-        char *p=line;
-        char *pvalue;
-        char *t;
-        t=strtok_r(p, ":", &pvalue);
-        chomp(pvalue);
-        g_strchug(pvalue);
-        if(thisline==1)
-        {
-            if(!strcmp(t, "SLACKBUILD NAME") && !strcasecmp(name, pvalue))
-            {
-                strcpy(p_s.name, pvalue);
-                flag=1;
-            }
-        }
-        else if (flag==1)
-        {
-            if(!strcmp(t, "SLACKBUILD LOCATION")) 
-                strcpy(p_s.location, pvalue);
-            if(!strcmp(t, "SLACKBUILD FILES")) 
-                strcpy(p_s.files, pvalue);
-            if(!strcmp(t, "SLACKBUILD VERSION")) 
-                strcpy(p_s.version, pvalue);
-            if(!strcmp(t, "SLACKBUILD DOWNLOAD")) 
-                split2array(&p_s, pvalue, LINE_DOWNLOAD);
-            if(!strcmp(t, "SLACKBUILD MD5SUM")) 
-                split2array(&p_s, pvalue, LINE_MD5SUM);
-            if(!strcmp(t, "SLACKBUILD DOWNLOAD_x86_64")) 
-                split2array(&p_s, pvalue, LINE_DOWNLOAD64);
-            if(!strcmp(t, "SLACKBUILD MD5SUM_x86_64")) 
-                split2array(&p_s, pvalue, LINE_MD5SUM64);
-            if(!strcmp(t, "SLACKBUILD SHORT DESCRIPTION")) 
-                strcpy(p_s.shortdescr, pvalue);
+    package_s *p_s;
+    const sb_index_entry_s *e;
+    char *record;
+    const char *line;
+    const char *eof;
+    uint64_t t=STATS_BEGIN();
+    if((e=sb_index_lookup(sb_index_get(), name))==NULL){
+        STATS_END(STATS_LOOKUP, t);
+        return NULL;
+    }
+    p_s=arena_alloc(a, sizeof(package_s));
+    p_s->arena=a;
+    p_s->repo=repo_get(e->repo);
+    p_s->name=p_s->files=p_s->shortdescr=p_s->version=p_s->version_installed="";
+    p_s->location=p_s->homepage=p_s->maintainer=p_s->email=p_s->requires="";
+    p_s->download=p_s->download_64=p_s->md5sum=p_s->md5sum_64=arena_span(a, NULL, 0);
+    p_s->sha256sum=p_s->sha256sum_64=p_s->longdescr=p_s->download;
+    if((record=sb_index_read_record(e))==NULL){
+        fprintf(stderr, "Cannot open file %s for mode %s\n", p_s->repo->txt, "r");
+        STATS_END(STATS_LOOKUP, t);
+        return NULL;
+    }
+    eof=record+strlen(record);
+    for(line=record; line<eof; ){
+        scan_line_s l;
+        line=scan_line(line, eof, &l);
+        *(char *)l.end='\0';
+        switch(l.key){
+            case SCAN_SB_NAME: p_s->name=arena_strdup(a, l.value); break;
+            case SCAN_SB_LOCATION: p_s->location=arena_strdup(a, l.value); break;
+            case SCAN_SB_FILES: p_s->files=arena_strdup(a, l.value); break;
+            case SCAN_SB_VERSION: p_s->version=arena_intern(a, l.value); break;
+            case SCAN_SB_DOWNLOAD: p_s->download=arena_split(a, l.value, " "); break;
+            case SCAN_SB_MD5SUM: p_s->md5sum=arena_split(a, l.value, " "); break;
+            case SCAN_SB_DOWNLOAD64: p_s->download_64=arena_split(a, l.value, " "); break;
+            case SCAN_SB_MD5SUM64: p_s->md5sum_64=arena_split(a, l.value, " "); break;
+            case SCAN_SB_SHORTDESCR: p_s->shortdescr=arena_strdup(a, l.value); break;
         }
-        if(flag==1 && !strcmp(t,"\n")) goto finish; //No need to go further
-        thisline++;
-        if(thisline==11)thisline=1;
     }
-finish:
-    fclose(fp);
+    free(record);
+    STATS_END(STATS_LOOKUP, t);
     return p_s;
 }
 
+/**Append to value the part of an .info line that belongs to a quoted,
+ * possibly multi-line, value.  Quotes, backslashes and the KEY= prefix are dropped.
+ */
+static void append_info_value(GString *value, const char *line)
+{
+    const char *p=strchr(line, '=');
+    p=(p && p<strchr(line, '"')) ? p+1 : line;
+    g_string_append_c(value, ' ');
+    for(; *p; p++)
+        if(*p!='"' && *p!='\\' && *p!='\n')
+            g_string_append_c(value, *p);
+}
+
 /**Get the homepage, requires, maintainer and email as described in the 
- * packagename.info file.
+ * packagename.info file.  The sha256sum of the sources are kept as well
+ * when the .info file provides them.
+ * \return 0 on success, -1 if the .info file cannot be opened.
  */
-void get_package_info(package_s *pkg)
+int get_package_info(package_s *pkg)
 {
     char *location=NULL;
-    location=g_strconcat(SB_REPODIR, pkg->location+2, "/",pkg->name, ".info",  NULL);
+    location=g_strconcat(pkg->repo->dir, pkg->location+2, "/",pkg->name, ".info",  NULL);
     FILE *fp;
     char line[MAXLEN];
-    fp=file_open(location, "r");
-    g_free(location);
+    GString *value[SHA256SUM_x86_64+1]={};
+    uint64_t t=STATS_BEGIN();
+    if((fp=file_try_open(location, "r"))==NULL){
+        fprintf(stderr, "Cannot open file %s for mode %s\n", location, "r");
+        g_free(location);
+        return -1;
+    }
+    section=NONE;
     while(fgets(line, MAXLEN, fp))
     {
         section=set_section_flag(line,section);
-        if(section==HOMEPAGE)
-        {
-            if(sscanf(line,"HOMEPAGE=\"%[^\"]",pkg->homepage)!=1)
-                pkg->homepage[0]='\0';
-        }
-        else if(section==REQUIRES)
-        {
-            if(sscanf(line,"REQUIRES=\"%[^\"]",pkg->requires)!=1)
-                pkg->requires[0]='\0';
-        }
-        else if(section==MAINTAINER)
+        if(section==HOMEPAGE || section==REQUIRES || section==MAINTAINER || section==EMAIL
+                || section==SHA256SUM || section==SHA256SUM_x86_64)
         {
-            if(sscanf(line,"MAINTAINER=\"%[^\"]",pkg->maintainer)!=1)
-                pkg->maintainer[0]='\0';
+            if(value[section]==NULL)
+                value[section]=g_string_new(NULL);
+            append_info_value(value[section], line);
         }
-        else if(section==EMAIL)
-        {
-            if(sscanf(line,"EMAIL=\"%[^\"]",pkg->email)!=1)
-                pkg->email[0]='\0';
-        }
- 
-    }
-    fclose(fp);
-}
-
-void free_spkg(slackware_s *pkg){
-    int j=0;
-    while(j<=pkg->descr_count){
-        free(pkg->descr[j]);
-        j++;
-    }
-}
-
-/**Clean up the memory taken up by the download, download_64, md5sum,
- * md5sum_64, and longdescr arrays.
- */
-void free_pkg(package_s *pkg)
-{
-    int j=0;
-    while(j<=pkg->download_count)
-    {
-        free(pkg->download[j]);
-        free(pkg->md5sum[j]);
-        j++;
     }
-    j=0;
-    while(j<=pkg->download_64_count)
+    file_close(fp, location);
+    g_free(location);
+    for(int i=0; i<=SHA256SUM_x86_64; i++)
     {
-        free(pkg->download_64[j]);
-        free(pkg->md5sum_64[j]);
-        j++;
+        const char *v;
+        if(value[i]==NULL)
+            continue;
+        v=g_strstrip(value[i]->str);
+        if(i==HOMEPAGE)
+            pkg->homepage=arena_strdup(pkg->arena, v);
+        else if(i==REQUIRES)
+            pkg->requires=arena_strdup(pkg->arena, v);
+        else if(i==MAINTAINER)
+            pkg->maintainer=arena_intern(pkg->arena, v);
+        else if(i==EMAIL)
+            pkg->email=arena_intern(pkg->arena, v);
+        else if(i==SHA256SUM)
+            pkg->sha256sum=arena_split(pkg->arena, v, " ");
+        else if(i==SHA256SUM_x86_64)
+            pkg->sha256sum_64=arena_split(pkg->arena, v, " ");
+        g_string_free(value[i], TRUE);
     }
-    j=0;
-    while(j<pkg->longdescr_count)
-        free(pkg->longdescr[j++]);
+    STATS_END(STATS_INFO, t);
+    return 0;
 }
 
 /**Parse the package pointer for \c download and \c download_64 arrays and request
  * download depending if values of download_count or download_64_count are
- * greater than 0. Use \c do_md5() to verify the md5.
+ * greater than 0.  The source files are downloaded concurrently by
+ * \c download_all(), which checks their md5sum, and sha256sum when the .info
+ * file has one, while they are being received.  Sources already in the source
+ * cache are linked from it without any download, and the ones downloaded
+ * are added to it.
+ * \return 0 on success, 1 if the package has no source to download.
  */
-void request_download(package_s *pkg)
+int request_download(package_s *pkg)
 {
     if(YesOrNo("Download source files")==1){
-        if (pkg->download_count==0 && pkg->download_64_count==0){
+        span_s urls;
+        span_s md5sums;
+        span_s sha256sums;
+        int count;
+        if (pkg->download.count==0 && pkg->download_64.count==0){
             fprintf(stderr,"%s\n","No package to download.  Terminated");
-            exit(EXIT_FAILURE);
+            return 1;
         }
-        if(pkg->download_count>0){
-            for(int i=0; i<pkg->download_count; i++){
-                char *source=rindex(pkg->download[i], '/');
-                char *sourceSavePath = strdup(SAVESOURCEPATH);
-                asprintf(&sourceSavePath, "%s",source);
-                int isOk=do_download(pkg->download[i], sourceSavePath); 
-                if(isOk==0){
-                    char md5[33]={};
-                    do_md5(md5, sourceSavePath);
-                    if(md5_compare(md5, pkg->md5sum[i])!=0)
-                        printf("%s %s\n", ">>>>MD5 failed for", pkg->download[i]);
-                    else
-                        printf("%s %s\n", sourceSavePath, "MD5 ok");
-                }
-                else
-                    printf("Download of %s failed\n", pkg->download[i]);
-                free(sourceSavePath);
+        if(pkg->download.count>0){
+            urls=pkg->download;
+            md5sums=pkg->md5sum;
+            sha256sums=pkg->sha256sum;
+        }
+        else{
+            urls=pkg->download_64;
+            md5sums=pkg->md5sum_64;
+            sha256sums=pkg->sha256sum_64;
+        }
+        download_s dl[urls.count];
+        memset(dl, 0, sizeof(dl));
+        count=0;
+        for(int i=0; i<urls.count; i++){
+            const char *slash=rindex(urls.items[i], '/');
+            dl[count].url=urls.items[i];
+            dl[count].saveto=g_strconcat(SAVESOURCEPATH, slash ? slash+1 : urls.items[i], NULL);
+            dl[count].md5=i<md5sums.count ? md5sums.items[i] : NULL;
+            dl[count].sha256=i<sha256sums.count ? sha256sums.items[i] : NULL;
+            if(sources_fetch(dl[count].md5, dl[count].sha256, dl[count].saveto)==0){
+                printf("%s %s\n", dl[count].saveto, "from the source cache");
+                g_free(dl[count].saveto);
+                memset(&dl[count], 0, sizeof(dl[count]));
             }
+            else
+                count++;
         }
-        else if(pkg->download_64_count>0){
-            for(int i=0; i<pkg->download_64_count; i++) {
-                char *source=rindex(pkg->download_64[i], '/');
-                char *sourceSavePath = strdup(SAVESOURCEPATH);
-                asprintf(&sourceSavePath, "%s",source);
-                int isOk=do_download(pkg->download_64[i], sourceSavePath); 
-                if(isOk==0){
-                    char md5[33]={};
-                    do_md5(md5, sourceSavePath);
-                    if(md5_compare(md5, pkg->md5sum_64[i])!=0)
-                        printf("%s %s\n", ">>>>MD5 failed for", pkg->download_64[i]);
-                    else
-                        printf("%s %s\n", sourceSavePath, "MD5 ok");
-                }
-                else
-                    printf("Download of %s failed\n", pkg->download_64[i]);
-                free(sourceSavePath);
+        if(count)
+            download_all(dl, count);
+        for(int i=0; i<count; i++){
+            if(dl[i].status==0){
+                printf("%s %s\n", dl[i].saveto, dl[i].sha256 ? "MD5 and SHA256 ok" : "MD5 ok");
+                if(dl[i].md5)
+                    sources_add(dl[i].saveto, dl[i].md5_got, dl[i].sha256_got);
             }
+            else if(dl[i].status==DL_CHECKSUM_FAILED)
+                printf("%s %s\n", ">>>>Checksum failed for", dl[i].url);
+            else
+                printf("Download of %s failed\n", dl[i].url);
+            g_free(dl[i].saveto);
         }
+        if(count)
+            sources_evict(sources_max());
     }
-    if(YesOrNo("Download Slackbuild")==1){
+    if(pkg->repo->reponet==NULL)
+        printf("The Slackbuild of %s cannot be downloaded from repository %s\n", pkg->name, pkg->repo->name);
+    else if(YesOrNo("Download Slackbuild")==1){
         char *url_build = NULL;
         char *url_pgp = NULL;
         char *save_build = NULL;
         char *save_pgp = NULL;
-        url_build=g_strconcat(SB_REPONET, pkg->location+2, ".tar.gz", NULL );
+        pid_t pid;
+        url_build=g_strconcat(pkg->repo->reponet, pkg->location+2, ".tar.gz", NULL );
         url_pgp=g_strconcat(url_build, ".asc", NULL );
         save_build=g_strconcat(SAVESOURCEPATH, pkg->name, ".tar.gz", NULL);
         save_pgp=g_strconcat(save_build, ".asc", NULL);
-        do_download(url_build, save_build);
-        do_download(url_pgp, save_pgp);
-        execl("/usr/bin/gpg", "/usr/bin/gpg", "--verify", save_pgp, NULL);
+        download_s dl[2]={{.url=url_build, .saveto=save_build}, {.url=url_pgp, .saveto=save_pgp}};
+        download_all(dl, 2);
+        fflush(stdout);
+        if((pid=fork())==0){
+            execl("/usr/bin/gpg", "/usr/bin/gpg", "--verify", save_pgp, NULL);
+            _exit(127);
+        }
+        while(pid>0 && waitpid(pid, NULL, 0)<0 && errno==EINTR)
+            ;
         free(url_build);
         free(url_pgp);
         free(save_build);
         free(save_pgp);
     }
+    return 0;
 }
 
-/**Used by request download to download from \c url and save the source file at \c saveto.
+/**Download a single \c url and save it at \c saveto.
  * \param *url The url to download
  * \param *saveto The full path to locally save the url downloaded.
+ * \return 0 on success, the CURLcode of the failure otherwise.
  */
 int do_download(char *url, char *saveto)
 {
-    int isOk=-1;
-    CURL *easyhandle = curl_easy_init();
-    if(easyhandle!=NULL)
-    {
-        curl_easy_setopt(easyhandle, CURLOPT_URL, url);
-        FILE *fp=file_open(saveto, "w");
-        curl_easy_setopt(easyhandle, CURLOPT_WRITEDATA, fp);
-        curl_easy_setopt(easyhandle, CURLOPT_FOLLOWLOCATION, 1);//For sites like downloads.sourceforge
-        //curl_easy_setopt(easyhandle, CURLOPT_VERBOSE, 1);
-        printf("Downloading...%s\n", url);
-        isOk=curl_easy_perform(easyhandle);
-        fclose(fp);
-    }
-    curl_easy_cleanup(easyhandle);
-    curl_global_cleanup();//To make valgrind happier
-    return isOk;
+    download_s dl={.url=url, .saveto=saveto};
+    download_all(&dl, 1);
+    return dl.status;
 }
 
-/**Print to sdtout the content of standard Slackware package information based
- * on structure slackware_s.
- * param spkg
+/**Return the width of the terminal, 80 when stdin is not a terminal.
  */
-void print_spkg_info(slackware_s spkg){
+static int terminal_width(void)
+{
     struct winsize w;
-    ioctl(0, TIOCGWINSZ, &w);
-    printf( "\n%s\n","====Slackware package information details====");
-    if(spkg.name[0]=='\0'){
-        printf("\n%s\n","No Slackare package exist");
+    if(ioctl(0, TIOCGWINSZ, &w)<0 || w.ws_col==0)
+        return 80;
+    return w.ws_col;
+}
+
+/**Print to out the content of standard Slackware package information based
+ * on structure slackware_s.
+ * \param out where to print, stdout or a client of the daemon
+ * \param spkg the package, NULL if there is no such Slackware package
+ */
+void print_spkg_info(FILE *out, const slackware_s *spkg){
+    uint64_t t=STATS_BEGIN();
+    fprintf(out,  "\n%s\n","====Slackware package information details====");
+    if(spkg==NULL){
+        fprintf(out, "\n%s\n","No Slackare package exist");
+        STATS_END(STATS_OUTPUT, t);
         return;
     }
-    printf("Repo:              %s\n", spkg.repo);
-    printf("name:              %s\n", spkg.name);
-    printf("version:           %s\n", spkg.version);
-    if(spkg.patch[0]!='\0')
-        printf("patch:             %s\n", spkg.patch);
-    printf("architecture:      %s\n", spkg.arch);
-    printf("release No:        %s\n", spkg.release);
-    printf("fullname:          %s\n", spkg.fullname);
-    printf("location:          %s\n", spkg.location);
-    printf("extension:         %s\n", spkg.extension);
-    printf("size compressed:   %s\n", spkg.sizec);
-    printf("size uncompressed: %s\n", spkg.sizeu);
-    putchar('\n');
-    for (int i=0; i<spkg.descr_count; i++)
-        printf("%s\n", spkg.descr[i]);
+    fprintf(out, "Repo:              %s\n", spkg->repo);
+    fprintf(out, "name:              %s\n", spkg->name);
+    fprintf(out, "version:           %s\n", spkg->version);
+    if(spkg->patch[0]!='\0')
+        fprintf(out, "patch:             %s\n", spkg->patch);
+    fprintf(out, "architecture:      %s\n", spkg->arch);
+    fprintf(out, "release No:        %s\n", spkg->release);
+    fprintf(out, "fullname:          %s\n", spkg->fullname);
+    fprintf(out, "location:          %s\n", spkg->location);
+    fprintf(out, "extension:         %s\n", spkg->extension);
+    fprintf(out, "size compressed:   %s\n", spkg->sizec);
+    fprintf(out, "size uncompressed: %s\n", spkg->sizeu);
+    fputc('\n', out);
+    for (int i=0; i<spkg->descr.count; i++)
+        fprintf(out, "%s\n", spkg->descr.items[i]);
+    STATS_END(STATS_OUTPUT, t);
 }
 
-/**Print to stdout the content of structure package_s pkg, the Slackbuild
+/**Print to out the content of structure package_s pkg, the Slackbuild
  * package details
+ * \param out where to print, stdout or a client of the daemon
  * \param pkg
  */
-void print_package_info(package_s pkg)
+void print_package_info(FILE *out, const package_s *pkg)
 {
-    struct winsize w;
-    ioctl(0, TIOCGWINSZ, &w);
-    printf ("%s\n","====Slackbuild package information details====");
-    printf ("Package        :%s\n", pkg.name);
-    printf ("Version        :%s ", pkg.version);
-    if(pkg.version_installed[0]!='\0')
-        printf ("  %s %s", "Installed Version: ", pkg.version_installed);
-    putchar('\n');
-    printf ("Short Descr    :%s\n", pkg.shortdescr);
-    printf ("Home page      :%s\n", pkg.homepage);
-    printf ("Maintainer     :%s <%s> \n", pkg.maintainer, pkg.email);
-    printf ("Location       :%s\n", pkg.location);
+    uint64_t t=STATS_BEGIN();
+    int cols=terminal_width();
+    fprintf(out, "%s\n","====Slackbuild package information details====");
+    fprintf(out, "Package        :%s\n", pkg->name);
+    fprintf(out, "Version        :%s ", pkg->version);
+    if(pkg->version_installed[0]!='\0')
+        fprintf(out, "  %s %s", "Installed Version: ", pkg->version_installed);
+    fputc('\n', out);
+    fprintf(out, "Short Descr    :%s\n", pkg->shortdescr);
+    fprintf(out, "Home page      :%s\n", pkg->homepage);
+    fprintf(out, "Maintainer     :%s <%s> \n", pkg->maintainer, pkg->email);
+    fprintf(out, "Location       :%s\n", pkg->location);
+    if(repo_count()>1)
+        fprintf(out, "Repository     :%s\n", pkg->repo->name);
     int i=0;
     int j=0;
     int c;
-    printf ("Files          :");
-    while ((c=pkg.files[i++])!='\0')
+    fprintf(out, "Files          :");
+    while ((c=pkg->files[i++])!='\0')
     {
-        putchar(c);
-        if(j++ >= w.ws_col-39 && c==' ')
+        fputc(c, out);
+        if(j++ >= cols-39 && c==' ')
         {
             j=0;
-            printf("\n%s","                ");
+            fprintf(out, "\n%s","                ");
         }
     }
-    putchar('\n');
-    printf ("Requires       :%s\n", pkg.requires);
-    if(pkg.download_count>0)
+    fputc('\n', out);
+    fprintf(out, "Requires       :%s\n", pkg->requires);
+    if(pkg->download.count>0)
     {
         int j=0;
-        printf("32 bits download %d file%s\n", pkg.download_count, pkg.download_count>1? "s":"");
-        while(j<pkg.download_count)
+        fprintf(out, "32 bits download %d file%s\n", pkg->download.count, pkg->download.count>1? "s":"");
+        while(j<pkg->download.count)
         {
-            printf("%s %s\n",pkg.md5sum[j], pkg.download[j]);
+            fprintf(out, "%s %s\n", j<pkg->md5sum.count ? pkg->md5sum.items[j] : "", pkg->download.items[j]);
             j++;
         }
     }
-    if(pkg.download_64_count>0)
+    if(pkg->download_64.count>0)
     {
         int j=0;
-        printf("64 bits download %d file%s\n", pkg.download_64_count, pkg.download_64_count>1? "s":"");
-        while(j<pkg.download_64_count)
+        fprintf(out, "64 bits download %d file%s\n", pkg->download_64.count, pkg->download_64.count>1? "s":"");
+        while(j<pkg->download_64.count)
         {
-            printf("%s %s\n", pkg.md5sum_64[j], pkg.download_64[j]);
+            fprintf(out, "%s %s\n", j<pkg->md5sum_64.count ? pkg->md5sum_64.items[j] : "", pkg->download_64.items[j]);
             j++;
         }
     }
-    if(pkg.longdescr_count>0)
+    if(pkg->longdescr.count>0)
     {
         int j=0;
-        while(j<pkg.longdescr_count)
-            printf("%s", pkg.longdescr[j++]);
+        while(j<pkg->longdescr.count)
+            fprintf(out, "%s", pkg->longdescr.items[j++]);
     }
+    STATS_END(STATS_OUTPUT, t);
 }
 
-/**Use rsync to download the local repository with Slackbuilds repository.  Must be run as root.
- * This function uses the \c RSYNC_URL and \c SB_REPODIR as define in \c sbob.h.
+/** Add the package directory of an rsync itemized line to changed.
+ * The line is "YXcstpoguax path" or "*deleting path", path being relative
+ * to the directory of repository r.  Only paths at least two levels deep,
+ * category/package, name a package directory.  It is added prefixed with
+ * the name of the repository, like "SBo/academic/foo".
+ * \return the path of the line, or NULL if the line is not an item.
  */
-int synchronize(void)
+static const char *rsync_item(const repo_s *r, char *line, GHashTable *changed)
 {
-    if(getuid())
-    {
-        fprintf(stderr,"%s\n", "Become root to rsync");
+    char *path=strchr(line, ' ');
+    char *slash;
+    if(path==NULL)
+        return NULL;
+    while(*path==' ')
+        path++;
+    line[strcspn(line, "\n")]='\0';
+    if((slash=strchr(path, '/')) && slash[1]!='\0'){
+        char *end=strchr(slash+1, '/');
+        int len=end ? (int)(end-path) : (int)strlen(path);
+        g_hash_table_add(changed, g_strdup_printf("%s/%.*s", r->name, len, path));
+    }
+    return path;
+}
+
+/** Run rsync from the sync source of repository r to its directory and add
+ * the package directories it changed to changed.
+ * \param items incremented by the number of items rsync updated
+ * \return 0 on success, 1 if rsync could not run or failed.
+ */
+static int rsync_repo(const repo_s *r, GHashTable *changed, int *items)
+{
+    const char *rsync=getenv("RSYNC") ? getenv("RSYNC") : RSYNC;
+    char line[MAXLEN];
+    int fd[2];
+    int status;
+    pid_t pid;
+    FILE *fp;
+    if(pipe(fd)<0){
+        fprintf(stderr, "Cannot run rsync: %s\n", strerror(errno));
         return 1;
     }
-    if(execl(RSYNC, RSYNC, "-rvz","--delete", RSYNC_URL, SB_REPODIR, NULL)==-1)
-    {
-        fprintf(stderr, "Cannot run rsync: %s", strerror(errno));
+    if((pid=fork())<0){
+        fprintf(stderr, "Cannot run rsync: %s\n", strerror(errno));
+        close(fd[0]);
+        close(fd[1]);
+        return 1;
+    }
+    if(pid==0){
+        dup2(fd[1], STDOUT_FILENO);
+        close(fd[0]);
+        close(fd[1]);
+        //-t keeps the times, or every file is sent and itemized again on each sync
+        execl(rsync, rsync, "-rtz", "--delete", "--itemize-changes", r->sync, r->dir, NULL);
+        fprintf(stderr, "Cannot run rsync: %s\n", strerror(errno));
+        _exit(127);
+    }
+    close(fd[1]);
+    fp=fdopen(fd[0], "r");
+    while(fgets(line, sizeof(line), fp)){
+        const char *path=rsync_item(r, line, changed);
+        if(path){
+            printf("%s\n", path);
+            (*items)++;
+        }
+    }
+    fclose(fp);
+    while(waitpid(pid, &status, 0)<0 && errno==EINTR)
+        ;
+    if(!WIFEXITED(status) || WEXITSTATUS(status)!=0){
+        fprintf(stderr, "rsync of %s failed with status %d\n", r->name, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
         return 1;
     }
     return 0;
 }
 
+/** Tell whether rsync can write the local tree dir, ending with a slash,
+ * or create it.
+ */
+static int can_sync(const char *dir)
+{
+    char *parent;
+    char *slash;
+    int ok;
+    if(access(dir, F_OK)==0)
+        return access(dir, W_OK)==0;
+    parent=g_strndup(dir, strlen(dir)-1);
+    if((slash=strrchr(parent, '/')))
+        slash[1]='\0';
+    ok=access(slash ? parent : ".", W_OK)==0;
+    g_free(parent);
+    return ok;
+}
+
+/**Use rsync to download the local trees of the repositories from their sync
+ * source.  A repository whose local tree cannot be written is left out, the
+ * system ones needing root.
+ * Without a list of repositories, \c RSYNC_URL is synchronized in \c SB_REPODIR.
+ * The environment variable RSYNC_URL, when set, replaces \c RSYNC_URL, e.g. with a
+ * local directory, and RSYNC replaces \c RSYNC.
+ * rsync runs as a child whose itemized changes are read to learn which package
+ * directories changed, so that only their .info files are read again to update
+ * the dependency graph.
+ * \return 0 on success, 1 if a repository failed to synchronize.
+ */
+int synchronize(void)
+{
+    GHashTable *previous=NULL;
+    GHashTable *changed;
+    int items=0;
+    int failed=0;
+    int found;
+    sb_index_stamp(&found);
+    if(found>0)
+        previous=deps_snapshot();
+    changed=g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for(int i=0; i<repo_count(); i++){
+        const repo_s *r=repo_get(i);
+        if(r->sync==NULL)
+            continue;
+        if(!can_sync(r->dir)){
+            fprintf(stderr, "Become root to rsync %s in %s\n", r->name, r->dir);
+            failed=1;
+            continue;
+        }
+        if(repo_count()>1)
+            printf("Synchronizing %s from %s\n", r->name, r->sync);
+        failed|=rsync_repo(r, changed, &items);
+    }
+    printf("%d item%s updated in %u package%s\n", items, items!=1 ? "s" : "",
+            g_hash_table_size(changed), g_hash_table_size(changed)!=1 ? "s" : "");
+    if(items>0 || previous==NULL){
+        sb_index_stamp(&found);
+        if(found>0)
+            deps_update(previous, changed);
+    }
+    g_hash_table_destroy(changed);
+    if(previous)
+        g_hash_table_destroy(previous);
+    return failed;
+}
+
 /**Display to stdout overall help features
  * */
 void display_help_op(void){
@@ -600,17 +764,34 @@ void display_help_op(void){
     putchar('\n');
     pr("-D --display Display to stdout information about slackware package.");
     putchar('\n');
+    pr("--serve      Keep the indexes loaded and answer queries on a Unix socket, open to the");
+    pr("             group of the daemon or to the group named by "SERVE_GROUP_ENV".");
+    pr("--query <q>  Send query q to the daemon, like \"installed bind\" or \"describe foo\".");
+    pr("--socket <path> The socket of the daemon, "BS_SOCKET" by default.");
+    pr("--stats      Print the time of each phase, the bytes read and the files opened to stderr.");
+    pr("--stats=json Print them as one JSON object.");
     putchar('\n');
 
     pr("Default system configutation values");
     pr("Where to rsync from.  With slackware version.....:"RSYNC_URL);
     pr("The params to pass on to rsync...................:"RSYNC_ARGS );
     pr("The path of rsync................................:"RSYNC );
-    pr("The local directory of Slackbuild files..........:"SB_REPODIR );
+    printf("%s%s\n", "The local directory of Slackbuild files..........:", SB_REPODIR);
     pr("The remote location of Slackbuild files..........:"SB_REPONET );
     pr("Filename containing characteristics of a package.:"SB_TXT );
-    pr("The local full path of Slackbuilds...............:"SB_BUILDS_LIST SB_REPODIR SB_TXT);
-    pr("The Slackware installed packages database........:"SB_DB );
+    printf("%s%s\n", "The local full path of Slackbuilds...............:", SB_BUILDS_LIST);
+    printf("%s%s\n", "The Slackware installed packages database........:", SB_DB);
+    printf("%s%s\n", "The Slackware packages database..................:", SK_DB);
+    printf("%s%s\n", "Where brightstar keeps its indexes...............:", BS_CACHEDIR);
+    printf("%s%s\n", "Where brightstar reads "REPOS_CONF"................:", bs_path(PATH_BS_CONFDIR));
+    pr("Set SB_REPODIR, SB_DB, SK_DB, BS_CACHEDIR, BS_CONFDIR or ROOT in the environment to change a directory.");
+    if(repo_count()>1){
+        pr("Repositories, by decreasing priority:");
+        for(int i=0; i<repo_count(); i++){
+            const repo_s *r=repo_get(i);
+            printf("  %-12s %4d %s\n", r->name, r->priority, r->dir);
+        }
+    }
 #undef pr
 }
 
@@ -619,10 +800,31 @@ void display_help_op(void){
 void display_help_display(void){
 #define pr(s) (printf("%s\n",s))
     pr("-a --all        Display all package names from Slackbuild repo to stdout.");
-    pr("-d --describe   <package name> Display complete description about package.");
+    pr("-d --describe   <package name>... Display complete description about packages.");
+    pr("                Use - to read the package names from stdin.");
     pr("-r --readme     <package name> Display readme file of package.");
     pr("-c --changelog  <package name> Display changelog file of package.");
-    pr("-m --match      <string> Display package names matching string.");
+    pr("-m --match      <string> Display package names containing string, case is ignored.");
+    pr("   --prefix     With -m, display package names starting with string.");
+    pr("   --descr      With -m, also match the short descriptions.");
+    pr("-f --fuzzy      <string> Display the package names closest to string.");
+    pr("   --top        <n> With -f, the number of names displayed.");
+    pr("-b --build-order <package name>... Display the packages to build, dependencies first.");
+    pr("-o --outdated   Display the installed packages with a newer version in a repository or patches.");
+    pr("   --required-by <package name>... Display the packages requiring the packages named,");
+    pr("                directly or not, in rebuild order.");
+    pr("   --direct     With --required-by, only the packages listing them in their REQUIRES.");
+    pr("   --installed  With --required-by, only the installed packages.");
+    pr("-w --owner      <path>... Display the installed packages owning path.  A path ending");
+    pr("                with / lists the files under it, *, ? and [ make it a glob.");
+    pr("-x --export     [package name...] Write every package, or the packages named, as one JSON");
+    pr("                object per line.  Use - to read the package names from stdin.");
+    pr("   --footprint  [=package|series|repo] Display the installed size of every package, or");
+    pr("                summed per series or repository, largest first.");
+    pr("   --disk       With --footprint, also measure the files under ROOT, \"/\" by default.");
+    pr("   --verify     [package name...] Check that the files of the installed packages, or of");
+    pr("                the packages named, are under ROOT with their type.");
+    pr("   --hash       With --verify, also compare the files to the manifests of -S --manifest.");
 #undef pr
 }
 
@@ -632,37 +834,62 @@ void display_help_system(void)
 {
 #define pr(s) (printf("%s\n",s))
     pr("-r --rsync  Synchronize your local database of slackbuilds with Slackbuild.org");
+    pr("            Set RSYNC_URL to synchronize from another source, like a local directory,");
+    pr("            and RSYNC to run another rsync than "RSYNC".");
     //pr("-i --install <package name> Install package on your system.  Only one package name accepted.");
     //pr("-u --uninstall <package name> Uninstall package name from your system.  Only one package name accepted");
     pr("-d --download <package name> Interactively download slackbuild and package tarball of package.");
-    pr("              You can say yes or no to either.");
+    pr("              You can say yes or no to either.  Sources in the source cache of");
+    pr("              BS_CACHEDIR are linked without download; BS_SOURCES_MAX bounds its size.");
+    pr("-b --build <package name>... Build the packages and what they require that is not");
+    pr("              installed, installing each package built, as root.  Sources must be in the directory");
+    pr("              of the Slackbuild, or in the source cache.  Set BS_INSTALLPKG to change the");
+    pr("              install command, or to \"\" to only build.");
+    pr("--build-jobs <n> Number of Slackbuilds run at the same time, one per processor by default.");
+    pr("-j --jobs <n> Number of source files downloaded at the same time.");
+    pr("--host-connections <n> Number of connections opened to a same host.");
+    pr("--manifest [package name...] Record the SHA-256 of the files of the installed packages,");
+    pr("              or of the packages named, for -D --verify --hash.");
     pr("-h --help Display this menu.");
 #undef pr
 }
 
 /**Get the long description as stored in the slack-desc.  
  * \param pkg
- * The slack-desc file is read from \c SB_REPODIR + package location folder.
+ * The slack-desc file is read from the directory of the package in its repository.
+ * \return 0 on success, -1 if the slack-desc file cannot be opened.
  */
-void get_longdescr(package_s *pkg)
+int get_longdescr(package_s *pkg)
 {
-    char *location=g_strconcat(SB_REPODIR, pkg->location+2, "/slack-desc",  NULL);
+    char *location=g_strconcat(pkg->repo->dir, pkg->location+2, "/slack-desc",  NULL);
     FILE *fp;
     char line[MAXLEN];
-    fp=file_open(location, "r");
-    g_free(location);
-    pkg->longdescr_count=0;
+    GPtrArray *lines=g_ptr_array_new_with_free_func(g_free);
+    uint64_t t=STATS_BEGIN();
+    if((fp=file_try_open(location, "r"))==NULL){
+        fprintf(stderr, "Cannot open file %s for mode %s\n", location, "r");
+        g_ptr_array_free(lines, TRUE);
+        g_free(location);
+        return -1;
+    }
     int i=0;
     while (fgets(line, MAXLEN, fp) && i++<8)
         ;
     while (fgets(line, MAXLEN, fp))
     {
         char *p=line;
+        if(strlen(p)<=strlen(pkg->name)+1)
+            continue;
         p=p+strlen(pkg->name)+1;
         if(strlen(p)>1)
-             asprintf(&pkg->longdescr[pkg->longdescr_count++],p);
+            g_ptr_array_add(lines, g_strdup(p));
     }
-    fclose(fp);
+    file_close(fp, location);
+    g_free(location);
+    pkg->longdescr=arena_span(pkg->arena, (const char **)lines->pdata, lines->len);
+    g_ptr_array_free(lines, TRUE);
+    STATS_END(STATS_INFO, t);
+    return 0;
 }
 
 /**Print to stdout the content of README file for package pkg->name
@@ -670,190 +897,206 @@ void get_longdescr(package_s *pkg)
  */
 void display_readme(package_s *pkg)
 {
-    char *location=g_strconcat(SB_REPODIR, pkg->location+2, "/README",  NULL);
+    char *location=g_strconcat(pkg->repo->dir, pkg->location+2, "/README",  NULL);
     FILE *fp;
     char line[MAXLEN];
     fp=file_open(location, "r");
-    g_free(location);
     while (fgets(line, MAXLEN, fp))
         printf("%s", line);
-    fclose(fp);
+    file_close(fp, location);
+    g_free(location);
 }
 /**Print to stdout the content of Changelog For a Slackbuild package.
  * \param *pkg */
 void display_slackbuild_changelog(package_s *pkg)
 {
-    char *location=g_strconcat(SB_REPODIR, pkg->location+2, "/config/changelog",  NULL);
+    char *location=g_strconcat(pkg->repo->dir, pkg->location+2, "/config/changelog",  NULL);
     FILE *fp;
     char line[MAXLEN];
     fp=file_open(location, "r");
-    g_free(location);
     while (fgets(line, MAXLEN, fp))
         printf("%s", line);
-    fclose(fp);
+    file_close(fp, location);
+    g_free(location);
 }
 /**Print to stdout Slackware Changelog for a given package.
  * \param *pkg */
 void display_slackware_ckangelog(slackware_s *pkg){
-    FILE *fp;
-    char line[MAXLEN];
-    enum {NEWLOG, LOGDATE, PATCH, COMMENT} logline;
-    char logdate[100];
-    char patch[100];
-    int patchline=0;
-    logline=NEWLOG;
-    fp=file_open(SK_CHANGELOG, "r");
-    while (fgets(line, MAXLEN, fp)){
-        char patchcomment[25][100]={};
-        if(line[0]=='+'){
-            if(logline==COMMENT){
-                puts(logdate);
-                puts(patch);
-                for(int i=0; i<=patchline; i++){
-                    puts(patchcomment[i]);
-                }
-                patchline=0;
-            }
-            logline=LOGDATE;
-            continue;
-        }
-        if(logline==LOGDATE){
-            strcpy(logdate, line);
-            chomp(logdate);
-            logline=PATCH;
-            continue;
-        }
-        if(logline==PATCH){
-            if(strstr(line, "patches/packages") && strstr(line, pkg->name)){
-                strcpy(patch, line);
-                chomp(patch);
-                //printf(">>>>>%s\n",patch);
-                logline=COMMENT;
-                continue;
-            }
-        }
-        if(logline==COMMENT){
-            if(line[0]==' '){
-                strcpy(patchcomment[patchline], line);
-                chomp(patchcomment[patchline]);
-                patchline++;
-            }else if(strstr(line, "patches/packages")){
-                logline=PATCH;
-                puts(logdate);
-                puts(patch);
-                for(int i=0; i<=patchline; i++){
-                    puts(patchcomment[i]);
-                }
-                patchline=0;
-                continue;
-            }else if(line[0]=='+'){
-                logline=NEWLOG;
-                puts(logdate);
-                puts(patch);
-                for(int i=0; i<=patchline; i++){
-                    puts(patchcomment[i]);
-                }
-                patchline=0;
-                continue;
-            }
-
-        }
-    }
+    changelog_display(stdout, pkg->name);
 }
 
-/**Search SB_DB for pkg->name and retreive its installed version.
+/**Look up pkg->name in the installed packages table and retreive its installed version.
  * Set the value of pkg->version_installed
  */
 void get_installed_version(package_s *pkg)
 {
-    struct dirent **namelist;
-    int n;
-    int isMatch=0;//No match yet
-    n = scandir(SB_DB, &namelist, 0, NULL);
-    if (n < 0)
-        perror("scandir");
-    else {
-        while(n--) {
-            if(isMatch==0){
-                char *s;
-                char *trash;
-                s=strtok_r(namelist[n]->d_name, "-", &trash);
-                if(!strcmp(s, pkg->name)){
-                    isMatch=1;
-                    if(isalpha(*trash)!=0){
-                        isMatch=0;
-                        free(namelist[n]);
-                        continue;
-                    }
-                    s=strtok_r(NULL,"-", &trash);
-                    strncpy(pkg->version_installed, s, 10);
-                }
-                free(namelist[n]);
-            }
-            else//Answer found, but need to clear memory...
-                free(namelist[n]);
-        }
-        free(namelist);
-    }
+    uint64_t t=STATS_BEGIN();
+    const installed_s *inst=installed_lookup(pkg->name);
+    if(inst)
+        pkg->version_installed=arena_intern(pkg->arena, inst->version);
+    STATS_END(STATS_INSTALLED, t);
 }
 
 /**For each package that is required, check if it is installed.
  * modify the pkg->requires strig with expression "installed" or
- * "not installed" for each required package.
+ * "not installed" for each required package.  REQUIRES is split on blanks,
+ * as for the dependency graph, never expanded by a shell.
  */
 void emphasize_requires(package_s *pkg)
 {
-    wordexp_t p;
-    char **w;
-    char new_requires[300]={};
-    wordexp(pkg->requires, &p, 0);
-    w=p.we_wordv;
-    char *n;
-    n=new_requires;
-    char *t;
-    for(int i=0; i< p.we_wordc; i++)
-    {
-        asprintf(&t, "%s (%s) ",w[i], is_package_installed(w[i])? "installed": "Not installed");
-        strcat(n,t);    
-    }
-    strcpy(pkg->requires, n);
-    wordfree(&p);
+    char *requires=g_strdup(pkg->requires);
+    char *w;
+    char *pw;
+    GString *new_requires=g_string_new(NULL);
+    uint64_t t=STATS_BEGIN();
+    for(w=strtok_r(requires, " \t", &pw); w; w=strtok_r(NULL, " \t", &pw))
+        g_string_append_printf(new_requires, "%s (%s) ",w, is_package_installed(w)? "installed": "Not installed");
+    pkg->requires=arena_strdup(pkg->arena, new_requires->str);
+    g_string_free(new_requires, TRUE);
+    g_free(requires);
+    STATS_END(STATS_REQUIRES, t);
 }
 
-/** Check if package_name is installed by checking in SB_DB
+/** Check if package_name is installed by looking it up in the installed packages table.
  * \param package_name
  * \return 1 if installed, 0 if not installed
  */
 int is_package_installed(char *package_name)
 {
-    struct dirent **namelist;
+    uint64_t t=STATS_BEGIN();
+    int installed=installed_lookup(package_name)!=NULL;
+    STATS_END(STATS_INSTALLED, t);
+    return installed;
+}
+
+/**Print the packages to build for the packages in names, dependencies first.
+ * The whole REQUIRES tree is followed and installed packages are left out.
+ * \param names the packages wanted
+ * \param count the number of names
+ * \return 0 on success, 1 if a package is unknown or the dependencies have a cycle.
+ */
+int display_build_order(char *names[], int count)
+{
+    sb_index_s *idx=sb_index_get();
+    deps_graph_s *g=deps_get();
+    uint32_t roots[count];
+    uint32_t *order;
     int n;
-    int isMatch=0;//No match yet
-    n = scandir(SB_DB, &namelist, 0, NULL);
-    if (n < 0)
-        perror("scandir");
-    else {
-        while(n--) {
-            if(isMatch==0){
-                char *s;
-                char *trash;
-                s=strtok_r(namelist[n]->d_name, "-", &trash);
-                if(!strcmp(s, package_name)){
-                    isMatch=1;
-                    if(isalpha(*trash)!=0){
-                        isMatch=0;
-                        free(namelist[n]);
-                        continue;
-                    }
-                }
-                free(namelist[n]);
-            }
-            else//Answer found, but need to clear memory...
-                free(namelist[n]);
+    for(int i=0; i<count; i++){
+        const sb_index_entry_s *e=sb_index_lookup(idx, names[i]);
+        if(e==NULL){
+            printf("%s %s\n","Nothing found for", names[i]);
+            return 1;
+        }
+        roots[i]=e-idx->entries;
+    }
+    if((n=deps_order(g, roots, count, 1, &order))<0)
+        return 1;
+    for(int i=0; i<n; i++){
+        printf("%s\n", sb_index_str(idx, idx->entries[order[i]].name));
+        if(g->flags[order[i]]&DEPS_README)
+            fprintf(stderr, "%s: see README for optional dependencies\n",
+                    sb_index_str(idx, idx->entries[order[i]].name));
+    }
+    free(order);
+    return 0;
+}
+
+/**Print the packages requiring the packages in names, directly or through
+ * other packages, in the order they are to be rebuilt.
+ * \param names the packages required
+ * \param count the number of names
+ * \param flags DEPS_DIRECT and DEPS_INSTALLED, as for deps_dependents()
+ * \return 0 on success, 1 if a package is unknown.
+ */
+int display_required_by(char *names[], int count, int flags)
+{
+    sb_index_s *idx=sb_index_get();
+    uint32_t roots[count];
+    uint32_t *found;
+    int n;
+    for(int i=0; i<count; i++){
+        const sb_index_entry_s *e=sb_index_lookup(idx, names[i]);
+        if(e==NULL){
+            printf("%s %s\n","Nothing found for", names[i]);
+            return 1;
+        }
+        roots[i]=e-idx->entries;
+    }
+    n=deps_dependents(deps_get(), roots, count, flags, &found);
+    for(int i=0; i<n; i++)
+        printf("%s\n", sb_index_str(idx, idx->entries[found[i]].name));
+    free(found);
+    return 0;
+}
+
+/**Print the Slackbuild description of name followed by its Slackware description spkg.
+ * \param out where to print, stdout or a client of the daemon
+ * \param a the arena receiving the Slackbuild description
+ * \param name the package to describe
+ * \param spkg the Slackware description of name, NULL if there is none
+ * \return 0 on success, -1 if a file of the Slackbuild cannot be read.
+ */
+int describe_one(FILE *out, arena_s *a, const char *name, const slackware_s *spkg)
+{
+    package_s *pkg;
+    if(sb_index_lookup(sb_index_get(), name)==NULL){
+        const installed_s *inst=installed_lookup(name);
+        fprintf(out, "%s %s\n","No Slackbuilds found for",name);
+        if(inst)
+            fprintf(out, "Found Slackware installed version %s\n", inst->version);
+    }
+    else if((pkg=describe_package(a, name))==NULL || get_package_info(pkg)<0 || get_longdescr(pkg)<0)
+        return -1;
+    else{
+        get_installed_version(pkg);
+        if(pkg->requires[0]!='\0')
+            emphasize_requires(pkg);
+        print_package_info(out, pkg);
+    }
+    print_spkg_info(out, spkg);
+    return 0;
+}
+
+/**Print the Slackbuild and Slackware descriptions of every package in names,
+ * in that order.  All the descriptions share one arena, freed at the end.
+ * \param count the number of names
+ * \param names the packages to describe
+ * \return 0 on success, 1 if a package could not be described.
+ */
+int describe(int count, char *names[])
+{
+    arena_s *a=arena_new();
+    slackware_s **spkg=arena_alloc(a, (count ? count : 1)*sizeof(slackware_s *));
+    int ret=0;
+    describe_slack_batch(a, names, count, spkg);
+    for(int i=0; i<count; i++)
+        if(describe_one(stdout, a, names[i], spkg[i])<0)
+            ret=1;
+    arena_free(a);
+    return ret;
+}
+
+/**Collect the package names given after the options.  A single "-" reads
+ * them from stdin instead, one or more per line.
+ * \return the names, to be freed with g_ptr_array_free(names, TRUE).
+ */
+GPtrArray *read_names(int argc, char *argv[])
+{
+    GPtrArray *names=g_ptr_array_new_with_free_func(g_free);
+    if(optind<argc && !strcmp(argv[optind], "-")){
+        char line[MAXLEN];
+        while(fgets(line, sizeof(line), stdin)){
+            char *t;
+            char *pt;
+            for(t=strtok_r(line, " \t\n", &pt); t; t=strtok_r(NULL, " \t\n", &pt))
+                g_ptr_array_add(names, g_strdup(t));
         }
-        free(namelist);
     }
-    return isMatch;
+    else
+        for(int i=optind; i<argc; i++)
+            g_ptr_array_add(names, g_strdup(argv[i]));
+    return names;
 }
 
 /**Ask question to user and return 1 for y or Y, 0 for n or N
@@ -880,14 +1123,31 @@ int YesOrNo(const char *question)
     return answer; 
 }
 
+static int stats_format=STATS_OFF; //!< The format of the --stats report.
+
+/** Print the --stats report.  Registered with atexit(), so that the report
+ * is printed whatever path brightstar exits by.
+ */
+static void print_stats(void)
+{
+    stats_print(stderr, stats_format);
+    stats_release();
+}
+
 int init_parse(int argc, char *argv[])
 {
     //TODO Filter argv[optind]
     int ret;
     config=init_config();
-    package_s pkg;
-    slackware_s spkg;
+    package_s *pkg;
+    slackware_s *spkg;
+    arena_s *arena=arena_new();
     ret=parse_args(argc, argv);
+    if(config->stats){
+        stats_format=config->stats;
+        stats_enable();
+        atexit(print_stats);
+    }
     switch (config->op)
     {
         case OP_MAIN:
@@ -895,100 +1155,142 @@ int init_parse(int argc, char *argv[])
             break;
         case OP_SYSTEM:
             if(config->op_s_sync){
-                synchronize();
+                ret=synchronize();
             }
             else if(config->op_s_help){
                 display_help_system();
             }
+            else if(config->op_s_build && argv[optind]){
+                GPtrArray *names=read_names(argc, argv);
+                ret=build_packages((char **)names->pdata, names->len, config->build_jobs);
+                g_ptr_array_free(names, TRUE);
+            }
+            else if(config->op_s_manifest){
+                GPtrArray *names=read_names(argc, argv);
+                ret=verify_packages(stdout, (char **)names->pdata, names->len, VERIFY_RECORD);
+                g_ptr_array_free(names, TRUE);
+            }
             else if(config->op_s_download){
-                pkg=describe_package(argv[optind]);
-                if(pkg.name[0]=='\0'){
+                download_init(config->jobs, config->host_connections);
+                pkg=describe_package(arena, argv[optind]);
+                if(pkg==NULL)
                     printf("%s %s\n","Nothing found for", argv[optind]);
-                    return 0;
-                }
-                request_download(&pkg);
-                free_pkg(&pkg);
+                else if(get_package_info(pkg)<0)
+                    ret=1;
+                else
+                    ret=request_download(pkg);
             }
             break;
         case OP_DISPLAY://TODO need to look at single versus combined options
             if(config->op_d_descpkg){
-                spkg=describe_slack(argv[optind]);
-                pkg=describe_package(argv[optind]);
-                if(pkg.name[0]=='\0'){
-                    strcpy(pkg.name, argv[optind]);
-                    printf("%s %s\n","No Slackbuilds found for",argv[optind]);
-                    get_installed_version(&pkg);
-                    if(pkg.version_installed)
-                        printf("Found Slackware installed version %s\n", pkg.version_installed);
-                    //return 0;
-                }else{
-                    get_package_info(&pkg);
-                    get_longdescr(&pkg);
-                    get_installed_version(&pkg);
-                    if(pkg.requires[0]!='\0')
-                        emphasize_requires(&pkg);
-                    print_package_info(pkg);
-                }
-                print_spkg_info(spkg);
-                free_spkg(&spkg);
-                free_pkg(&pkg);
+                GPtrArray *names=read_names(argc, argv);
+                ret=describe(names->len, (char **)names->pdata);
+                g_ptr_array_free(names, TRUE);
+            }
+            else if(config->op_d_export){
+                GPtrArray *names=read_names(argc, argv);
+                ret=export_ndjson(stdout, (char **)names->pdata, names->len);
+                g_ptr_array_free(names, TRUE);
             }
             else if (config->op_d_match_name && argv[optind]){
-                search_name(argv[optind]);
+                display_matches(argv[optind], config->search_prefix ? SEARCH_PREFIX : SEARCH_SUBSTRING,
+                        config->search_descr, 0);
+            }
+            else if (config->op_d_fuzzy && argv[optind]){
+                display_matches(argv[optind], SEARCH_FUZZY, 0, config->search_top);
             }
             else if (config->op_d_all_pkgname && argv[optind]==NULL){
                 search_name(NULL);
             }
             else if (config->op_d_readme){
-                pkg=describe_package(argv[optind]);
-                if(pkg.name[0]=='\0'){
+                pkg=describe_package(arena, argv[optind]);
+                if(pkg==NULL)
                     printf("%s %s\n","Nothing found for",argv[optind]);
-                    return 0;
-                }
-                display_readme(&pkg);
-                free_pkg(&pkg);
+                else
+                    display_readme(pkg);
             }
             else if (config->op_d_changelog){
-                int checkslack=0;
-                pkg=describe_package(argv[optind]);
-                if(pkg.name[0]=='\0'){
+                pkg=describe_package(arena, argv[optind]);
+                if(pkg==NULL){
                     printf("%s %s\n","Nothing Slackbuild for",argv[optind]);
-                    checkslack=1;
+                    spkg=describe_slack(arena, argv[optind]);
+                    if(spkg && spkg->fullname[0]!='\0'){
+                        display_slackware_ckangelog(spkg);
+                    }
                 }else{
-                    display_slackbuild_changelog(&pkg);
+                    display_slackbuild_changelog(pkg);
                 }
-                free_pkg(&pkg);
-                if(checkslack==1){
-                    spkg=describe_slack(argv[optind]);
-                    if(spkg.fullname[0]!='\0'){
-                        display_slackware_ckangelog(&spkg);
+            }
+            else if (config->op_d_build_order && argv[optind]){
+                ret=display_build_order(&argv[optind], argc-optind);
+            }
+            else if (config->op_d_required_by && argv[optind]){
+                ret=display_required_by(&argv[optind], argc-optind,
+                        (config->rdeps_direct ? DEPS_DIRECT : 0)|(config->rdeps_installed ? DEPS_INSTALLED : 0));
+            }
+            else if (config->op_d_outdated){
+                if(outdated_report(stdout)==0)
+                    printf("%s\n", "Everything is up to date");
+            }
+            else if (config->op_d_owner && argv[optind]){
+                GPtrArray *paths=read_names(argc, argv);
+                for(guint i=0; i<paths->len; i++)
+                    if(owner_query(stdout, paths->pdata[i])==0){
+                        fprintf(stderr, "No installed package owns %s\n", (char *)paths->pdata[i]);
+                        ret=1;
                     }
-                }
-                free_spkg(&spkg);
+                g_ptr_array_free(paths, TRUE);
+            }
+            else if (config->op_d_verify){
+                GPtrArray *names=read_names(argc, argv);
+                ret=verify_packages(stdout, (char **)names->pdata, names->len,
+                        config->verify_hash ? VERIFY_HASH : VERIFY_TYPES);
+                g_ptr_array_free(names, TRUE);
+            }
+            else if (config->op_d_footprint){
+                ret=footprint_report(stdout, config->footprint_by, config->footprint_disk);
             }
             else if(config->op_d_help)
                 display_help_display();
             else
                 printf("<%s> %s\n",argv[1], "not a display option");
             break;
+        case OP_SERVE:
+            ret=serve(config->socket ? config->socket : BS_SOCKET);
+            break;
+        case OP_QUERY:
+            ret=query(config->socket ? config->socket : BS_SOCKET, config->query);
+            break;
         default:
             printf("%s\n","No valid operation specified");
             ret=EXIT_FAILURE;
             break;
     }
+    sb_index_release();
+    deps_release();
+    trigram_release();
+    installed_release();
+    owner_release();
+    changelog_release();
+    slack_index_release();
+    download_cleanup();
+    arena_free(arena);
+    repo_release();
+    paths_release();
     if(config){
         free(config);
         config=NULL;
-        ret=0;
     }
     return ret;
 }
 
+#ifndef BRIGHT_NO_MAIN
 /** Just calls init_parse()
  * \param argc
  * \param argv[]
  */
 int main(int argc, char *argv[])
 {
-    init_parse(argc, argv);
+    return init_parse(argc, argv);
 }
+#endif /* BRIGHT_NO_MAIN */
@@ -15,10 +15,15 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <curl/curl.h>
 #include <openssl/md5.h>
+#include <openssl/sha.h>
 #include <dirent.h>
-#include <wordexp.h>
+#include "bright_arena.h"
+#include "bright_paths.h"
+#include "bright_repo.h"
+#include "bright_stats.h"
 
 //extern char *optarg; //!< Use by getopt.
 //extern int optind; //!< Use by getopt.
@@ -50,7 +55,7 @@ bind: nameserver are included.  Documentation for advanced name server
 /*!< The Slackware installed packages database, used to find uout if a package 
  * is installed.  It contains original packages and third party pckages (SBo).
  */
-#define SB_DB "/var/log/packages/"     
+#define SB_DB bs_path(PATH_SB_DB)
                                         
 //SLACKWARE configuration section
 #define PKG_NAME "PACKAGE NAME"
@@ -59,13 +64,13 @@ bind: nameserver are included.  Documentation for advanced name server
 #define PKG_SIZEU "PACKAGE SIZE (uncompressed)"
 #define PKG_DESCRIPTION "PACKAGE DESCRIPTION"
 
-#define SK_DB "/var/lib/slackpkg/" //!<The DB folder of all slackware packages.
+#define SK_DB bs_path(PATH_SK_DB)   //!<The DB folder of all slackware packages.
 #define SK_TXT "PACKAGES.TXT"      //!<The file that contains Slackware package information.
 #define SK_CHNG "ChangeLog.txt"    //!<The file that contains Slackware package changelog.
 #define SK_LIST "pkglist"          //list repo, name, arch, release, version, fullname, location, extension
-#define SK_LIST_PATH SK_DB SK_LIST
-#define SK_PACKAGES SK_DB SK_TXT
-#define SK_CHANGELOG SK_DB SK_CHNG
+#define SK_LIST_PATH bs_file(PATH_SK_DB, SK_LIST)
+#define SK_PACKAGES bs_file(PATH_SK_DB, SK_TXT)
+#define SK_CHANGELOG bs_file(PATH_SK_DB, SK_CHNG)
 
 //SLACKBUILS configuration section
 #define LINE_NAME 1       //!< Line 1 for SLACKBUILD NAME: EMBASSY
@@ -86,78 +91,90 @@ bind: nameserver are included.  Documentation for advanced name server
 #define VAR_MD5SUM64   "SLACKBUILD MD5SUM_x86_64"       //!< Identifier to get the package md5sum source files 64 bits
 #define VAR_SHORTDESCR "SLACKBUILD SHORT DESCRIPTION"   //!< Identifier to get the package short description
 #define VAR_LOCATION   "SLACKBUILD LOCATION"            //!< Identifier to get the package directory location
-#define VAR_FILES      "SLACKBUILD FILE"                //!< Identifier to get the package slackbuild files
+#define VAR_FILES      "SLACKBUILD FILES"               //!< Identifier to get the package slackbuild files
 
 #define RSYNC_URL "rsync://rsync.slackbuilds.org/slackbuilds/14.0/"  //!< Where to rsync from.  With slackware version.
-#define RSYNC_ARGS "-rvz --delete"                                   //!< The params to pass on to rsync
+#define RSYNC_ARGS "-rtz --delete --itemize-changes"                 //!< The params to pass on to rsync
 #define RSYNC "/usr/bin/rsync"                                       //!< The path of rsync
-#define SB_REPODIR "/var/lib/sbopkg/SBo/14.0/"                       //!< The local directory of Slackbuild files
+#define SB_REPODIR bs_path(PATH_SB_REPODIR)                          //!< The local directory of Slackbuild files
 #define SB_REPONET "slackbuilds.org/slackbuilds/14.0/"               //!< The remote location of Slackbuild files
 #define SB_TXT "SLACKBUILDS.TXT"                                     //!< What can I say... :)
-#define SB_BUILDS_LIST SB_REPODIR SB_TXT                             //!< The local full path of Slackbuilds
+#define SB_BUILDS_LIST bs_file(PATH_SB_REPODIR, SB_TXT)              //!< The local full path of Slackbuilds
 #define SAVESOURCEPATH "/tmp/"                                       //!< Path where source files and Slackbuilds are download
 #define MAXLEN 2048                                                  //!< An array size sometime usefule...
 
-/**The elements used to describe a package from Slackware
+/**The elements used to describe a package from Slackware.  The strings
+ * live in the arena the package was described in and are never NULL.
  */
 typedef struct{
-    char repo[30];
-    char name[80];
-    char version[20];
-    char arch[10];
-    char release[3];
-    char fullname[50];
-    char location[150];
-    char extension[5];
-    char sizec[30];
-    char sizeu[30];
-    char *descr[13];
-    int descr_count;
-    char patch[75];
+    const char *repo;
+    const char *name;
+    const char *version;
+    const char *arch;
+    const char *release;
+    const char *fullname;
+    const char *location;
+    const char *extension;
+    const char *sizec;
+    const char *sizeu;
+    span_s descr;
+    const char *patch;
 } slackware_s;
 
-/**The elements used to describe a package as it exists in Slackbuilds
+/**The elements used to describe a package as it exists in Slackbuilds.  The
+ * strings and arrays live in the arena the package was described in and the
+ * strings are never NULL.
  */
 typedef struct {
-    char name[80];               //!< The name of the package as per SLACKBUILDS.TXT.
-    char files[300];             //!< The file included in the package (README, slackbuild,etc) as per SLACKBUILDS.TXT.
-    char *download[45];          //!< The url of the 32 bits source files version as per SLACKBUILDS.TXT.
-    int download_count;          //!< The number of source files, 32 bits version.
-    char *download_64[45];       //!< The url of the 64 bits source files version as per SLACKBUILDS.TXT.
-    int download_64_count;       //!< The number of source files, 64 bits version.
-    char *md5sum[45];            //!< The md5sum of the corresponding url source file 32 bits as per SLACKBUILDS.TXT.
-    int md5sum_count;            //!< The number of md5sum values associated to url source file 32 bits.
-    char *md5sum_64[45];         //!< The md5sum of the corresponding url source file 64 bits as per SLACKBUILDS.TXT.
-    int md5sum_64_count;         //!< The number of md5sum values associated to url source file 64 bits.
-    char shortdescr[900];        //!< The short description of the package as per SLACKBUILDS.TXT.
-    char *longdescr[10];         //!< The long description of the package as per slack-desc file.
-    int longdescr_count;         //!< The number of lines making the long description.
-    char version[30];            //!< The version of the package as per SLACKBUILDS.TXT.
-    char version_installed[30];  //!< The installed version of the package.
-    char location[150];          //!< The directory location of the package as per SLACKBUILDS.TXT.
-    char homepage[150];          //!< The website of the package as per .info file.
-    char maintainer[150];        //!< The maintainer of the slackbuild as per .info file.
-    char email[150];             //!< The email address of the slackbuild maintainer as per .info file.
-    char requires[300];          //!< The package(s) that are dependencies to the package as per .info file
+    arena_s *arena;              //!< Where the package is allocated.
+    const repo_s *repo;          //!< The repository the Slackbuild comes from.
+    const char *name;            //!< The name of the package as per SLACKBUILDS.TXT.
+    const char *files;           //!< The file included in the package (README, slackbuild,etc) as per SLACKBUILDS.TXT.
+    span_s download;             //!< The url of the 32 bits source files version as per SLACKBUILDS.TXT.
+    span_s download_64;          //!< The url of the 64 bits source files version as per SLACKBUILDS.TXT.
+    span_s md5sum;               //!< The md5sum of the corresponding url source file 32 bits as per SLACKBUILDS.TXT.
+    span_s md5sum_64;            //!< The md5sum of the corresponding url source file 64 bits as per SLACKBUILDS.TXT.
+    span_s sha256sum;            //!< The sha256sum of the corresponding url source file 32 bits as per .info file, if any.
+    span_s sha256sum_64;         //!< The sha256sum of the corresponding url source file 64 bits as per .info file, if any.
+    const char *shortdescr;      //!< The short description of the package as per SLACKBUILDS.TXT.
+    span_s longdescr;            //!< The long description of the package as per slack-desc file.
+    const char *version;         //!< The version of the package as per SLACKBUILDS.TXT.
+    const char *version_installed; //!< The installed version of the package.
+    const char *location;        //!< The directory location of the package as per SLACKBUILDS.TXT.
+    const char *homepage;        //!< The website of the package as per .info file.
+    const char *maintainer;      //!< The maintainer of the slackbuild as per .info file.
+    const char *email;           //!< The email address of the slackbuild maintainer as per .info file.
+    const char *requires;        //!< The package(s) that are dependencies to the package as per .info file
 } package_s;
 
 extern package_s *pkg;
 /**The sections of the .info file
  */
 enum {NONE=0, HOMEPAGE=1, DOWNLOAD=2, MD5SUM=3, DOWNLOAD_x86_64=4, 
-    MD5SUM_x86_64=5, REQUIRES=6, MAINTAINER=7, EMAIL=8} section;
+    MD5SUM_x86_64=5, REQUIRES=6, MAINTAINER=7, EMAIL=8, SHA256SUM=9, SHA256SUM_x86_64=10};
+extern int section; //!< The section of the .info file being parsed.
 
 FILE * file_open(const char *filename, const char *mode);
+FILE *file_try_open(const char *filename, const char *mode);
+void file_close(FILE *fp, const char *filename);
 void chomp(char *s);
+void to_hex(char *out, const unsigned char *digest, int len);
 int set_section_flag(char *line, int current);
 int search_name(const char *name);
-void split2array(package_s *a, char *s, int section);
-package_s describe_package(const char *name);
-void get_package_info(package_s *pkg);
-void free_pkg(package_s *pkg);
-void request_download(package_s *pkg);
+int display_matches(const char *query, int mode, int with_descr, int top);
+package_s *describe_package(arena_s *a, const char *name);
+slackware_s *describe_slack(arena_s *a, const char *name);
+void describe_slack_batch(arena_s *a, char *names[], int count, slackware_s *spkg[]);
+int describe(int count, char *names[]);
+int describe_one(FILE *out, arena_s *a, const char *name, const slackware_s *spkg);
+void print_spkg_info(FILE *out, const slackware_s *spkg);
+void print_package_info(FILE *out, const package_s *pkg);
+GPtrArray *read_names(int argc, char *argv[]);
+int get_package_info(package_s *pkg);
+int get_longdescr(package_s *pkg);
+void emphasize_requires(package_s *pkg);
+int request_download(package_s *pkg);
 int  do_download(char *url, char *saveto);
-void do_md5(char md[33], char *filename);
 int md5_compare(const char *md5_1, const char *md5_2);
 void display_help(void);
 void get_installed_version(package_s *pkg);
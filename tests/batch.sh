@@ -0,0 +1,26 @@
+#!/bin/sh
+# Describe many packages in one run of -D -d, named on the command line or
+# read from stdin with -: every package is described once, in the order
+# asked, whether it is a Slackbuild, a Slackware package or neither.
+# Usage: tests/batch.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+N=200
+for i in $(seq 1 $N); do
+    add_slackbuild p$i 1.$i ""
+done
+echo "slackware zlib 1.2.6 x86_64 1 zlib-1.2.6-x86_64-1 ./slackware64/l txz" > "$T/sk/pkglist"
+described() {
+    sed -n 's/^Package *:\(.*\)/\1/p; s/^name: *\(.*\)/\1/p; s/^No Slackbuilds found for \(.*\)/\1?/p' "$1" | tr '\n' ' '
+}
+
+"$BS" -D -d p2 zlib nosuch p1 > "$T/out" 2>&1 || fail "$(cat "$T/out")"
+[ "$(described "$T/out")" = "p2 zlib? zlib nosuch? p1 " ] || fail "$(described "$T/out")"
+
+seq $N -1 1 | sed 's/^/p/' > "$T/names"
+"$BS" -D -d - < "$T/names" > "$T/out" 2>&1 || fail "stdin: $(tail "$T/out")"
+[ "$(described "$T/out")" = "$(tr '\n' ' ' < "$T/names")" ] || fail "the names of stdin are not described in order"
+grep -q "^Version *:1.$N $" "$T/out" || fail "p$N: $(head "$T/out")"
+echo "batch: ok"
@@ -0,0 +1,59 @@
+#!/bin/sh
+# Build a throwaway dependency graph with -S -b, the SlackBuilds making
+# empty packages and BS_INSTALLPKG replaced by a script recording what it
+# installs.  Checks that the installs run one at a time, dependencies first,
+# that only the package just made is installed, never an older one left in
+# OUTPUT, and that a failed build or install cancels what requires it.  As
+# -S -b, it must run as root.
+# Usage: tests/build.sh [brightstar]
+BS=${1:-./brightstar}
+if [ "$(id -u)" != 0 ]; then
+    echo "build: skipped, needs root"
+    exit 0
+fi
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+mkdir -p "$T/out"
+# name, what the SlackBuild does, requires
+while read name how requires; do
+    add_slackbuild $name 1.0 "$requires"
+    pkg="\$OUTPUT/$name-1.0-noarch-1_SBo.tgz"
+    case $how in
+        fail) echo "exit 1" ;;
+        quiet) echo "sleep 0.2; touch $pkg" ;;
+        *) echo "sleep 0.2; touch $pkg; echo \"Slackware package $pkg created.\"" ;;
+    esac > "$T/sbo/system/$name/$name.SlackBuild"
+done <<LIST
+a make b c
+b make d
+c make
+d make
+e quiet
+f fail
+g make f
+h make
+i make h
+LIST
+# Older packages, which must not be installed
+touch -d 2000-01-01 "$T/out/d-1.0-noarch-0_old.tgz" "$T/out/e-1.0-noarch-0_old.tgz"
+cat > "$T/installpkg" <<SH
+mkdir "$T/lock" 2>/dev/null || echo overlap >> "$T/installed"
+echo "\${1##*/}" >> "$T/installed"
+sleep 0.3
+rmdir "$T/lock"
+case "\$1" in */h-*) exit 1 ;; esac
+SH
+export OUTPUT="$T/out" BS_INSTALLPKG="sh $T/installpkg"
+
+"$BS" -S -b --build-jobs 4 a e g i > "$T/build.out" 2>&1 && fail "the failed builds are not reported"
+grep -q "^5 built, 2 failed, 2 cancelled" "$T/build.out" || fail "$(tail -1 "$T/build.out")"
+grep -q "g cancelled, it requires f" "$T/build.out" || fail "g is not cancelled"
+grep -q "i cancelled, it requires h" "$T/build.out" || fail "i is not cancelled after the install of h failed"
+grep -q overlap "$T/installed" && fail "two installs ran at the same time"
+grep -q noarch-0_old "$T/installed" && fail "an older package was installed"
+[ "$(grep -c noarch-1_SBo "$T/installed")" = 6 ] || fail "$(cat "$T/installed")"
+line() { grep -n "^$1-" "$T/installed" | cut -d: -f1; }
+[ "$(line d)" -lt "$(line b)" ] && [ "$(line b)" -lt "$(line a)" ] && [ "$(line c)" -lt "$(line a)" ] \
+    || fail "installed out of order: $(cat "$T/installed")"
+echo "build: ok"
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Describe Slackware packages from a pkglist written in the order of
+# slackpkg, the patches records before the slackware records: the latest
+# patch of a package must be found whatever the order.
+# Usage: tests/catalog.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild other 1.0 ""
+cat > "$T/sk/pkglist" <<LIST
+patches bind 9.9.2_P2 x86_64 1_slack14.0 bind-9.9.2_P2-x86_64-1_slack14.0 ./patches/packages txz
+patches openssl 1.0.1e x86_64 1_slack14.0 openssl-1.0.1e-x86_64-1_slack14.0 ./patches/packages txz
+slackware bind 9.9.1_P3 x86_64 1 bind-9.9.1_P3-x86_64-1 ./slackware64/n txz
+slackware openssl 1.0.1c x86_64 3 openssl-1.0.1c-x86_64-3 ./slackware64/n txz
+slackware zlib 1.2.6 x86_64 1 zlib-1.2.6-x86_64-1 ./slackware64/l txz
+patches zlib 1.2.7 x86_64 1_slack14.0 zlib-1.2.7-x86_64-1_slack14.0 ./patches/packages txz
+LIST
+"$BS" -D -d bind openssl zlib > "$T/out" 2>/dev/null
+for p in 9.9.2_P2 1.0.1e 1.2.7; do
+    grep -q "^patch: *$p$" "$T/out" || fail "patch $p missing"
+done
+# Once more from the cached index
+"$BS" -D -d bind > "$T/out" 2>/dev/null
+grep -q "^patch: *9.9.2_P2$" "$T/out" || fail "patch missing from the cached index"
+echo "catalog: ok"
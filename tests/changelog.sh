@@ -0,0 +1,48 @@
+#!/bin/sh
+# Display the Slackware ChangeLog.txt entries of a package with -D -c: every
+# item naming the package, with its date and all its comment lines however
+# long, and the entries added at the top of ChangeLog.txt since the last run.
+# Usage: tests/changelog.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild foo 1.0 ""
+echo "slackware bind 9.9.2_P1 x86_64 1 bind-9.9.2_P1-x86_64-1_slack14.0 ./patches/packages txz" > "$T/sk/pkglist"
+echo "slackware zlib 1.2.7 x86_64 1 zlib-1.2.7-x86_64-1_slack14.0 ./patches/packages txz" >> "$T/sk/pkglist"
+LONG=$(printf '%0200d' 0 | tr 0 x)
+{
+    echo "Mon Jan  7 20:00:00 UTC 2013"
+    echo "patches/packages/bind-9.9.2_P1-x86_64-1_slack14.0.txz:  Upgraded."
+    for i in $(seq 1 30); do
+        echo "  Fix $i $LONG"
+    done
+    echo "patches/packages/zlib-1.2.7-x86_64-1_slack14.0.txz:  Rebuilt."
+    echo "+--------------------------+"
+    echo "Fri Sep 28 12:00:00 UTC 2012"
+    echo "patches/packages/bind-9.9.1_P4-x86_64-1_slack14.0.txz:  Upgraded."
+    echo "  Old fix."
+    echo "+--------------------------+"
+} > "$T/sk/ChangeLog.txt"
+
+"$BS" -D -c bind > "$T/out" 2>&1
+grep -q "^Mon Jan  7 20:00:00 UTC 2013$" "$T/out" || fail "no date: $(cat "$T/out")"
+grep -q "^  Fix 30 $LONG$" "$T/out" || fail "the comments are truncated: $(cat "$T/out")"
+[ "$(grep -c "^  Fix" "$T/out")" = 30 ] || fail "comments missing: $(cat "$T/out")"
+grep -q "^  Old fix.$" "$T/out" || fail "the older entry is missing: $(cat "$T/out")"
+grep -q "zlib" "$T/out" && fail "the item of zlib is shown for bind"
+[ -s "$T/cache/changelog.idx" ] || fail "no index written"
+
+{
+    echo "Tue Feb 12 08:00:00 UTC 2013"
+    echo "patches/packages/zlib-1.2.8-x86_64-1_slack14.0.txz:  Upgraded."
+    echo "  New zlib."
+    echo "+--------------------------+"
+    cat "$T/sk/ChangeLog.txt"
+} > "$T/new" && mv "$T/new" "$T/sk/ChangeLog.txt"
+"$BS" -D -c zlib > "$T/out" 2>&1
+grep -q "^  New zlib.$" "$T/out" || fail "the new entry is missing: $(cat "$T/out")"
+grep -q "^patches/packages/zlib-1.2.7-x86_64-1_slack14.0.txz:  Rebuilt.$" "$T/out" || fail "the old item of zlib is lost: $(cat "$T/out")"
+"$BS" -D -c bind > "$T/out" 2>&1
+[ "$(grep -c "^  Fix" "$T/out")" = 30 ] || fail "bind after the update: $(cat "$T/out")"
+echo "changelog: ok"
@@ -0,0 +1,75 @@
+#!/bin/sh
+# Download sources from a local HTTP server that drops the connection in the
+# middle of the body: the transfer must resume and pass its MD5.  A 404 and a
+# checksum failure must leave no part or state file behind.
+# Usage: tests/download.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+ID=bstest$$
+at_exit "rm -f /tmp/$ID-*"
+
+mkdir -p "$T/www"
+head -c 300000 /dev/urandom > "$T/www/$ID-drop.tar.gz"
+head -c 1000 /dev/urandom > "$T/www/$ID-bad.tar.gz"
+MD5=$(md5sum "$T/www/$ID-drop.tar.gz" | cut -c1-32)
+
+cat > "$T/server.py" <<'PY'
+import http.server, os, sys
+drops = {}
+class H(http.server.BaseHTTPRequestHandler):
+    def log_message(self, *a): pass
+    def do_GET(self):
+        path = os.path.join(sys.argv[2], os.path.basename(self.path))
+        if not os.path.exists(path):
+            self.send_error(404); return
+        data = open(path, 'rb').read()
+        start = 0
+        r = self.headers.get('Range')
+        if r:
+            start = int(r.split('=')[1].split('-')[0])
+        self.send_response(206 if start else 200)
+        self.send_header('Content-Length', str(len(data)-start))
+        if start:
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, len(data)-1, len(data)))
+        self.end_headers()
+        body = data[start:]
+        n = drops.get(self.path, 0)
+        if 'drop' in self.path and n < 2:
+            drops[self.path] = n+1
+            self.wfile.write(body[:len(body)//2])
+            self.wfile.flush()
+            self.close_connection = True
+            return
+        self.wfile.write(body)
+http.server.HTTPServer(('127.0.0.1', int(sys.argv[1])), H).serve_forever()
+PY
+serve_http "$T/www" "$T/server.py"
+
+# One package per case: dropped connections, a 404 and a wrong MD5
+for p in drop missing bad; do
+    case $p in
+        drop) md5=$MD5;;
+        *) md5=00000000000000000000000000000000;;
+    esac
+    add_slackbuild $p 1.0 "" http://127.0.0.1:$PORT/$ID-$p.tar.gz $md5
+done
+
+run() {
+    printf 'y\nn\n' | BS_SOURCES_MAX=0 "$BS" -S -d "$1" > "$T/$1.log" 2>&1
+}
+
+run drop
+grep -q "Retrying" "$T/drop.log" || fail "the dropped transfer was not retried"
+grep -q "Resuming" "$T/drop.log" || fail "the dropped transfer was not resumed"
+[ "$(md5sum < /tmp/$ID-drop.tar.gz | cut -c1-32)" = "$MD5" ] || fail "the resumed file is wrong"
+[ -e /tmp/$ID-drop.tar.gz.part ] && fail "part file left after a download"
+
+run missing
+grep -q "Download of .* failed" "$T/missing.log" || fail "the 404 was not reported"
+ls /tmp/$ID-missing.tar.gz* 2>/dev/null && fail "files left after a 404"
+
+run bad
+grep -q "Checksum failed" "$T/bad.log" || fail "the checksum failure was not reported"
+ls /tmp/$ID-bad.tar.gz* 2>/dev/null && fail "files left after a checksum failure"
+echo "download: ok"
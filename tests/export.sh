@@ -0,0 +1,35 @@
+#!/bin/sh
+# Export every package with -D -x and parse each line as JSON: text in UTF-8
+# is kept, a Latin-1 byte of a .info comes out as its code point, and the
+# installed packages are still exported without SLACKBUILDS.TXT or pkglist.
+# Usage: tests/export.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild foo 1.0 ""
+sed -i "s/^SLACKBUILD SHORT DESCRIPTION:  foo$/SLACKBUILD SHORT DESCRIPTION:  foo caf$(printf '\303\251')/" "$T/sbo/SLACKBUILDS.TXT"
+printf 'MAINTAINER="Ren\351"\n' >> "$T/sbo/system/foo/foo.info"
+add_installed foo-0.9-x86_64-1_SBo
+add_installed bar-2.0-x86_64-1_me
+check() {
+    python3 - "$1" "$2" <<'PY' || fail "$(cat "$1")"
+import json, sys
+with open(sys.argv[1], 'rb') as f:
+    pkgs={p["name"]: p for p in map(json.loads, f.read().decode('utf-8').splitlines())}
+assert sorted(pkgs)==sorted(sys.argv[2].split()), sorted(pkgs)
+assert pkgs["bar"]["installed"]["version"]=="2.0"
+if "foo" in pkgs and pkgs["foo"]["slackbuild"]:
+    sb=pkgs["foo"]["slackbuild"]
+    assert sb["shortdescr"]=="foo café", sb["shortdescr"]
+    assert sb["maintainer"]=="René", sb["maintainer"]
+PY
+}
+
+"$BS" -D -x > "$T/out" || fail "export"
+check "$T/out" "foo bar"
+rm "$T/sbo/SLACKBUILDS.TXT"
+"$BS" -D -x > "$T/out" 2> "$T/err" || fail "export without SLACKBUILDS.TXT: $(cat "$T/err")"
+check "$T/out" "foo bar"
+grep -q '"slackbuild":null' "$T/out" || fail "$(cat "$T/out")"
+echo "export: ok"
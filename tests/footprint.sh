@@ -0,0 +1,30 @@
+#!/bin/sh
+# Sum the installed sizes of a few packages on a host with neither an SBo
+# tree nor a slackpkg pkglist: per package, per series and per repository,
+# the series then taken from the PACKAGE LOCATION of the records, and with
+# --disk the files found under ROOT.
+# Usage: tests/footprint.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+export ROOT="$T/root/"
+
+mkdir -p "$T/root/bin"
+head -c 8192 /dev/zero > "$T/root/bin/bash"
+for p in bash-4.2-x86_64-1:a:100 grep-2.14-x86_64-1:a:50 vim-7.3-x86_64-1:ap:30; do
+    name=${p%%:*} series=${p#*:}
+    SIZE=${series#*:} LOCATION=./slackware64/${series%:*}/$name.txz add_installed $name bin/ bin/${name%%-*}
+done
+
+"$BS" -D --footprint > "$T/out" 2> "$T/err" || fail "per package: $(cat "$T/out" "$T/err")"
+grep -q "^ *100 *100 .* bash-4.2-x86_64-1$" "$T/out" || fail "per package: $(cat "$T/out")"
+grep -q "^ *180 *180 .* total$" "$T/out" || fail "total: $(cat "$T/out")"
+"$BS" -D --footprint=series > "$T/out" 2> "$T/err" || fail "per series: $(cat "$T/out" "$T/err")"
+grep -q "^ *150 *150 .* 2 slackware64/a$" "$T/out" || fail "per series: $(cat "$T/out")"
+grep -q "^ *30 *30 .* 1 slackware64/ap$" "$T/out" || fail "per series: $(cat "$T/out")"
+"$BS" -D --footprint=repo > "$T/out" 2> "$T/err" || fail "per repository: $(cat "$T/out" "$T/err")"
+grep -q "^ *180 *180 .* 3 slackware64$" "$T/out" || fail "per repository: $(cat "$T/out")"
+"$BS" -D --footprint --disk > "$T/out" 2> "$T/err" || fail "disk: $(cat "$T/out" "$T/err")"
+grep -q " 8 *[0-9]* *0 bash-4.2-x86_64-1$" "$T/out" || fail "disk: $(cat "$T/out")"
+grep -q " 1 vim-7.3-x86_64-1$" "$T/out" || fail "the missing file of vim: $(cat "$T/out")"
+echo "footprint: ok"
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Download sources whose MD5 and SHA-256 are checked while they are
+# received: a good source passes both without being read back, and a source
+# with the MD5 of the .info but another SHA-256 fails.
+# Usage: tests/hash.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+ID=bstest$$
+at_exit "rm -f /tmp/$ID-*"
+
+mkdir -p "$T/www"
+for p in good badsha; do
+    head -c 200000 /dev/urandom > "$T/www/$ID-$p.tar.gz"
+done
+serve_http "$T/www"
+for p in good badsha; do
+    add_slackbuild $p 1.0 "" http://127.0.0.1:$PORT/$ID-$p.tar.gz $(md5sum < "$T/www/$ID-$p.tar.gz" | cut -c1-32)
+    sha=$(sha256sum < "$T/www/$ID-$p.tar.gz" | cut -c1-64)
+    [ $p = badsha ] && sha=$(echo $sha | tr 0-9a-f 1-9a-f0)
+    echo "SHA256SUM=\"$sha\"" >> "$T/sbo/system/$p/$p.info"
+done
+
+printf 'y\nn\n' | BS_SOURCES_MAX=0 "$BS" -S -d --stats=json good > "$T/good.log" 2> "$T/good.stats"
+grep -q "$ID-good.tar.gz MD5 and SHA256 ok" "$T/good.log" || fail "good: $(cat "$T/good.log")"
+grep -q "$ID-good" "$T/good.stats" && fail "the source was read back to hash it"
+grep -q '"hash":{"calls":[1-9]' "$T/good.stats" || fail "the source was not hashed: $(cat "$T/good.stats")"
+
+printf 'y\nn\n' | BS_SOURCES_MAX=0 "$BS" -S -d badsha > "$T/badsha.log" 2>&1
+grep -q "Checksum failed" "$T/badsha.log" || fail "a wrong SHA-256 passed: $(cat "$T/badsha.log")"
+echo "hash: ok"
@@ -0,0 +1,31 @@
+#!/bin/sh
+# Look packages up through the binary index of SLACKBUILDS.TXT: the index is
+# written on first use, reused as long as SLACKBUILDS.TXT is unchanged, and
+# rebuilt when it changes.  Names are looked up ignoring case.
+# Usage: tests/index.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+IDX="$T/cache/SLACKBUILDS.idx"
+: > "$T/sk/pkglist"
+
+for i in $(seq 1 30); do
+    add_slackbuild p$i 1.$i ""
+done
+"$BS" -D -d p7 > "$T/out" 2>&1 || fail "p7: $(cat "$T/out")"
+grep -q "^Version *:1.7" "$T/out" || fail "p7: $(cat "$T/out")"
+[ -s "$IDX" ] || fail "no index written"
+first=$(ls -i "$IDX")
+
+"$BS" -D -d P30 > "$T/out" 2>&1 || fail "P30 is not found ignoring case: $(cat "$T/out")"
+grep -q "^Version *:1.30" "$T/out" || fail "P30: $(cat "$T/out")"
+[ "$(ls -i "$IDX")" = "$first" ] || fail "the index is rebuilt without a change"
+"$BS" -D -d nosuch 2>&1 | grep -q "No Slackbuilds found" || fail "a missing package is found"
+
+add_slackbuild late 2.0 ""
+"$BS" -D -d late > "$T/out" 2>&1 || fail "a package added to SLACKBUILDS.TXT is not found"
+grep -q "^Version *:2.0" "$T/out" || fail "late: $(cat "$T/out")"
+[ "$(ls -i "$IDX")" != "$first" ] || fail "the index is not rebuilt"
+"$BS" -D -a > "$T/out" 2>&1
+[ "$(wc -l < "$T/out")" -ge 31 ] || fail "-a: $(cat "$T/out")"
+echo "index: ok"
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Read the installed packages: names holding dashes are split from the right
+# into name, version, arch, build and tag, the list is cached, and the cache
+# follows the packages installed and removed since.
+# Usage: tests/installed.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_installed perl-XML-Parser-2.46-x86_64-3_SBo
+add_installed glibc-2.33-x86_64-5
+add_installed kde-l10n-en_GB-4.10.5-noarch-1_slack14.1
+installed() {
+    "$BS" -D -x "$@" > "$T/out" 2>&1 || fail "export: $(cat "$T/out")"
+    python3 -c '
+import json, sys
+for l in open(sys.argv[1]):
+    p=json.loads(l)
+    i=p["installed"]
+    print(p["name"], *(i and (i["version"], i["arch"], i["build"], i["tag"]) or ["-"]))
+' "$T/out"
+}
+
+installed perl-XML-Parser glibc kde-l10n-en_GB > "$T/got"
+cat > "$T/expected" <<OUT
+perl-XML-Parser 2.46 x86_64 3 _SBo
+glibc 2.33 x86_64 5 
+kde-l10n-en_GB 4.10.5 noarch 1 _slack14.1
+OUT
+diff "$T/expected" "$T/got" || fail "the names are not split from the right"
+[ -s "$T/cache/installed.cache" ] || fail "no cache written"
+
+sleep 1 # A new mtime for SB_DB
+rm "$T/db/glibc-2.33-x86_64-5"
+add_installed glibc-2.34-x86_64-1
+installed glibc perl > "$T/got"
+printf 'glibc 2.34 x86_64 1 \nperl -\n' > "$T/expected"
+diff "$T/expected" "$T/got" || fail "the cache misses the changes of SB_DB"
+echo "installed: ok"
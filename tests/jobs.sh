@@ -0,0 +1,57 @@
+#!/bin/sh
+# Download the sources of one package at the same time with -j: every source
+# passes its MD5, no more transfers run at once than --host-connections
+# allows, and the connections to the server are reused.
+# Usage: tests/jobs.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+ID=bstest$$
+at_exit "rm -f /tmp/$ID-*"
+
+mkdir -p "$T/www"
+cat > "$T/server.py" <<'PY'
+import http.server, os, sys, threading, time
+lock = threading.Lock()
+state = {"active": 0, "max": 0, "conns": set(), "requests": 0}
+class H(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    def log_message(self, *a): pass
+    def do_GET(self):
+        data = open(os.path.join(sys.argv[2], os.path.basename(self.path)), 'rb').read()
+        with lock:
+            state["active"] += 1
+            state["max"] = max(state["max"], state["active"])
+            state["conns"].add(self.client_address[1])
+            state["requests"] += 1
+        time.sleep(0.3)
+        self.send_response(200)
+        self.send_header('Content-Length', str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+        with lock:
+            state["active"] -= 1
+            with open(os.path.join(sys.argv[2], "stats"), "w") as f:
+                f.write("%d %d %d\n" % (state["max"], len(state["conns"]), state["requests"]))
+http.server.ThreadingHTTPServer(('127.0.0.1', int(sys.argv[1])), H).serve_forever()
+PY
+serve_http "$T/www" "$T/server.py"
+
+urls= md5s=
+for i in 1 2 3 4 5 6 7 8; do
+    head -c 50000 /dev/urandom > "$T/www/$ID-$i.tar.gz"
+    urls="$urls http://127.0.0.1:$PORT/$ID-$i.tar.gz"
+    md5s="$md5s $(md5sum < "$T/www/$ID-$i.tar.gz" | cut -c1-32)"
+done
+add_slackbuild many 1.0 "" "$urls" "$md5s"
+
+printf 'y\nn\n' | BS_SOURCES_MAX=0 "$BS" -S -d -j 8 --host-connections 3 many > "$T/log" 2>&1 || fail "$(cat "$T/log")"
+for i in 1 2 3 4 5 6 7 8; do
+    cmp -s "$T/www/$ID-$i.tar.gz" /tmp/$ID-$i.tar.gz || fail "source $i: $(cat "$T/log")"
+done
+read max conns requests < "$T/www/stats"
+[ "$requests" = 8 ] || fail "$requests requests for 8 sources"
+[ "$max" -gt 1 ] || fail "the sources are downloaded one after the other"
+[ "$max" -le 3 ] || fail "$max transfers at once to a host, 3 allowed"
+[ "$conns" -le 3 ] || fail "$conns connections opened for 8 sources, 3 allowed"
+echo "jobs: ok"
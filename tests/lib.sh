@@ -0,0 +1,77 @@
+# Helpers shared by the test scripts, sourced after BS is set:
+#   . "$(dirname "$0")/lib.sh"
+
+fail() { echo "FAIL: $*"; exit 1; }
+
+# at_exit command: run command when the script exits, before $T is removed.
+AT_EXIT=":"
+at_exit() { AT_EXIT="$AT_EXIT; $*"; }
+
+# setup_tree: make a throwaway tree in $T, removed on exit, with an SBo
+# repository, the package databases, a cache and a configuration directory,
+# and point brightstar at them.
+setup_tree() {
+    T=$(mktemp -d)
+    trap 'eval "$AT_EXIT"; rm -rf "$T"' EXIT
+    mkdir -p "$T/sbo" "$T/db" "$T/sk" "$T/cache" "$T/conf"
+    export SB_REPODIR="$T/sbo/" SB_DB="$T/db/" SK_DB="$T/sk/" BS_CACHEDIR="$T/cache/" BS_CONFDIR="$T/conf/"
+}
+
+# add_slackbuild name version requires [downloads md5sums]: add the record
+# of a Slackbuild of category system to SLACKBUILDS.TXT, its .info and its
+# slack-desc.  The repository is $REPO, $T/sbo by default.
+add_slackbuild() {
+    repo=${REPO:-$T/sbo}
+    mkdir -p "$repo/system/$1"
+    cat >> "$repo/SLACKBUILDS.TXT" <<TXT
+SLACKBUILD NAME: $1
+SLACKBUILD LOCATION: ./system/$1
+SLACKBUILD FILES: $1.info
+SLACKBUILD VERSION: $2
+SLACKBUILD DOWNLOAD: $4
+SLACKBUILD DOWNLOAD_x86_64:
+SLACKBUILD MD5SUM: $5
+SLACKBUILD MD5SUM_x86_64:
+SLACKBUILD SHORT DESCRIPTION:  $1
+
+TXT
+    printf 'PRGNAM="%s"\nVERSION="%s"\nREQUIRES="%s"\n' "$1" "$2" "$3" > "$repo/system/$1/$1.info"
+    printf '%s: %s\n' $1 "$1 (short)" $1 "$1 long" > "$repo/system/$1/slack-desc"
+}
+
+# serve_http dir [server.py]: serve the files of dir over HTTP on 127.0.0.1,
+# with python's http.server or with server.py run as "server.py PORT dir".
+# Sets PORT.
+serve_http() {
+    PORT=$(python3 -c 'import socket; s=socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1])')
+    if [ -n "$2" ]; then
+        python3 "$2" $PORT "$1" &
+    else
+        (cd "$1" && exec python3 -m http.server -b 127.0.0.1 $PORT) > /dev/null 2>&1 &
+    fi
+    at_exit "kill $! 2>/dev/null"
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+        python3 -c "import socket; socket.create_connection(('127.0.0.1', $PORT))" 2>/dev/null && return
+        sleep 0.2
+    done
+    fail "the HTTP server does not start"
+}
+
+# add_installed fullname [path...]: add the record of an installed package
+# to $SB_DB, listing paths, relative to ROOT, after FILE LIST.  $LOCATION
+# replaces its PACKAGE LOCATION and $SIZE its uncompressed size, in K.
+add_installed() {
+    name=$1
+    shift
+    {
+        echo "PACKAGE NAME:     $name"
+        echo "COMPRESSED PACKAGE SIZE:     ${SIZE:-10}K"
+        echo "UNCOMPRESSED PACKAGE SIZE:     ${SIZE:-10}K"
+        echo "PACKAGE LOCATION: ${LOCATION:-/tmp/$name.txz}"
+        echo "PACKAGE DESCRIPTION:"
+        echo "${name%-*-*-*}: ${name%-*-*-*}"
+        echo "FILE LIST:"
+        echo "./"
+        for f; do echo "$f"; done
+    } > "$SB_DB$name"
+}
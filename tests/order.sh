@@ -0,0 +1,33 @@
+#!/bin/sh
+# Print the build order of -D -b from the REQUIRES of the .info files: every
+# package after what it requires, the installed packages left out, a cycle
+# reported, and the cached graph rebuilt when SLACKBUILDS.TXT changes.
+# Usage: tests/order.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild app 1.0 "lib1 lib2"
+add_slackbuild lib1 1.0 "base"
+add_slackbuild lib2 1.0 "base %README%"
+add_slackbuild base 1.0 ""
+add_slackbuild c1 1.0 "c2"
+add_slackbuild c2 1.0 "c1"
+
+"$BS" -D -b app > "$T/out" 2> "$T/err" || fail "app: $(cat "$T/out" "$T/err")"
+printf 'base\nlib1\nlib2\napp\n' | diff - "$T/out" || fail "wrong order for app"
+grep -q "^lib2: see README" "$T/err" || fail "%README% is not reported: $(cat "$T/err")"
+[ -s "$T/cache/deps.cache" ] || fail "no graph cached"
+
+add_installed lib1-1.0-x86_64-1_SBo
+"$BS" -D -b app lib1 > "$T/out" 2>/dev/null || fail "app lib1"
+printf 'base\nlib2\napp\n' | diff - "$T/out" || fail "the installed lib1 is not left out"
+
+"$BS" -D -b c1 > "$T/out" 2> "$T/err" && fail "a cycle is ordered: $(cat "$T/out")"
+grep -q "^Dependency cycle: c1 -> c2 -> c1$" "$T/err" || fail "cycle: $(cat "$T/err")"
+"$BS" -D -b nosuch > "$T/out" 2>&1 && fail "an unknown package is ordered"
+
+add_slackbuild top 1.0 "app"
+"$BS" -D -b top > "$T/out" 2>/dev/null || fail "a package added to SLACKBUILDS.TXT is not in the graph"
+printf 'base\nlib2\napp\ntop\n' | diff - "$T/out" || fail "top"
+echo "order: ok"
@@ -0,0 +1,35 @@
+#!/bin/sh
+# Find the installed packages owning paths with -D -w: an exact path, a
+# directory ending with / and a glob, and the index following the package
+# records changed since it was built.
+# Usage: tests/owner.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+A=a-1.0-x86_64-1_SBo
+B=b-2.0-noarch-1
+add_installed $A usr/ usr/bin/ usr/bin/a usr/share/ usr/share/doc/ usr/share/doc/a/ usr/share/doc/a/README etc/ etc/a.conf
+add_installed $B usr/ usr/bin/ usr/bin/b usr/share/ usr/share/doc/ usr/share/doc/b/ usr/share/doc/b/NEWS
+owner() {
+    "$BS" -D -w "$@" > "$T/out" 2> "$T/err" || fail "$*: $(cat "$T/out" "$T/err")"
+    sort "$T/out"
+}
+
+[ "$(owner /usr/bin/a)" = "$A: /usr/bin/a" ] || fail "/usr/bin/a: $(cat "$T/out")"
+printf '%s\n' "$A: /usr/share/doc/a/README" "$B: /usr/share/doc/b/NEWS" > "$T/expected"
+owner /usr/share/doc/ | grep -v '/$' | diff "$T/expected" - || fail "the files under /usr/share/doc/"
+printf '%s\n' "$A: /usr/bin/a" "$B: /usr/bin/b" > "$T/expected"
+owner '/usr/bin/[ab]' | diff "$T/expected" - || fail "the glob /usr/bin/[ab]"
+owner /etc/a.conf /usr/bin/b > /dev/null
+[ "$(wc -l < "$T/out")" = 2 ] || fail "two paths: $(cat "$T/out")"
+"$BS" -D -w /usr/bin/c > "$T/out" 2> "$T/err" && fail "a path owned by nobody is found: $(cat "$T/out")"
+grep -q "No installed package owns /usr/bin/c" "$T/err" || fail "$(cat "$T/err")"
+[ -s "$T/cache/owners.idx" ] || fail "no index written"
+
+sleep 1 # A new mtime for SB_DB
+rm "$T/db/$B"
+add_installed c-3.0-x86_64-1 usr/ usr/bin/ usr/bin/b usr/bin/c
+[ "$(owner /usr/bin/b)" = "c-3.0-x86_64-1: /usr/bin/b" ] || fail "the index misses the changes: $(cat "$T/out")"
+[ "$(owner /usr/bin/a)" = "$A: /usr/bin/a" ] || fail "an unchanged package is lost: $(cat "$T/out")"
+echo "owner: ok"
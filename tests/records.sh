@@ -0,0 +1,47 @@
+#!/bin/sh
+# Describe packages whose fields outgrow any fixed size: 60 sources, a
+# REQUIRES of 80 names over continued lines, a long homepage, and a catalog
+# exported across several arenas, every field coming out whole.
+# Usage: tests/records.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+urls= md5s= reqs=
+for i in $(seq 1 60); do
+    urls="$urls http://example.org/src/big-part$i.tar.gz"
+    md5s="$md5s $(echo $i | md5sum | cut -c1-32)"
+done
+for i in $(seq 1 300); do
+    [ $i -le 80 ] && reqs="$reqs dependency$i"
+    add_slackbuild dependency$i 1.0 ""
+done
+add_slackbuild big 1.0 "" "$urls" "$md5s"
+HOME_PAGE=http://example.org/$(printf '%0400d' 0 | tr 0 a)
+{
+    echo "PRGNAM=\"big\""
+    echo "VERSION=\"1.0\""
+    echo "HOMEPAGE=\"$HOME_PAGE\""
+    echo "REQUIRES=\"$(echo $reqs | cut -d' ' -f1-40) \\"
+    echo "$(echo $reqs | cut -d' ' -f41-80)\""
+    echo "MAINTAINER=\"Someone\""
+} > "$T/sbo/system/big/big.info"
+: > "$T/sk/pkglist"
+
+"$BS" -D -x > "$T/out" 2>&1 || fail "export: $(tail -3 "$T/out")"
+python3 - "$T/out" "$HOME_PAGE" <<'PY' || fail "$(grep '"big"' "$T/out")"
+import json, sys
+pkgs = [json.loads(l) for l in open(sys.argv[1])]
+assert len(pkgs) == 301, len(pkgs)
+big = next(p["slackbuild"] for p in pkgs if p["name"] == "big")
+assert len(big["download"]) == 60 and big["download"][59].endswith("part60.tar.gz"), big["download"]
+assert len(big["md5sum"]) == 60
+assert big["requires"] == ["dependency%d" % i for i in range(1, 81)], big["requires"]
+assert big["homepage"] == sys.argv[2]
+assert big["maintainer"] == "Someone"
+PY
+
+"$BS" -D -d big > "$T/out" 2>&1 || fail "describe: $(cat "$T/out")"
+grep -q "^Home page *:$HOME_PAGE$" "$T/out" || fail "homepage: $(cat "$T/out")"
+grep -q "dependency80 (Not installed) *$" "$T/out" || fail "requires: $(cat "$T/out")"
+echo "records: ok"
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Merge an overlay of higher priority with SBo through repos.conf: the
+# overlay shadows the Slackbuilds of the same name, and the installed
+# packages built from either, whatever their tag, are reported outdated
+# against their repository, while a Slackware package of the same name as a
+# Slackbuild is left to the patches.
+# Usage: tests/repos.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+REPO="$T/overlay" add_slackbuild foo 2.0 ""
+REPO="$T/overlay" add_slackbuild local 1.1 ""
+add_slackbuild foo 1.0 ""
+add_slackbuild bar 3.0 ""
+add_slackbuild zlib 9.9 ""
+cat > "$T/conf/repos.conf" <<CONF
+# name priority directory source download
+SBo 10 $T/sbo/ - -
+overlay 100 $T/overlay/ - -
+CONF
+echo "slackware zlib 1.2.6 x86_64 1 zlib-1.2.6-x86_64-1 ./slackware64/l txz" > "$T/sk/pkglist"
+add_installed foo-1.5-x86_64-1_ovl
+add_installed local-1.0-x86_64-1_me
+add_installed bar-2.0-x86_64-1_SBo
+add_installed zlib-1.2.6-x86_64-1
+
+"$BS" -D -d foo bar > "$T/out" 2>/dev/null
+grep -q "^Version *:2.0" "$T/out" || fail "foo is not taken from the overlay: $(cat "$T/out")"
+grep -q "^Repository *:overlay" "$T/out" || fail "the repository of foo is not shown"
+grep -q "^Version *:3.0" "$T/out" || fail "bar of SBo is not found"
+"$BS" -D -a > "$T/out" 2>/dev/null
+[ "$(grep -c "^foo" "$T/out")" = 1 ] || fail "foo is listed twice: $(cat "$T/out")"
+
+"$BS" -D -o > "$T/out" 2>/dev/null
+grep -q "^foo 1.5 -> 2.0 (overlay)$" "$T/out" || fail "foo: $(cat "$T/out")"
+grep -q "^local 1.0 -> 1.1 (overlay)$" "$T/out" || fail "local: $(cat "$T/out")"
+grep -q "^bar 2.0 -> 3.0 (SBo)$" "$T/out" || fail "bar: $(cat "$T/out")"
+grep -q "^zlib" "$T/out" && fail "the Slackware zlib is compared with the Slackbuild"
+echo "repos: ok"
@@ -0,0 +1,40 @@
+#!/bin/sh
+# List the packages requiring a package with -D --required-by: all of them,
+# each after what it requires, only the direct ones with --direct, only the
+# installed ones with --installed, and the graph following SLACKBUILDS.TXT.
+# Usage: tests/required.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild lib 1.0 ""
+add_slackbuild a 1.0 "lib"
+add_slackbuild b 1.0 "a"
+add_slackbuild c 1.0 "lib %README%"
+add_slackbuild d 1.0 "b c"
+add_slackbuild other 1.0 ""
+before() {
+    [ "$(grep -n "^$1$" "$T/out" | cut -d: -f1)" -lt "$(grep -n "^$2$" "$T/out" | cut -d: -f1)" ] || fail "$1 not before $2: $(cat "$T/out")"
+}
+
+"$BS" -D --required-by lib > "$T/out" 2>&1 || fail "$(cat "$T/out")"
+[ "$(sort "$T/out" | tr '\n' ' ')" = "a b c d " ] || fail "all: $(cat "$T/out")"
+before a b
+before b d
+before c d
+"$BS" -D --required-by --direct lib > "$T/out" 2>&1
+[ "$(sort "$T/out" | tr '\n' ' ')" = "a c " ] || fail "--direct: $(cat "$T/out")"
+add_installed b-1.0-x86_64-1_SBo
+add_installed c-1.0-x86_64-1_SBo
+"$BS" -D --required-by --installed lib > "$T/out" 2>&1
+[ "$(sort "$T/out" | tr '\n' ' ')" = "b c " ] || fail "--installed: $(cat "$T/out")"
+"$BS" -D --required-by --direct --installed lib > "$T/out" 2>&1
+[ "$(cat "$T/out")" = "c" ] || fail "--direct --installed: $(cat "$T/out")"
+"$BS" -D --required-by other > "$T/out" 2>&1
+[ -s "$T/out" ] && fail "other: $(cat "$T/out")"
+"$BS" -D --required-by nosuch > "$T/out" 2>&1 && fail "an unknown package is accepted"
+
+add_slackbuild e 1.0 "other"
+"$BS" -D --required-by other > "$T/out" 2>&1
+[ "$(cat "$T/out")" = "e" ] || fail "the graph misses a package added: $(cat "$T/out")"
+echo "required: ok"
@@ -0,0 +1,80 @@
+#!/bin/sh
+# Parse the "KEY: value" lines of SLACKBUILDS.TXT and PACKAGES.TXT through
+# the scanner: every known key lands in its field whatever the length of
+# the lines, the colons of the values and the keys sharing a prefix, an
+# unknown key is ignored, and the last line may lack its newline.  With
+# brightbench next to brightstar, every variant of the scanner must also
+# find the same keys.
+# Usage: tests/scan.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+mkdir -p "$T/sbo/system/foo" "$T/sbo/system/bar"
+printf 'PRGNAM="foo"\nVERSION="1.0"\n' > "$T/sbo/system/foo/foo.info"
+printf 'PRGNAM="bar"\nVERSION="2.0.1"\n' > "$T/sbo/system/bar/bar.info"
+{
+    echo "SLACKBUILD NAME: foo"
+    echo "SLACKBUILD LOCATION: ./system/foo"
+    echo "SLACKBUILD FILES: README foo.SlackBuild foo.info slack-desc"
+    echo "SLACKBUILD VERSION: 1.0"
+    echo "SLACKBUILD DOWNLOAD: http://example.org:8080/a/foo-1.0.tar.gz https://example.org/foo-data.zip"
+    echo "SLACKBUILD DOWNLOAD_x86_64: http://example.org/foo-1.0-x86_64.tar.gz"
+    echo "SLACKBUILD MD5SUM: 0123456789abcdef0123456789abcdef fedcba9876543210fedcba9876543210"
+    echo "SLACKBUILD MD5SUM_x86_64: 00112233445566778899aabbccddeeff"
+    echo "SLACKBUILD SIGNATURE: ignored"
+    echo "SLACKBUILD SHORT DESCRIPTION:  foo (a package: with colons)"
+    echo
+    echo "SLACKBUILD NAME: bar"
+    echo "SLACKBUILD LOCATION: ./system/bar"
+    echo "SLACKBUILD FILES: bar.info"
+    echo "SLACKBUILD VERSION: 2.0.1"
+    echo "SLACKBUILD DOWNLOAD: UNSUPPORTED"
+    echo "SLACKBUILD DOWNLOAD_x86_64: "
+    echo "SLACKBUILD MD5SUM: "
+    echo "SLACKBUILD MD5SUM_x86_64:"
+    printf "SLACKBUILD SHORT DESCRIPTION:  bar $(printf '%0100d' 0)"
+} > "$T/sbo/SLACKBUILDS.TXT"
+echo "slackware bind 9.9.2_P1 x86_64 1 bind-9.9.2_P1-x86_64-1_slack14.0 ./patches/packages txz" > "$T/sk/pkglist"
+cat > "$T/sk/PACKAGES.TXT" <<'TXT'
+PACKAGES.TXT;  Wed Jan 16 03:02:49 UTC 2013
+
+PACKAGE NAME:  bind-9.9.2_P1-x86_64-1_slack14.0.txz
+PACKAGE LOCATION:  ./patches/packages
+PACKAGE SIZE (compressed):  1940 K
+PACKAGE SIZE (uncompressed):  7490 K
+PACKAGE DESCRIPTION:
+bind: bind (DNS server and utilities)
+bind:
+bind: The named daemon: and support utilities such as dig, host, and
+bind: nslookup.
+TXT
+
+"$BS" -D -x foo bar bind > "$T/out" 2>&1 || fail "$(cat "$T/out")"
+python3 - "$T/out" <<'PY' || fail "$(cat "$T/out")"
+import json, sys
+p = {x["name"]: x for x in map(json.loads, open(sys.argv[1]))}
+foo, bar = p["foo"]["slackbuild"], p["bar"]["slackbuild"]
+assert foo["location"] == "./system/foo"
+assert foo["files"] == ["README", "foo.SlackBuild", "foo.info", "slack-desc"]
+assert foo["version"] == "1.0"
+assert foo["download"] == ["http://example.org:8080/a/foo-1.0.tar.gz", "https://example.org/foo-data.zip"], foo["download"]
+assert foo["download_x86_64"] == ["http://example.org/foo-1.0-x86_64.tar.gz"], foo["download_x86_64"]
+assert foo["md5sum"] == ["0123456789abcdef0123456789abcdef", "fedcba9876543210fedcba9876543210"]
+assert foo["md5sum_x86_64"] == ["00112233445566778899aabbccddeeff"]
+assert foo["shortdescr"] == "foo (a package: with colons)", foo["shortdescr"]
+assert bar["version"] == "2.0.1" and bar["download"] == ["UNSUPPORTED"]
+assert bar["download_x86_64"] == [] and bar["md5sum"] == [] and bar["md5sum_x86_64"] == []
+assert bar["shortdescr"] == "bar " + "0" * 100, bar["shortdescr"]
+bind = p["bind"]["slackware"]
+assert bind["size_compressed"] == "1940 K" and bind["size_uncompressed"] == "7490 K", bind
+assert bind["description"][2] == "The named daemon: and support utilities such as dig, host, and", bind["description"]
+PY
+
+BENCH=$(dirname "$BS")/brightbench
+if [ -x "$BENCH" ]; then
+    "$BENCH" -n 1 200 2>/dev/null | sed -n 's/.*"op":"scan_\([a-z0-9]*\)".*"keys":\([0-9]*\).*/\1 \2/p' > "$T/bench"
+    [ "$(wc -l < "$T/bench")" -ge 3 ] || fail "brightbench: $(cat "$T/bench")"
+    [ "$(cut -d' ' -f2 "$T/bench" | sort -u | wc -l)" = 1 ] || fail "the variants disagree: $(cat "$T/bench")"
+fi
+echo "scan: ok"
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Search names through the trigram index: -D -m matches substrings ignoring
+# case, --prefix only the start of the names, --descr the short descriptions
+# too, -D -f ranks the names closest to a misspelling, and the index follows
+# the changes of SLACKBUILDS.TXT.
+# Usage: tests/search.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+for p in libpng libjpeg-turbo openjpeg ffmpeg python3-numpy numpy-stubs; do
+    add_slackbuild $p 1.0 ""
+done
+sed -i 's/^SLACKBUILD SHORT DESCRIPTION:  ffmpeg$/SLACKBUILD SHORT DESCRIPTION:  Video Codec library/' "$T/sbo/SLACKBUILDS.TXT"
+search() {
+    "$BS" -D "$@" > "$T/out" 2>&1 || fail "$*: $(cat "$T/out")"
+    sort "$T/out" | tr '\n' ' '
+}
+
+[ "$(search -m JPEG)" = "libjpeg-turbo openjpeg " ] || fail "-m JPEG: $(cat "$T/out")"
+[ "$(search -m pn)" = "libpng " ] || fail "-m pn: $(cat "$T/out")"
+[ "$(search -m --prefix numpy)" = "numpy-stubs " ] || fail "--prefix numpy: $(cat "$T/out")"
+[ "$(search -m codec)" = "" ] || fail "-m codec matches a description: $(cat "$T/out")"
+[ "$(search -m --descr codec)" = "ffmpeg " ] || fail "--descr codec: $(cat "$T/out")"
+search -f libpgn > /dev/null
+[ "$(head -1 "$T/out")" = libpng ] || fail "-f libpgn: $(cat "$T/out")"
+[ "$(search -f numpi --top 2)" = "numpy-stubs python3-numpy " ] || fail "-f numpi: $(cat "$T/out")"
+search -f numpi --top 1 > /dev/null
+[ "$(cat "$T/out")" = numpy-stubs ] || fail "--top 1: $(cat "$T/out")"
+[ -s "$T/cache/trigram.idx" ] || fail "no index cached"
+
+add_slackbuild libpng-legacy 1.0 ""
+[ "$(search -m png)" = "libpng libpng-legacy " ] || fail "the index misses a new package: $(cat "$T/out")"
+echo "search: ok"
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Run the query daemon on a throwaway repository: a missing .info or
+# slack-desc and a missing SLACKBUILDS.TXT must fail the query only, a client
+# that never reads its replies must not hold up the others, the socket must
+# not be open to everybody, and REQUIRES must never be run by a shell.
+# Usage: tests/serve.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+for p in ok noinfo nodesc; do
+    add_slackbuild $p 1.0 ""
+    [ $p = noinfo ] && rm "$T/sbo/system/$p/$p.info"
+    [ $p = nodesc ] && rm "$T/sbo/system/$p/slack-desc"
+done
+# A REQUIRES that a shell would run
+add_slackbuild evil 1.0 "ok \$(touch $T/ran) \`touch $T/ran\`"
+SOCK="$T/bs.sock"
+"$BS" --serve --socket "$SOCK" > "$T/daemon.log" 2>&1 &
+DAEMON=$!
+at_exit "kill $DAEMON 2>/dev/null"
+for i in 1 2 3 4 5 6 7 8 9 10; do [ -S "$SOCK" ] && break; sleep 0.2; done
+q() { "$BS" --socket "$SOCK" --query "$1"; }
+
+q ping | grep -q pong || fail "the daemon does not answer"
+[ "$(stat -c %a "$SOCK")" = 660 ] || fail "socket mode $(stat -c %a "$SOCK")"
+q "describe ok" | grep -q "ok" || fail "describe ok"
+q "describe noinfo" 2>&1 | grep -q "^ERR" || fail "a missing .info is not an error"
+q "describe nodesc" 2>&1 | grep -q "^ERR" || fail "a missing slack-desc is not an error"
+q "describe evil" | grep -q "ok (Not installed)" || fail "describe evil"
+[ -e "$T/ran" ] && fail "a command of REQUIRES was run"
+mv "$T/sbo/SLACKBUILDS.TXT" "$T/SLACKBUILDS.TXT"
+q "match o" 2>&1 | grep -q "^ERR" || fail "a missing SLACKBUILDS.TXT is not an error"
+mv "$T/SLACKBUILDS.TXT" "$T/sbo/SLACKBUILDS.TXT"
+q "match o" | grep -q "ok" || fail "the index is not loaded again"
+
+# A client sending queries and never reading the replies
+python3 - "$SOCK" <<'PY' &
+import socket, sys, time
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.setblocking(False)
+try:
+    for i in range(100000):
+        s.send(b"describe ok\n")
+except BlockingIOError:
+    pass
+time.sleep(30)
+PY
+at_exit "kill $! 2>/dev/null"
+sleep 1
+timeout 5 "$BS" --socket "$SOCK" --query ping | grep -q pong || fail "a slow client blocks the others"
+kill -0 $DAEMON || fail "the daemon died"
+echo "serve: ok"
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Download sources from a local HTTP server into a source cache prepared
+# beforehand.  A cached source of the same MD5 but of another SHA-256 must
+# leave both the download and the cache as they are, and the eviction must
+# not count the sources still linked from elsewhere.
+# Usage: tests/sources.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+ID=bstest$$
+at_exit "rm -f /tmp/$ID-*"
+
+mkdir -p "$T/cache/sources" "$T/www"
+head -c 1000 /dev/urandom > "$T/www/$ID-new.tar.gz"
+head -c 1000 /dev/urandom > "$T/www/$ID-clash.tar.gz"
+sum() { $1sum < "$2" | cut -d' ' -f1; }
+NEW=$(sum md5 "$T/www/$ID-new.tar.gz")
+CLASH=$(sum md5 "$T/www/$ID-clash.tar.gz")
+
+# The cache: another content under the MD5 of clash, an old unlinked source
+# and a big one still linked from elsewhere
+head -c 1000 /dev/urandom > "$T/cache/sources/$CLASH"
+sum sha256 "$T/cache/sources/$CLASH" > "$T/cache/sources/$CLASH.sha256"
+OTHER=$(cat "$T/cache/sources/$CLASH.sha256")
+OLD=0123456789abcdef0123456789abcdef
+BIG=fedcba9876543210fedcba9876543210
+head -c 1000 /dev/urandom > "$T/cache/sources/$OLD"
+head -c 300000 /dev/urandom > "$T/cache/sources/$BIG"
+ln "$T/cache/sources/$BIG" "$T/linked"
+touch -d 2000-01-01 "$T/cache/sources/$OLD" "$T/cache/sources/$BIG" "$T/cache/sources/$CLASH"
+
+serve_http "$T/www"
+add_slackbuild pkg 1.0 "" "http://127.0.0.1:$PORT/$ID-new.tar.gz http://127.0.0.1:$PORT/$ID-clash.tar.gz" "$NEW $CLASH"
+echo "SHA256SUM=\"$(sum sha256 "$T/www/$ID-new.tar.gz") $(sum sha256 "$T/www/$ID-clash.tar.gz")\"" >> "$T/sbo/system/pkg/pkg.info"
+
+printf 'y\nn\n' | BS_SOURCES_MAX=5K "$BS" -S -d pkg > "$T/pkg.log" 2>&1
+grep -q "$ID-clash.tar.gz MD5 and SHA256 ok" "$T/pkg.log" || fail "the clash was not downloaded: $(cat "$T/pkg.log")"
+cmp -s "$T/www/$ID-clash.tar.gz" /tmp/$ID-clash.tar.gz || fail "the download was replaced by the cached source"
+[ "$(sum sha256 "$T/cache/sources/$CLASH")" = "$OTHER" ] || fail "the cached source was replaced"
+[ "$(cat "$T/cache/sources/$CLASH.sha256")" = "$OTHER" ] || fail "the sha256sum of the cached source was replaced"
+cmp -s "$T/www/$ID-new.tar.gz" "$T/cache/sources/$NEW" || fail "the new source is not cached"
+[ -e "$T/cache/sources/$OLD" ] || fail "a source was evicted for one still linked"
+[ -e "$T/cache/sources/$BIG" ] || fail "a source still linked was evicted"
+echo "sources: ok"
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Ask --stats for queries that stop early, a package not found, a package
+# without sources or a repository without SLACKBUILDS.TXT, checking that the
+# report is still printed and that nothing but the query output goes to
+# stdout.
+# Usage: tests/stats.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+add_slackbuild foo 1.0 ""
+for op in -Sd -Dr; do
+    "$BS" $op --stats=json nosuch > "$T/out" 2> "$T/err" < /dev/null
+    grep -q '"fopen":' "$T/err" || fail "$op prints no report for a missing package"
+    "$BS" $op --stats=xml nosuch > "$T/out" 2> "$T/err" < /dev/null
+    grep -q -- "--stats=xml" "$T/out" && fail "$op warns about --stats on stdout"
+    grep -q -- "--stats=xml" "$T/err" || fail "$op does not warn about --stats"
+    grep -q "calls" "$T/err" || fail "$op prints no summary for a missing package"
+done
+
+echo y | "$BS" -Sd --stats=json foo > "$T/out" 2> "$T/err" && fail "a package without sources is downloaded"
+grep -q "No package to download" "$T/err" || fail "-Sd foo: $(cat "$T/err")"
+grep -q '"fopen":' "$T/err" || fail "-Sd prints no report for a package without sources"
+
+rm "$T/sbo/SLACKBUILDS.TXT"
+"$BS" -Dd --stats=json foo > "$T/out" 2> "$T/err" && fail "a missing SLACKBUILDS.TXT is not an error"
+grep -q '"fopen":' "$T/err" || fail "-Dd prints no report without SLACKBUILDS.TXT"
+echo "stats: ok"
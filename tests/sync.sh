@@ -0,0 +1,48 @@
+#!/bin/sh
+# Synchronize a throwaway repository with -S -s from a local directory given
+# as its source in repos.conf, and check the incremental update of the
+# dependency graph: a sync without changes updates nothing, and a changed
+# package only has its .info read again.  Needs rsync, set RSYNC to use
+# another one.
+# Usage: tests/sync.sh [brightstar]
+BS=${1:-./brightstar}
+RSYNC=${RSYNC:-$(command -v rsync)}
+if [ -z "$RSYNC" ]; then
+    echo "sync: skipped, needs rsync"
+    exit 0
+fi
+. "$(dirname "$0")/lib.sh"
+setup_tree
+export RSYNC
+
+N=50
+for i in $(seq 1 $N); do
+    REPO="$T/src" add_slackbuild p$i 1.0 "$([ $i -gt 1 ] && [ $i -le 10 ] && echo p$((i-1)))"
+done
+echo "SBo 0 $T/sbo/ $T/src/ -" > "$T/conf/repos.conf"
+sleep 1 # Copies made without keeping the times would get a new mtime
+fopens() { sed -n 's/.*"fopen":\([0-9]*\).*/\1/p' "$1"; }
+
+"$BS" -S -s --stats=json > "$T/first.out" 2> "$T/first.stats" || fail "first sync: $(cat "$T/first.stats")"
+[ "$(fopens "$T/first.stats")" -ge $N ] || fail "the first sync did not read every .info"
+"$BS" -D -b p3 | grep -q p1 || fail "the graph misses p3 -> p2 -> p1"
+
+"$BS" -S -s > "$T/again.out" || fail "second sync"
+grep -q "^0 items updated" "$T/again.out" || fail "a sync without changes updated: $(tail -1 "$T/again.out")"
+
+sleep 1 # A new mtime for the changed files
+printf 'PRGNAM="p3"\nVERSION="1.0"\nREQUIRES="p2 p%s"\n' $N > "$T/src/system/p3/p3.info"
+sed -i 's/^SLACKBUILD SHORT DESCRIPTION:  p3$/SLACKBUILD SHORT DESCRIPTION:  p3 changed/' "$T/src/SLACKBUILDS.TXT"
+"$BS" -S -s --stats=json > "$T/change.out" 2> "$T/change.stats" || fail "third sync"
+grep -q "in 1 package" "$T/change.out" || fail "the change is not limited to p3: $(tail -1 "$T/change.out")"
+[ "$(fopens "$T/change.stats")" -lt 5 ] || fail "$(fopens "$T/change.stats") files read for one changed package"
+"$BS" -D -b p3 | grep -q "p$N" || fail "the new REQUIRES of p3 is missing"
+
+# A tree that cannot be written is left out, root writing anywhere
+if [ "$(id -u)" != 0 ]; then
+    mkdir "$T/ro" && chmod 555 "$T/ro"
+    echo "SBo 0 $T/ro/sbo/ $T/src/ -" > "$T/conf/repos.conf"
+    "$BS" -S -s > /dev/null 2> "$T/denied.err" && fail "a sync into a tree that cannot be written succeeded"
+    grep -q "Become root to rsync SBo" "$T/denied.err" || fail "$(cat "$T/denied.err")"
+fi
+echo "sync: ok"
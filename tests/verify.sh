@@ -0,0 +1,32 @@
+#!/bin/sh
+# Verify the files of an installed package under a throwaway ROOT: the types
+# of the paths against the record, then the contents against a manifest
+# recorded with -S --manifest, in the format of sha256sum.
+# Usage: tests/verify.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+export ROOT="$T/root/"
+
+mkdir -p "$T/root/usr/bin" "$T/root/usr/share/foo" "$T/root/etc"
+echo foo > "$T/root/usr/bin/foo"
+echo conf > "$T/root/etc/foo.conf"
+add_installed foo-1.0-x86_64-1_SBo usr/ usr/bin/ usr/bin/foo usr/share/ usr/share/foo/ etc/ etc/foo.conf
+FOO=foo-1.0-x86_64-1_SBo
+
+"$BS" -D --verify foo > "$T/out" || fail "an untouched package: $(cat "$T/out")"
+grep -q "^1 package, 7 files: 0 missing" "$T/out" || fail "$(cat "$T/out")"
+
+"$BS" -S --manifest foo > "$T/out" || fail "manifest: $(cat "$T/out")"
+(cd "$T/root" && sha256sum usr/bin/foo) > "$T/expected"
+grep -qxF "$(cat "$T/expected")" "$T/cache/manifests/$FOO" || fail "manifest: $(cat "$T/cache/manifests/$FOO")"
+"$BS" -D --verify --hash foo > "$T/out" || fail "a package as recorded: $(cat "$T/out")"
+
+echo bar > "$T/root/usr/bin/foo"
+rm "$T/root/etc/foo.conf"
+rmdir "$T/root/usr/share/foo" && touch "$T/root/usr/share/foo"
+"$BS" -D --verify --hash foo > "$T/out" && fail "the changes are not reported"
+grep -q "^$FOO: changed /usr/bin/foo$" "$T/out" || fail "change: $(cat "$T/out")"
+grep -q "^$FOO: missing /etc/foo.conf$" "$T/out" || fail "missing: $(cat "$T/out")"
+grep -q "^$FOO: wrong type /usr/share/foo/$" "$T/out" || fail "type: $(cat "$T/out")"
+echo "verify: ok"
@@ -0,0 +1,30 @@
+#!/bin/sh
+# Report the outdated SBo packages of a throwaway repository, checking the
+# order of letter post-releases (1.0.1a > 1.0.1) and of spelled-out
+# pre-releases (1.0rc1 < 1.0).
+# Usage: tests/version.sh [brightstar]
+BS=${1:-./brightstar}
+. "$(dirname "$0")/lib.sh"
+setup_tree
+
+# name, version in SBo, version installed
+while read name sbo inst; do
+    add_slackbuild $name $sbo ""
+    add_installed $name-$inst-x86_64-1_SBo
+done <<LIST
+letterup 1.0.1a 1.0.1
+letterdown 1.0.1 1.0.1a
+letters 1.0.1b 1.0.1a
+rcup 1.0 1.0rc1
+betadown 2.0beta 2.0
+alphabeta 3.0beta1 3.0alpha2
+same 1.2.3 1.2.3
+LIST
+"$BS" -D -o > "$T/out" 2>/dev/null
+for p in letterup letters rcup alphabeta; do
+    grep -q "^$p " "$T/out" || fail "$p is not reported outdated"
+done
+for p in letterdown betadown same; do
+    grep -q "^$p " "$T/out" && fail "$p is reported outdated"
+done
+echo "version: ok"